@@ -0,0 +1,188 @@
+// Times the small Utils and Logger primitives that run once per file, where
+// per-file CPU cost hides: nanoseconds and heap allocations per call.
+// Allocations are counted by replacing the global operator new.
+//
+// Usage: cclean_microbench [--iterations N] [--filter TEXT]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <string>
+#include "cleaner.h"
+#include "logger.h"
+#include "utils.h"
+
+namespace fs = std::filesystem;
+using namespace CClean;
+
+namespace {
+std::atomic<size_t> allocationCount(0);
+}
+
+void* operator new(std::size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* block = std::malloc(size ? size : 1)) {
+        return block;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* block) noexcept {
+    std::free(block);
+}
+
+void operator delete[](void* block) noexcept {
+    std::free(block);
+}
+
+void operator delete(void* block, std::size_t) noexcept {
+    std::free(block);
+}
+
+void operator delete[](void* block, std::size_t) noexcept {
+    std::free(block);
+}
+
+namespace {
+
+// Results are folded into this so the optimizer cannot drop the work
+volatile size_t sink = 0;
+
+size_t iterations = 1000000;
+std::string filter;
+
+void runCase(const std::string& name, const std::function<size_t()>& operation, size_t divisor = 1) {
+    if (!filter.empty() && name.find(filter) == std::string::npos) {
+        return;
+    }
+
+    size_t count = std::max<size_t>(iterations / divisor, 1);
+    for (size_t i = 0; i < count / 100 + 1; ++i) {
+        sink = sink + operation();
+    }
+
+    size_t allocationsBefore = allocationCount.load(std::memory_order_relaxed);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; ++i) {
+        sink = sink + operation();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    size_t allocations = allocationCount.load(std::memory_order_relaxed) - allocationsBefore;
+
+    std::cout << "  " << std::left << std::setw(44) << name << std::right << std::fixed
+              << std::setprecision(1) << std::setw(10) << seconds * 1e9 / static_cast<double>(count) << " ns/op"
+              << std::setprecision(2) << std::setw(8) << static_cast<double>(allocations) / static_cast<double>(count)
+              << " allocs/op\n";
+}
+
+CleanupResult categoryResult(size_t seed) {
+    CleanupResult result;
+    result.filesScanned = seed;
+    result.filesDeleted = seed / 2;
+    result.bytesFreed = seed * 4096;
+    return result;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        if (arg == "--iterations") {
+            iterations = std::strtoull(argv[i + 1], nullptr, 10);
+        } else if (arg == "--filter") {
+            filter = argv[i + 1];
+        }
+    }
+
+#ifdef _WIN32
+    const std::string directory = "C:\\Users\\bench\\AppData\\Local\\Temp\\cache2\\entries";
+    const std::string withVariable = "%TEMP%\\cache2\\entries";
+#else
+    const std::string directory = "/home/bench/.cache/mozilla/firefox/cache2/entries";
+    const std::string withVariable = "%HOME%/.cache/mozilla/firefox/cache2/entries";
+#endif
+    const std::string fileName = "0A1B2C3D4E5F60718293A4B5C6D7E8F901234567";
+    const std::string filePath = directory + "/" + fileName;
+    const std::string message = "Deleted: " + filePath + " (12.34 KB)";
+
+    std::cout << "Per-call cost over " << iterations << " iterations\n\n";
+
+    std::cout << "Utils:\n";
+    runCase("formatBytes(512)", [] { return Utils::formatBytes(512).size(); });
+    runCase("formatBytes(3.2 GB)", [] { return Utils::formatBytes(3435973837ULL).size(); });
+    runCase("getCurrentTimestamp", [] { return Utils::getCurrentTimestamp().size(); }, 10);
+    runCase("expandEnvironmentVariables (no variable)", [&] {
+        return Utils::expandEnvironmentVariables(directory).size();
+    });
+    runCase("expandEnvironmentVariables (one variable)", [&] {
+        return Utils::expandEnvironmentVariables(withVariable).size();
+    });
+
+    std::cout << "\nPath joining:\n";
+    runCase("std::string dir + \"/\" + name", [&] { return (directory + "/" + fileName).size(); });
+    runCase("fs::path(dir) / name", [&] { return (fs::path(directory) / fileName).native().size(); });
+    runCase("fs::path(dir) / name, .string()", [&] { return (fs::path(directory) / fileName).string().size(); });
+
+    std::cout << "\nshouldDeleteFile name filters:\n";
+    runCase("isProtectedFileName (regular file)", [&] {
+        return static_cast<size_t>(CCleaner::isProtectedFileName(filePath));
+    });
+    runCase("isProtectedFileName (thumbs.db)", [&] {
+        return static_cast<size_t>(CCleaner::isProtectedFileName(directory + "/thumbs.db"));
+    });
+
+    std::cout << "\nLogger:\n";
+    fs::path logPath = fs::temp_directory_path() / "cclean_microbench.log";
+    Logger& logger = Logger::getInstance();
+    logger.setLogFile(logPath.string());
+    logger.setConsoleLogging(false);
+
+    logger.setLogLevel(LogLevel::ERROR);
+    runCase("log below level, prebuilt message", [&] { logger.info(message); return size_t(1); });
+    runCase("log below level, message built by caller", [&] {
+        logger.info("Deleted: " + filePath + " (" + Utils::formatBytes(12636) + ")");
+        return size_t(1);
+    });
+
+    logger.setLogLevel(LogLevel::INFO);
+    runCase("log to file", [&] { logger.info(message); return size_t(1); }, 10);
+
+    std::cout << "\nCleanupResult:\n";
+    runCase("merge four category results", [] {
+        CleanupResult total;
+        for (size_t category = 1; category <= 4; ++category) {
+            auto result = categoryResult(category);
+            total.filesScanned += result.filesScanned;
+            total.filesDeleted += result.filesDeleted;
+            total.bytesFreed += result.bytesFreed;
+        }
+        return total.bytesFreed;
+    });
+    runCase("merge with error message", [] {
+        CleanupResult total;
+        CleanupResult result = categoryResult(7);
+        result.errorMessage = "Failed to delete C:\\Windows\\Temp\\locked.tmp: Access is denied.";
+        total.filesScanned += result.filesScanned;
+        total.bytesFreed += result.bytesFreed;
+        if (total.errorMessage.empty()) {
+            total.errorMessage = result.errorMessage;
+        }
+        return total.errorMessage.size();
+    });
+
+    logger.setLogFile(LOG_FILE);
+    std::error_code ec;
+    fs::remove(logPath, ec);
+    return 0;
+}
@@ -0,0 +1,154 @@
+// Measures how much of a large file is left in the page cache after reading
+// it through a plain ifstream versus Utils::readFileContents, and whether a
+// pre-existing hot set survives the read. Residency comes from cachestat
+// (Linux 6.5+) or mincore.
+//
+// Usage: cclean_cachebench [--size MB] [--hot PERCENT] [--dir PATH]
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "utils.h"
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+using namespace CClean;
+
+namespace {
+
+#ifndef _WIN32
+
+void dropFromCache(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        fdatasync(fd);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+}
+
+// Reads the first `bytes` plainly, standing in for pages another process keeps hot
+void warm(const std::string& path, size_t bytes) {
+    std::ifstream in(path, std::ios::binary);
+    std::vector<char> buffer(1024 * 1024);
+    for (size_t done = 0; done < bytes && in; done += buffer.size()) {
+        in.read(buffer.data(), static_cast<std::streamsize>(std::min(buffer.size(), bytes - done)));
+    }
+}
+
+double residentPercent(const std::string& path) {
+    size_t cached = 0;
+    size_t total = 0;
+    if (!Utils::pageCacheResidency(path, cached, total) || total == 0) {
+        return -1.0;
+    }
+    return 100.0 * static_cast<double>(cached) / static_cast<double>(total);
+}
+
+void runCase(const std::string& name, const std::string& path, size_t hotBytes,
+             const std::function<size_t()>& read) {
+    dropFromCache(path);
+    if (hotBytes > 0) {
+        warm(path, hotBytes);
+    }
+    double before = residentPercent(path);
+
+    auto start = std::chrono::steady_clock::now();
+    size_t bytes = read();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double after = residentPercent(path);
+
+    std::cout << "  " << std::left << std::setw(30) << name << std::right << std::fixed << std::setprecision(1)
+              << std::setw(8) << static_cast<double>(bytes) / (1024.0 * 1024.0) / seconds << " MB/s"
+              << "   cached " << std::setw(5) << before << "% -> " << std::setw(5) << after << "%\n";
+}
+
+#endif
+
+}
+
+int main(int argc, char* argv[]) {
+#ifdef _WIN32
+    (void)argc;
+    (void)argv;
+    std::cerr << "cclean_cachebench needs posix_fadvise and mincore\n";
+    return 1;
+#else
+    size_t sizeMB = 512;
+    size_t hotPercent = 25;
+    fs::path base = fs::temp_directory_path();
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        if (arg == "--size") {
+            sizeMB = std::strtoull(argv[i + 1], nullptr, 10);
+        } else if (arg == "--hot") {
+            hotPercent = std::strtoull(argv[i + 1], nullptr, 10);
+        } else if (arg == "--dir") {
+            base = argv[i + 1];
+        }
+    }
+
+    std::string path = (base / "cclean_cachebench.dat").string();
+    std::cout << "Writing " << sizeMB << " MB to " << path << "...\n";
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        std::vector<char> block(1024 * 1024);
+        for (size_t i = 0; i < block.size(); ++i) {
+            block[i] = static_cast<char>(i * 2654435761u >> 24);
+        }
+        for (size_t i = 0; i < sizeMB; ++i) {
+            out.write(block.data(), static_cast<std::streamsize>(block.size()));
+        }
+    }
+
+    size_t hotBytes = sizeMB * 1024 * 1024 / 100 * hotPercent;
+
+    auto plainRead = [&] {
+        std::ifstream in(path, std::ios::binary);
+        std::vector<char> buffer(1024 * 1024);
+        size_t total = 0;
+        while (in.read(buffer.data(), static_cast<std::streamsize>(buffer.size())) || in.gcount() > 0) {
+            total += static_cast<size_t>(in.gcount());
+        }
+        return total;
+    };
+
+    auto contentRead = [&](bool direct) {
+        return [&path, direct] {
+            size_t total = 0;
+            std::string error;
+            Utils::ContentIoOptions options;
+            options.direct = direct;
+            Utils::readFileContents(path, [&](const char*, size_t size) { total += size; return true; }, error, options);
+            if (!error.empty()) {
+                std::cerr << error << "\n";
+            }
+            return total;
+        };
+    };
+
+    std::cout << "\nCold file:\n";
+    runCase("ifstream", path, 0, plainRead);
+    runCase("Utils::readFileContents", path, 0, contentRead(false));
+    runCase("Utils::readFileContents direct", path, 0, contentRead(true));
+
+    std::cout << "\nFirst " << hotPercent << "% already cached by someone else:\n";
+    runCase("ifstream", path, hotBytes, plainRead);
+    runCase("Utils::readFileContents", path, hotBytes, contentRead(false));
+    runCase("Utils::readFileContents direct", path, hotBytes, contentRead(true));
+
+    fs::remove(path);
+    return 0;
+#endif
+}
@@ -0,0 +1,113 @@
+// Compares TreeRemover against std::filesystem::remove_all and rm -rf on
+// freshly generated trees.
+//
+// Usage: cclean_rmbench [--files N] [--per-dir N] [--threads N] [--dir PATH]
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include "tree_remover.h"
+
+namespace fs = std::filesystem;
+using namespace CClean;
+
+namespace {
+
+// Two directory levels of perDir entries each; with the default of 100 a
+// million files spread over ten thousand leaf directories, like a cache tree
+void buildTree(const fs::path& root, size_t files, size_t perDir) {
+    fs::create_directories(root);
+
+    size_t created = 0;
+    for (size_t outer = 0; created < files; ++outer) {
+        fs::path outerDir = root / ("d" + std::to_string(outer));
+        fs::create_directory(outerDir);
+
+        for (size_t inner = 0; inner < perDir && created < files; ++inner) {
+            fs::path innerDir = outerDir / ("s" + std::to_string(inner));
+            fs::create_directory(innerDir);
+
+            for (size_t i = 0; i < perDir && created < files; ++i, ++created) {
+                std::ofstream(innerDir / ("f" + std::to_string(i))) << "cclean";
+            }
+        }
+    }
+}
+
+void runCase(const std::string& name, const fs::path& root, size_t files, size_t perDir,
+             const std::function<void()>& remove) {
+    std::cout << "  building " << files << " files for " << name << "..." << std::flush;
+    buildTree(root, files, perDir);
+
+    // Let writeback of the new tree settle so it doesn't land in the timing
+    std::system("sync");
+
+    auto start = std::chrono::steady_clock::now();
+    remove();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "\r  " << std::left << std::setw(28) << name << std::right << std::fixed
+              << std::setprecision(3) << std::setw(9) << seconds << " s"
+              << std::setw(12) << static_cast<size_t>(files / seconds) << " files/s"
+              << (fs::exists(root) ? "  (tree NOT removed)" : "") << "\n";
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    size_t files = 1000000;
+    size_t perDir = 100;
+    size_t threads = 0;
+    fs::path base = fs::temp_directory_path() / "cclean_rmbench";
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        if (arg == "--files") {
+            files = std::strtoull(argv[i + 1], nullptr, 10);
+        } else if (arg == "--per-dir") {
+            perDir = std::strtoull(argv[i + 1], nullptr, 10);
+        } else if (arg == "--threads") {
+            threads = std::strtoull(argv[i + 1], nullptr, 10);
+        } else if (arg == "--dir") {
+            base = argv[i + 1];
+        }
+    }
+
+    fs::path root = base / "tree";
+    std::cout << "Removing " << files << " files (" << perDir << " per directory) under " << base << "\n";
+
+    runCase("TreeRemover", root, files, perDir, [&] {
+        TreeRemover remover(threads);
+        CleanupResult result = remover.remove(root.string());
+        if (!result.success) {
+            std::cerr << "\n  " << result.errorMessage << "\n";
+        }
+    });
+
+    runCase("TreeRemover (no byte count)", root, files, perDir, [&] {
+        TreeRemover remover(threads);
+        remover.setCountBytes(false);
+        remover.remove(root.string());
+    });
+
+    runCase("std::filesystem::remove_all", root, files, perDir, [&] {
+        std::error_code ec;
+        fs::remove_all(root, ec);
+    });
+
+#ifndef _WIN32
+    runCase("rm -rf", root, files, perDir, [&] {
+        std::string command = "rm -rf '" + root.string() + "'";
+        std::system(command.c_str());
+    });
+#endif
+
+    std::error_code ec;
+    fs::remove_all(base, ec);
+    return 0;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "config.h"
+
+namespace CClean {
+
+// Streaming summary of how a category's bytes are spread over file age, as
+// a merging t-digest: ages are weighted by file size and kept as at most a
+// few hundred centroids, finest at the youngest and oldest ends, however
+// many files were added. Sketches built on different threads merge into
+// one, so a scan never has to keep a list of every file it saw.
+class AgeSketch {
+public:
+    explicit AgeSketch(double compression = AGE_SKETCH_COMPRESSION);
+
+    // Files of zero bytes carry no weight and are ignored
+    void add(double ageDays, double bytes);
+    void merge(const AgeSketch& other);
+
+    bool empty() const;
+    double totalBytes() const;
+    size_t centroidCount() const;
+
+    // Age below which fraction (0..1) of the bytes lie
+    double quantile(double fraction) const;
+    // Bytes in files older than ageDays
+    double bytesOlderThan(double ageDays) const;
+    // Age cutoff such that files older than it add up to targetBytes;
+    // false when the whole sketch holds less than that
+    bool cutoffForBytes(double targetBytes, double& ageDays) const;
+
+private:
+    struct Centroid {
+        double mean;
+        double weight;
+    };
+
+    void flush();
+    // The centroids with any buffered adds folded in
+    std::vector<Centroid> compressed() const;
+    std::vector<Centroid> compress(std::vector<Centroid> points) const;
+
+    double compression_;
+    std::vector<Centroid> centroids_;
+    std::vector<Centroid> buffer_;
+    double totalBytes_;
+    double minimum_;
+    double maximum_;
+};
+
+}
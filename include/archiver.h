@@ -0,0 +1,75 @@
+#pragma once
+
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "config.h"
+
+namespace CClean {
+
+class IoThrottle;
+class KeepList;
+
+// Packs directories of many small, old files into one ustar archive per
+// directory (gzip-compressed when built with zlib). Archives are written
+// with large sequential writes under a temporary name, re-read and verified
+// against the checksums taken while writing, renamed into place, and only
+// then are the originals removed. Files that changed in the meantime are
+// left alone.
+class Archiver {
+public:
+    explicit Archiver(size_t threadCount = 0);
+
+    CleanupResult process(const std::vector<std::string>& rootPaths, bool cleanMode);
+
+    void setMinimumAgeDays(int days);
+    void setCompression(bool enabled);
+    void setThrottle(IoThrottle* throttle);
+    void setKeepList(const KeepList* keepList);
+    void setDryRun(bool enabled);
+    void setVerbose(bool enabled);
+
+    static bool compressionSupported();
+    static bool list(const std::string& archivePath, std::ostream& out, std::string& error);
+    static bool extract(const std::string& archivePath, const std::string& destination, std::string& error);
+
+private:
+    struct Member {
+        std::string path;
+        std::string name;
+        size_t size = 0;
+        size_t allocated = 0;   // disk usage, which is what archiving saves
+        long long mtime = 0;
+        // As collected; the original is removed only if all of it still matches
+        unsigned long long device = 0;
+        unsigned long long inode = 0;
+        long long modified = 0;     // nanoseconds
+        long long changed = 0;
+        unsigned int mode = 0;
+        unsigned int uid = 0;
+        unsigned int gid = 0;
+        unsigned long long checksum = 0;
+    };
+
+    void collectDirectories(const std::string& rootPath,
+                            std::vector<std::pair<std::string, std::vector<Member>>>& directories);
+    void archiveDirectory(const std::string& directory, std::vector<Member>& members);
+    bool writeArchive(const std::string& archivePath, std::vector<Member>& members, std::string& error);
+    bool verifyArchive(const std::string& archivePath, const std::vector<Member>& members, std::string& error);
+    void recordError(const std::string& error);
+
+    size_t threadCount_;
+    int minimumAgeDays_;
+    bool compress_;
+    IoThrottle* throttle_;
+    const KeepList* keepList_;
+    bool dryRun_;
+    bool verbose_;
+
+    std::mutex resultMutex_;
+    CleanupResult result_;
+    size_t archivesWritten_;
+};
+
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+namespace CClean {
+
+// Fixed-capacity multi-producer, multi-consumer queue. push() blocks while
+// the queue is full, which is what slows an upstream stage down to the pace
+// of the one it feeds; pop() blocks while it is empty and fails once the
+// queue is closed and drained. Depth is sampled on every pop.
+template <typename T>
+class BoundedQueue {
+public:
+    struct Stats {
+        size_t capacity = 0;
+        size_t maxDepth = 0;
+        double meanDepth = 0;
+    };
+
+    explicit BoundedQueue(size_t capacity)
+        : capacity_(capacity ? capacity : 1)
+        , closed_(false)
+        , maxDepth_(0)
+        , depthSum_(0)
+        , pops_(0) {
+    }
+
+    // Returns the seconds spent waiting for room
+    double push(T item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        double waited = 0;
+        if (items_.size() >= capacity_ && !closed_) {
+            auto start = std::chrono::steady_clock::now();
+            notFull_.wait(lock, [this] { return items_.size() < capacity_ || closed_; });
+            waited = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        items_.push_back(std::move(item));
+        if (items_.size() > maxDepth_) {
+            maxDepth_ = items_.size();
+        }
+        lock.unlock();
+        notEmpty_.notify_one();
+        return waited;
+    }
+
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        notEmpty_.wait(lock, [this] { return !items_.empty() || closed_; });
+        if (items_.empty()) {
+            return false;
+        }
+        depthSum_ += items_.size();
+        pops_++;
+        item = std::move(items_.front());
+        items_.pop_front();
+        lock.unlock();
+        notFull_.notify_one();
+        return true;
+    }
+
+    // No more pushes; consumers drain what is left
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+        }
+        notEmpty_.notify_all();
+        notFull_.notify_all();
+    }
+
+    Stats stats() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Stats stats;
+        stats.capacity = capacity_;
+        stats.maxDepth = maxDepth_;
+        stats.meanDepth = pops_ ? static_cast<double>(depthSum_) / static_cast<double>(pops_) : 0;
+        return stats;
+    }
+
+private:
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    const size_t capacity_;
+    mutable std::mutex mutex_;
+    std::condition_variable notEmpty_;
+    std::condition_variable notFull_;
+    std::deque<T> items_;
+    bool closed_;
+    size_t maxDepth_;
+    size_t depthSum_;
+    size_t pops_;
+};
+
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "config.h"
+#include "utils.h"
+
+namespace CClean {
+
+struct PipelineOptions {
+    size_t enumerateThreads = 0;    // 0 picks ThreadPool::defaultThreadCount()
+    size_t filterThreads = 0;
+    size_t deleteThreads = 0;
+    size_t enumerateBatch = PIPELINE_ENUMERATE_BATCH;
+    size_t filterBatch = PIPELINE_FILTER_BATCH;
+    size_t queueBatches = PIPELINE_QUEUE_BATCHES;   // capacity of each queue, in batches
+};
+
+struct PipelineStageStats {
+    std::string name;
+    size_t threads = 0;
+    size_t items = 0;
+    double busySeconds = 0;         // summed over the stage's threads
+    double starvedSeconds = 0;      // waiting on an empty input queue
+    double blockedSeconds = 0;      // waiting on a full output queue
+    size_t queueCapacity = 0;       // of the stage's input queue
+    size_t maxQueueDepth = 0;
+    double meanQueueDepth = 0;
+};
+
+// Runs the cleaning of one directory as three stages joined by bounded
+// queues of batches:
+//
+//   enumerate (walkFiles) -> filter (stat, in-use probe, rules) -> delete
+//
+// Each stage has its own threads and batch size, so the CPU-bound filtering
+// overlaps the metadata I/O on both sides. A full queue blocks its producer,
+// so a slow stage holds back the ones before it instead of letting batches
+// pile up. The per-stage stats show which stage limited throughput: it is
+// the one that is busy while its neighbours starve or block.
+class CleanPipeline {
+public:
+    struct Candidate {
+        std::string path;
+        size_t size = 0;
+        Utils::FileIdentity identity;
+        bool haveIdentity = false;
+    };
+
+    // Called on filter threads; false drops the file
+    using Filter = std::function<bool(Candidate& candidate)>;
+    // Called on delete threads for every file the filter passed
+    using Remover = std::function<void(Candidate& candidate)>;
+
+    explicit CleanPipeline(const PipelineOptions& options = PipelineOptions());
+
+    void run(const std::string& rootPath, const Filter& filter, const Remover& remover);
+
+    const std::vector<PipelineStageStats>& stats() const { return stats_; }
+    double elapsedSeconds() const { return elapsedSeconds_; }
+
+    // One line per stage: threads, items, utilization, queue depth
+    std::vector<std::string> describeStats() const;
+
+private:
+    PipelineOptions options_;
+    std::vector<PipelineStageStats> stats_;
+    double elapsedSeconds_;
+};
+
+}
@@ -2,10 +2,22 @@
 
 #include <vector>
 #include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
 #include "config.h"
+#include "io_throttle.h"
+#include "keep_list.h"
+#include "failure_cache.h"
+#include "clean_pipeline.h"
+#include "age_sketch.h"
+#include "large_files.h"
 
 namespace CClean {
 
+class MftScanner;
+class HandleList;
+
 class CCleaner {
 public:
     CCleaner();
@@ -20,26 +32,125 @@ public:
     CleanupResult scanSystemFiles();
     CleanupResult cleanSystemFiles();
     
+    CleanupResult scanRecycleBin();
     CleanupResult cleanRecycleBin();
     
+    CleanupResult scanGitArtifacts(const std::string& rootPath);
+    CleanupResult cleanGitArtifacts(const std::string& rootPath);
+    
+    CleanupResult scanSparsify(const std::vector<std::string>& rootPaths);
+    CleanupResult cleanSparsify(const std::vector<std::string>& rootPaths);
+    
+    CleanupResult scanArchive(const std::vector<std::string>& rootPaths);
+    CleanupResult cleanArchive(const std::vector<std::string>& rootPaths);
+    
+    CleanupResult scanThumbnails();
+    CleanupResult cleanThumbnails();
+    
+    CleanupResult scanJournal();
+    CleanupResult cleanJournal();
+    
     CleanupResult performFullScan();
     CleanupResult performFullClean();
     
+    // The categories the full scan and clean cover, in their order; each may
+    // be scanned or cleaned on its own thread alongside the others
+    static const std::vector<CleanupType>& fullCategories();
+    CleanupResult scanCategory(CleanupType type);
+    CleanupResult cleanCategory(CleanupType type);
+    
     void setProgressCallback(std::function<void(const std::string&, int)> callback);
     void setDryRun(bool enabled);
     void setVerbose(bool enabled);
+    void setRecycleBinRoot(const std::string& rootPath);
+    void setRecycleBinMinimumAge(int days);
+    void setMinimumFileSize(size_t bytes);
+    void setIoRateLimit(size_t bytesPerSecond);
+    void setFreeInodesTarget(size_t target, bool percent);
+    void setArchiveMinimumAge(int days);
+    void setArchiveCompression(bool enabled);
+    bool setKeepList(const std::string& listPath, std::string& error);
+    void setTierDestination(const std::string& destination);
+    void setTierMinimumAge(int days);
+    void setJournalMaximumAge(int days);
+    void setJournalMaximumSize(size_t bytes);
+    // When off, cleaning deletes without a stat per file and reports bytes
+    // freed from the change in free space on each filesystem
+    void setPerFileSize(bool enabled);
+    // Scans size NTFS folders from the volume's MFT (read once per volume)
+    // rather than walking them; none of the delete filters (in use, protected
+    // names, keep list, failure cache) are applied to those totals
+    void setUseMft(bool enabled);
+    // Threads and batch sizes of the enumerate/filter/delete stages that
+    // clean each category folder
+    void setPipelineOptions(const PipelineOptions& options);
+    // Files that keep failing to delete are skipped until they change or
+    // their backoff expires; saveFailureCache() persists what this run saw
+    bool setFailureCache(const std::string& cachePath, std::string& error);
+    bool saveFailureCache(std::string& error);
+    
+    // One path on each filesystem that any cleanup of this run deleted,
+    // moved or packed files on, e.g. for a trim afterwards
+    std::vector<std::string> cleanedFilesystems();
+    
+    // Scans also record each candidate in list, by its parent directory's
+    // file handle, so applyHandleList() can delete exactly those later
+    void setHandleList(HandleList* list);
+    CleanupResult applyHandleList(HandleList& list);
+    
+    // Files of at least minimumSize anywhere on the filesystems of rootPaths,
+    // largest first, leaving out files cleaning would never delete; found
+    // sees each one as soon as the walk comes across it
+    std::vector<LargeFile> findLargeFiles(const std::vector<std::string>& rootPaths, size_t minimumSize,
+                                          const std::function<void(const LargeFile&)>& found = nullptr);
+    
+    // How the bytes the last scan of a category found are spread over file
+    // age (modification time); false if it was not scanned file by file
+    bool ageSketch(const std::string& category, AgeSketch& sketch);
+    
+    // Explorer's per-folder metadata files, which are never deleted
+    static bool isProtectedFileName(const std::string& filePath);
     
 private:
-    CleanupResult scanPath(const std::string& path);
+    CleanupResult scanPath(const std::string& path, AgeSketch& ages);
+    bool scanPathFromMft(const std::string& expandedPath, CleanupResult& result);
     CleanupResult cleanPath(const std::string& path);
-    CleanupResult processPaths(const std::vector<std::string>& paths, bool cleanMode);
+    CleanupResult processPaths(const std::vector<std::string>& paths, bool cleanMode, const std::string& category);
+    CleanupResult processPathsForInodes(const std::vector<std::string>& paths, bool cleanMode);
+    CleanupResult processPathsForTier(const std::vector<std::string>& paths, bool cleanMode, const std::string& category);
     
+    void recordCleanedFilesystems(const std::vector<std::string>& paths, const CleanupResult& result);
+    std::string recycleBinRoot() const;
     void updateProgress(const std::string& message, int percentage);
     bool shouldDeleteFile(const std::string& filePath);
     
     std::function<void(const std::string&, int)> progressCallback_;
     bool dryRun_;
     bool verbose_;
+    std::string recycleBinRoot_;
+    int recycleBinMinimumAge_;
+    size_t minimumFileSize_;
+    size_t freeInodesTarget_;
+    bool freeInodesTargetPercent_;
+    int archiveMinimumAge_;
+    bool archiveCompression_;
+    std::string tierDestination_;
+    int tierMinimumAge_;
+    int journalMaximumAge_;
+    size_t journalMaximumSize_;
+    bool perFileSize_;
+    bool useMft_;
+    HandleList* handleList_;
+    PipelineOptions pipelineOptions_;
+    std::mutex mftMutex_;
+    std::mutex cleanedMutex_;
+    std::map<uint64_t, std::string> cleanedFilesystems_;
+    std::mutex ageSketchMutex_;
+    std::map<std::string, AgeSketch> ageSketches_;
+    std::map<std::string, std::unique_ptr<MftScanner>> mftVolumes_;
+    IoThrottle ioThrottle_;
+    KeepList keepList_;
+    FailureCache failureCache_;
     size_t totalBytesFound_;
     size_t totalFilesFound_;
 };
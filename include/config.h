@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -41,11 +43,93 @@ const std::vector<std::string> SYSTEM_CLEANUP_PATHS = {
 const int MAX_LOG_SIZE = 10 * 1024 * 1024; // 10MB
 const std::string LOG_FILE = "cclean.log";
 
+// Pressure stall pacing defaults (percent of wall time stalled on I/O or memory)
+const double PRESSURE_SLOWDOWN_PERCENT = 10.0;
+const double PRESSURE_PAUSE_PERCENT = 40.0;
+const double PRESSURE_RESUME_PERCENT = 20.0;
+const int PRESSURE_SAMPLE_INTERVAL_MS = 250;
+
+const size_t TREE_REMOVER_PROGRESS_STEP = 8192;
+const size_t TREE_REMOVER_SPLIT_ENTRIES = 16384;  // entries before a directory is shared between workers
+const size_t TREE_REMOVER_BATCH_ENTRIES = 1024;
+const size_t TREE_REMOVER_DIRENT_BUFFER_SIZE = 256 * 1024;
+const size_t TREE_REMOVER_MAX_OPEN_DIRECTORIES = 4096; // past this, subdirectories are removed depth-first
+const size_t TREE_REMOVER_OPEN_RETRIES = 50;         // EMFILE retries, 10 ms apart, before giving up on a directory
+
+const size_t WALK_BATCH_FILES = 4096;              // files a walker collects before handing them on
+const size_t PIPELINE_ENUMERATE_BATCH = 256;        // paths per batch handed to the filter stage
+const size_t PIPELINE_FILTER_BATCH = 64;            // files per batch handed to the delete stage
+const size_t PIPELINE_QUEUE_BATCHES = 32;           // batches a stage may run ahead of the next
+
+// Files below this per thread are sized by the scanning thread alone
+const size_t SCAN_MIN_FILES_PER_THREAD = 1024;
+
+// Bytes-weighted file age sketch (t-digest): centroid budget and adds buffered between compressions
+const double AGE_SKETCH_COMPRESSION = 100.0;
+const size_t AGE_SKETCH_BUFFER_SIZE = 512;
+
+// Post-clean FITRIM: ranges per ioctl, smallest free extent discarded, pause between ranges
+const uint64_t TRIM_CHUNK_SIZE = 4ULL * 1024 * 1024 * 1024;
+const uint64_t TRIM_MIN_EXTENT = 1024 * 1024;
+const int TRIM_CHUNK_PAUSE_MS = 100;
+
+const size_t SPARSIFY_MIN_FILE_SIZE = 64 * 1024 * 1024;
+const size_t SPARSIFY_READ_SIZE = 1024 * 1024;
+const size_t SPARSIFY_MIN_HOLE_SIZE = 64 * 1024;    // smaller runs only fragment the file
+const int SPARSIFY_MIN_IDLE_SECONDS = 600;
+
+const size_t INODE_RELIEF_PROBE_INTERVAL = 4096;    // deletions between statvfs checks
+
+const int ARCHIVE_MIN_AGE_DAYS = 30;
+const size_t ARCHIVE_MIN_FILES = 64;                // fewer files aren't worth an archive
+const size_t ARCHIVE_IO_BUFFER_SIZE = 1024 * 1024;
+
+const size_t CONTENT_IO_CHUNK_SIZE = 1024 * 1024;
+const size_t CONTENT_IO_READAHEAD = 8 * 1024 * 1024;    // requested ahead of the cursor
+
+const size_t CPU_AFFINITY_MAX_CPUS = 8192;
+
+const int IO_WATCHDOG_TIMEOUT_SECONDS = 30;         // 0 turns the watchdog off
+
+// Files that failed to delete are retried after 1h, 2h, 4h, ... up to a week
+const int64_t FAILURE_CACHE_BASE_BACKOFF_SECONDS = 3600;
+const int64_t FAILURE_CACHE_MAX_BACKOFF_SECONDS = 7 * 24 * 3600;
+const size_t FAILURE_CACHE_MAX_ENTRIES = 100000;
+
+const size_t MFT_READ_CHUNK_SIZE = 4 * 1024 * 1024;
+
+const size_t THUMBNAIL_HEADER_READ_SIZE = 4096;
+const size_t THUMBNAIL_HEADER_READ_LIMIT = 64 * 1024;
+const size_t THUMBNAIL_LIST_DIRECTORY_MIN = 8;      // sources per directory before one listing beats a stat each
+// A missing source directory under these may just be an unplugged drive
+const std::vector<std::string> THUMBNAIL_REMOVABLE_MOUNTS = {
+    "/media/",
+    "/run/media/",
+    "/mnt/"
+};
+const std::string FAILURE_CACHE_FILE = "failures.cache";
+
+// Large-file finder: default size floor, and the per-directory summary that
+// lets later runs skip subtrees; summary entries older than this are re-read
+const size_t LARGE_FILE_MIN_SIZE = 1024ULL * 1024 * 1024;
+const std::string LARGE_FILE_SUMMARY_FILE = "large_files.summary";
+const int LARGE_FILE_SUMMARY_MAX_AGE_DAYS = 7;
+
+const int JOURNAL_MAX_AGE_DAYS = 30;
+
+const int TIER_MIN_IDLE_DAYS = 30;
+const size_t TIER_COPY_CHUNK_SIZE = 8 * 1024 * 1024;
+
 enum class CleanupType {
     TEMP_FILES,
     BROWSER_CACHE, 
     SYSTEM_FILES,
     RECYCLE_BIN,
+    GIT_ARTIFACTS,
+    SPARSIFY,
+    ARCHIVE,
+    THUMBNAILS,
+    JOURNAL,
     ALL
 };
 
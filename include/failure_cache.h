@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "utils.h"
+
+namespace CClean {
+
+// Remembers files that could not be deleted (locked, permission denied, ...)
+// across runs, keyed by device, inode and modification time. An unchanged
+// file that failed before is skipped until its backoff expires; the backoff
+// doubles with every repeated failure with the same error. A file that was
+// modified or replaced is retried at once.
+class FailureCache {
+public:
+    FailureCache();
+
+    // A missing cache file is not an error; the cache then starts empty
+    bool load(const std::string& cachePath, std::string& error);
+    // Writes the cache back (atomically) if anything changed since load()
+    bool save(std::string& error);
+
+    bool isLoaded() const;
+    size_t size() const;
+
+    bool shouldSkip(const Utils::FileIdentity& identity) const;
+    void recordFailure(const Utils::FileIdentity& identity, int errorCode);
+    void recordSuccess(const Utils::FileIdentity& identity);
+
+    static std::string defaultPath();
+
+private:
+    struct FileHeader {
+        char magic[8];
+        uint64_t entryCount;
+    };
+
+    struct Entry {
+        uint64_t device;
+        uint64_t inode;
+        int64_t modified;
+        int64_t lastFailure;        // seconds since the epoch
+        int64_t retryAfter;
+        int32_t errorCode;
+        uint32_t failures;
+    };
+
+    using Key = std::pair<uint64_t, uint64_t>;     // device, inode
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+
+    void prune(int64_t now);
+
+    std::string path_;
+    bool loaded_;
+    bool dirty_;
+    mutable std::mutex mutex_;
+    std::unordered_map<Key, Entry, KeyHash> entries_;
+};
+
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include "config.h"
+
+namespace CClean {
+
+// Tells the SSD under a filesystem which blocks are free (FITRIM), so space
+// freed by a cleanup is returned now rather than at the next periodic
+// fstrim. The filesystem is trimmed in ranges of chunkSize bytes with a
+// pause after each, at idle I/O priority, so other I/O is never stuck
+// behind one long trim; requestStop() ends it after the current range.
+class FilesystemTrimmer {
+public:
+    struct Result {
+        uint64_t trimmedBytes = 0;      // as reported by the filesystem
+        uint64_t coveredBytes = 0;      // how far through the filesystem we got
+        uint64_t totalBytes = 0;
+        size_t chunks = 0;
+        bool interrupted = false;
+    };
+
+    FilesystemTrimmer();
+
+    // Any path on the filesystem; needs CAP_SYS_ADMIN
+    bool trim(const std::string& path, Result& result, std::string& error);
+
+    void setChunkSize(uint64_t bytes);
+    // Free extents shorter than this are left alone
+    void setMinimumExtent(uint64_t bytes);
+    void setPause(int milliseconds);
+
+    // Safe to call from a signal handler
+    static void requestStop();
+    static void clearStop();
+
+    static bool isSupported();
+
+private:
+    uint64_t chunkSize_;
+    uint64_t minimumExtent_;
+    int pauseMilliseconds_;
+
+    static std::atomic<bool> stopRequested_;
+};
+
+}
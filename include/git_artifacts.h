@@ -0,0 +1,111 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include "config.h"
+
+namespace CClean {
+
+class KeepList;
+class ThreadPool;
+
+struct GitIgnorePattern {
+    enum class Kind {
+        LITERAL,    // no wildcards: plain string compare
+        SUFFIX,     // "*.o": ends-with compare
+        PREFIX,     // "build*": starts-with compare
+        GLOB        // anything else goes through the glob matcher
+    };
+
+    std::string pattern;
+    Kind kind = Kind::GLOB;
+    bool negated = false;
+    bool directoryOnly = false;
+    bool anchored = false;  // contained a '/', matched against the path below the base
+};
+
+// The compiled contents of one .gitignore (or info/exclude) file.
+class GitIgnoreList {
+public:
+    GitIgnoreList() = default;
+    GitIgnoreList(const std::string& content, const std::string& baseDir);
+
+    static GitIgnoreList load(const std::string& filePath, const std::string& baseDir);
+
+    // Returns 1 if the last matching pattern ignores the path, -1 if it
+    // re-includes it with '!', and 0 if no pattern matches.
+    int match(const std::string& relPath, const std::string& name, bool isDirectory) const;
+
+    bool empty() const { return patterns_.empty(); }
+
+private:
+    void addPattern(std::string line);
+
+    std::string baseDir_;
+    std::vector<GitIgnorePattern> patterns_;
+};
+
+// Reader for the binary .git/index (versions 2, 3 and 4). Only the entry
+// paths are kept; they are what decides whether a file is tracked.
+class GitIndex {
+public:
+    bool load(const std::string& indexPath);
+
+    bool isTracked(const std::string& relPath) const;
+    bool hasTrackedUnder(const std::string& relDir) const;
+
+    size_t size() const { return paths_.size(); }
+
+private:
+    std::vector<std::string> paths_;
+};
+
+// Finds every git working tree below a root and removes ignored, untracked
+// files and directories the way `git clean -dX` would, without running git.
+// Nested repositories are processed as separate working trees.
+class GitArtifactCleaner {
+public:
+    explicit GitArtifactCleaner(size_t threadCount = 0);
+
+    CleanupResult process(const std::string& rootPath, bool cleanMode);
+
+    // Listed paths are never deleted; ignored directories holding one are
+    // walked file by file instead of being removed whole
+    void setKeepList(const KeepList* keepList);
+    void setDryRun(bool enabled);
+    void setVerbose(bool enabled);
+
+    size_t repositoriesProcessed() const { return repositoriesProcessed_; }
+
+private:
+    struct Artifact {
+        std::string path;
+        bool isDirectory;
+        size_t files;
+        size_t bytes;
+    };
+
+    struct Repository;
+
+    void discoverRepositories(ThreadPool& pool, const std::string& dirPath, bool cleanMode);
+    void processRepository(ThreadPool& pool, const std::string& workTree, bool cleanMode);
+    void walkDirectory(ThreadPool& pool, Repository& repo, const std::string& absDir,
+                       const std::string& relDir, std::vector<const GitIgnoreList*> ignoreStack,
+                       bool parentIgnored, bool cleanMode, std::vector<Artifact>& artifacts);
+    void removeArtifact(const Artifact& artifact);
+    void recordError(const std::string& error);
+
+    size_t threadCount_;
+    const KeepList* keepList_;
+    bool dryRun_;
+    bool verbose_;
+    size_t repositoriesProcessed_;
+
+    std::mutex resultMutex_;
+    CleanupResult result_;
+    std::vector<std::string> pendingDirectories_;
+    std::vector<std::string> emptiedDirectories_;
+};
+
+}
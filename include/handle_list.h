@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "config.h"
+#include "utils.h"
+
+namespace CClean {
+
+class FailureCache;
+
+// The candidates of a scan, saved so exactly those files can be deleted
+// after they have been reviewed. Each file is recorded as a file handle of
+// its parent directory (name_to_handle_at) plus its name and identity, not
+// as a path: apply() reopens the parent with open_by_handle_at, checks that
+// the name still refers to the same inode, unmodified, and unlinkat()s it.
+// No path is resolved for a candidate, so renaming or moving a directory
+// above it in between does not matter. Only each filesystem's mount point
+// is opened by path, once.
+//
+// Linux only; open_by_handle_at needs CAP_DAC_READ_SEARCH.
+class HandleList {
+public:
+    using FileFilter = std::function<bool(const std::string&)>;
+
+    HandleList();
+
+    static bool isSupported();
+
+    // Called from scan threads for each candidate; false when its
+    // filesystem cannot produce handles
+    bool add(const std::string& filePath, const Utils::FileIdentity& identity, std::string& error);
+    size_t size() const;
+    // Mount points of the filesystems the recorded files are on
+    std::vector<std::string> mountPaths() const;
+
+    bool save(const std::string& listPath, std::string& error) const;
+    bool load(const std::string& listPath, std::string& error);
+
+    // Deletes every recorded file that is still the one that was scanned;
+    // files that are gone or changed are counted and left alone
+    CleanupResult apply();
+
+    // Checked again at apply time, against the file's current path
+    void setFileFilter(FileFilter filter);
+    void setFailureCache(FailureCache* cache);
+    void setDryRun(bool enabled);
+    void setVerbose(bool enabled);
+
+    size_t filesMissing() const { return filesMissing_; }
+    size_t filesChanged() const { return filesChanged_; }
+
+private:
+    struct Mount {
+        uint64_t device = 0;
+        std::string path;
+    };
+
+    struct Parent {
+        uint32_t mount = 0;
+        int32_t handleType = 0;
+        std::string handle;
+    };
+
+    struct Entry {
+        uint32_t parent = 0;
+        Utils::FileIdentity identity;
+        std::string name;
+    };
+
+    void applyParent(uint32_t parentIndex, const std::vector<const Entry*>& entries, int mountFd);
+
+    mutable std::mutex mutex_;
+    std::vector<Mount> mounts_;
+    std::vector<Parent> parents_;
+    std::vector<Entry> entries_;
+    // Only while adding: parent directory path and mount id to their index
+    std::unordered_map<std::string, uint32_t> parentIndex_;
+    std::unordered_map<int, uint32_t> mountIndex_;
+
+    FileFilter filter_;
+    FailureCache* failureCache_;
+    bool dryRun_;
+    bool verbose_;
+
+    CleanupResult result_;
+    size_t filesMissing_;
+    size_t filesChanged_;
+};
+
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "config.h"
+
+namespace CClean {
+
+// Frees inodes rather than bytes: the walk aggregates file counts and bytes
+// per directory, directories are ranked by files per byte so the ones full of
+// tiny files go first, and deletion stops as soon as statvfs reports the
+// target number of free inodes (f_favail) on that filesystem.
+class InodeReliefCleaner {
+public:
+    using FileFilter = std::function<bool(const std::string&)>;
+
+    InodeReliefCleaner();
+
+    CleanupResult process(const std::vector<std::string>& rootPaths, bool cleanMode);
+
+    // An absolute inode count, or a percentage of the filesystem's inodes
+    void setTarget(size_t target, bool percent);
+    void setFileFilter(FileFilter filter);
+    void setDryRun(bool enabled);
+    void setVerbose(bool enabled);
+
+    static bool isSupported();
+
+private:
+    struct DirectoryStats {
+        std::string path;
+        bool isRoot = false;
+        unsigned long long device = 0;
+        std::vector<std::pair<std::string, size_t>> files;
+        size_t bytes = 0;
+    };
+
+    struct FilesystemState {
+        unsigned long long device = 0;
+        std::string probePath;
+        size_t available = 0;   // last measured f_favail
+        size_t target = 0;
+        size_t freedSinceProbe = 0;
+    };
+
+    void walk(const std::string& rootPath, std::vector<DirectoryStats>& directories);
+    FilesystemState* filesystemFor(unsigned long long device, const std::string& probePath);
+    bool probe(FilesystemState& state);
+    bool targetReached(FilesystemState& state, bool deleting);
+
+    size_t target_;
+    bool percent_;
+    FileFilter filter_;
+    bool dryRun_;
+    bool verbose_;
+    std::vector<FilesystemState> filesystems_;
+};
+
+}
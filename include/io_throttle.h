@@ -0,0 +1,28 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+
+namespace CClean {
+
+// Shared bandwidth cap for bulk reads and writes. Callers reserve the bytes
+// they are about to move and sleep until the budget allows it, so several
+// workers together never exceed the configured rate.
+class IoThrottle {
+public:
+    explicit IoThrottle(size_t bytesPerSecond = 0);
+
+    void acquire(size_t bytes);
+
+    // 0 disables the cap
+    void setRate(size_t bytesPerSecond);
+    size_t rate() const;
+
+private:
+    mutable std::mutex mutex_;
+    size_t bytesPerSecond_;
+    std::chrono::steady_clock::time_point nextAvailable_;
+};
+
+}
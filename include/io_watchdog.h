@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "config.h"
+#include "thread_pool.h"
+
+namespace CClean {
+
+// Watches for filesystem calls that never return, e.g. a stat on a stale
+// network mount or a dying disk. Code wraps blocking calls in a Scope; when
+// one stays in flight past the timeout its path is marked skipped (walks
+// then stop descending into it), and if it runs on a pool worker that
+// worker is abandoned so a replacement keeps the run moving. The stuck
+// paths are reported at the end of the run.
+class IoWatchdog {
+public:
+    struct StuckOperation {
+        std::string operation;
+        std::string path;
+        double seconds = 0.0;
+    };
+
+    // Registers one in-flight operation; a no-op while the watchdog is off
+    class Scope {
+    public:
+        Scope(const char* operation, const std::string& path);
+        ~Scope();
+
+        // For long operations made of many calls, such as listing a huge
+        // directory: restarts the timeout, so only a call that itself stops
+        // returning counts as stuck. Cheap enough to call per entry.
+        void progress();
+
+    private:
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        uint64_t id_;
+        std::chrono::steady_clock::time_point lastProgress_;
+    };
+
+    static IoWatchdog& getInstance();
+
+    void start(std::chrono::milliseconds timeout);
+    void stop();
+
+    bool isActive() const { return active_; }
+
+    // True for a path that got stuck and for anything below it
+    bool isSkipped(const std::string& path) const;
+    std::vector<StuckOperation> stuckOperations() const;
+
+private:
+    IoWatchdog();
+    ~IoWatchdog();
+    IoWatchdog(const IoWatchdog&) = delete;
+    IoWatchdog& operator=(const IoWatchdog&) = delete;
+
+    struct InFlight {
+        const char* operation;
+        std::string path;
+        std::chrono::steady_clock::time_point started;
+        std::shared_ptr<ThreadPool::Worker> worker;
+        uint64_t taskId = 0;
+        bool reported = false;
+    };
+
+    uint64_t enter(const char* operation, const std::string& path);
+    void leave(uint64_t id);
+    void restart(uint64_t id, std::chrono::steady_clock::time_point now);
+    void watchLoop();
+
+    std::chrono::milliseconds timeout_;
+    std::atomic<bool> active_;
+    std::atomic<size_t> skippedCount_;
+    bool stopping_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable stopRequested_;
+    std::thread watcher_;
+    uint64_t nextId_;
+    std::map<uint64_t, InFlight> inFlight_;
+    std::vector<std::string> skipped_;
+    std::vector<StuckOperation> stuck_;
+};
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "config.h"
+
+namespace CClean {
+
+// The fields of a systemd .journal file header that vacuuming needs
+struct JournalHeader {
+    uint8_t state = 0;              // JOURNAL_STATE_OFFLINE, _ONLINE or _ARCHIVED
+    uint64_t headRealtime = 0;      // microseconds since the epoch, 0 when empty
+    uint64_t tailRealtime = 0;
+};
+
+// Removes archived systemd journal files by age or to fit a size cap, the
+// way `journalctl --vacuum-time/--vacuum-size` does but without running it.
+// Each journal directory is listed once and only the fixed header at the
+// start of each .journal file is read. Files journald is writing to (no '@'
+// in the name, or a header still marked online) are never selected.
+class JournalVacuum {
+public:
+    using FileFilter = std::function<bool(const std::string&)>;
+
+    JournalVacuum();
+
+    CleanupResult process(const std::vector<std::string>& rootPaths, bool cleanMode);
+
+    // Archived files whose newest entry is older than this are removed
+    void setMaximumAgeDays(int days);
+    // Then the oldest archived files go until each directory fits; 0 is no cap
+    void setMaximumSize(size_t bytes);
+    void setFileFilter(FileFilter filter);
+    void setDryRun(bool enabled);
+    void setVerbose(bool enabled);
+
+    // /var/log/journal and /run/log/journal
+    static std::vector<std::string> defaultRoots();
+
+    static bool readHeader(const std::string& filePath, JournalHeader& header, uint64_t& diskSize,
+                           std::string& error);
+
+private:
+    struct JournalFile {
+        std::string path;
+        JournalHeader header;
+        uint64_t diskSize = 0;
+        bool archived = false;
+    };
+
+    void vacuumDirectory(const std::string& directory, bool cleanMode, CleanupResult& result);
+
+    int maximumAgeDays_;
+    size_t maximumSize_;
+    FileFilter filter_;
+    bool dryRun_;
+    bool verbose_;
+};
+
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include "mapped_file.h"
+
+namespace CClean {
+
+// Paths that must not be deleted, e.g. files a backup has not picked up yet.
+// The plain-text list (one path per line) is indexed once into a cache file:
+// a bucket directory over 64-bit path hashes followed by (hash, line offset)
+// entries sorted by hash. Every directory above a listed path gets an entry
+// too, tagged with its length, so prefix queries are lookups as well. Both files are memory-mapped, so a lookup touches a
+// few pages however long the list is, and every hash hit is confirmed against
+// the list text so collisions never keep the wrong file.
+class KeepList {
+public:
+    KeepList();
+
+    // Maps the cached index, rebuilding it first when it is missing or was
+    // built from a different version of the list
+    bool load(const std::string& listPath, std::string& error);
+
+    bool isLoaded() const;
+    size_t size() const;
+
+    // True for a listed path and for anything below a listed directory
+    bool contains(const std::string& path) const;
+
+    // True when some listed path lies below the directory
+    bool containsBelow(const std::string& directory) const;
+
+    static bool buildIndex(const std::string& listPath, const std::string& indexPath,
+                           size_t threadCount, std::string& error);
+
+private:
+    struct IndexHeader {
+        char magic[8];
+        uint64_t sourceSize;
+        int64_t sourceModified;
+        uint64_t entryCount;
+        uint64_t pathCount;
+        uint32_t bucketBits;
+        uint32_t reserved;
+    };
+
+    // Ancestor entries carry their length in the top bits of the offset
+    struct IndexEntry {
+        uint64_t hash;
+        uint64_t offset;
+    };
+
+    static std::string indexPathFor(const std::string& listPath);
+    bool mapIndex(const std::string& indexPath, uint64_t sourceSize, int64_t sourceModified);
+    bool containsExact(const char* path, size_t length) const;
+
+    MappedFile list_;
+    MappedFile index_;
+    const IndexHeader* header_;
+    const uint64_t* buckets_;
+    const IndexEntry* entries_;
+};
+
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "config.h"
+#include "thread_pool.h"
+
+namespace CClean {
+
+struct LargeFile {
+    std::string path;
+    size_t size = 0;
+};
+
+// Finds files of at least a minimum size anywhere below the given roots,
+// staying on each root's filesystem, one directory per task in parallel.
+//
+// What each directory held is kept in a summary between runs: its
+// modification time, its largest file and the largest file in its subtree.
+// A directory whose mtime is unchanged has had no entries added, removed or
+// renamed. When its subtree's largest file was below the minimum, the
+// subtree is only revalidated by stat'ing its directories, without listing
+// or stat'ing any file; when just its own largest file was, its entries are
+// not listed again. Files growing in place leave the mtime alone, so
+// entries are trusted for LARGE_FILE_SUMMARY_MAX_AGE_DAYS only.
+class LargeFileFinder {
+public:
+    using FileFilter = std::function<bool(const std::string&)>;
+    // Called from walker threads as files are found, in no particular order
+    using FoundCallback = std::function<void(const LargeFile& file)>;
+
+    explicit LargeFileFinder(size_t threadCount = 0);
+    ~LargeFileFinder();
+
+    // Sorted by size, largest first
+    std::vector<LargeFile> find(const std::vector<std::string>& rootPaths, const FoundCallback& found = nullptr);
+
+    void setMinimumSize(size_t bytes);
+    void setFileFilter(FileFilter filter);
+    void setVerbose(bool enabled);
+
+    // A missing summary is not an error; the first run then walks everything
+    bool loadSummary(const std::string& summaryPath, std::string& error);
+    bool saveSummary(std::string& error);
+
+    size_t directoriesListed() const { return directoriesListed_; }
+    size_t directoriesReused() const { return directoriesReused_; }
+    size_t subtreesSkipped() const { return subtreesSkipped_; }
+
+    static std::string defaultSummaryPath();
+
+private:
+    struct DirectoryRecord {
+        int64_t modified = 0;           // nanoseconds since the epoch
+        int64_t checked = 0;            // seconds since the epoch, when last listed
+        uint64_t largestFile = 0;       // directly in the directory
+        uint64_t largestInSubtree = 0;
+    };
+    using Summary = std::unordered_map<std::string, DirectoryRecord>;
+
+    struct WalkState;
+
+    static void walkDirectory(const std::string& directory, uint64_t device, const std::shared_ptr<WalkState>& state,
+                              const ThreadPool::Submitter& submit);
+    static void skipSubtree(const std::string& directory, uint64_t device, const std::shared_ptr<WalkState>& state,
+                            const ThreadPool::Submitter& submit);
+    void updateSubtreeMaxima();
+
+    size_t threadCount_;
+    size_t minimumSize_;
+    FileFilter filter_;
+    bool verbose_;
+
+    std::string summaryPath_;
+    Summary summary_;
+    bool summaryChanged_;
+
+    size_t directoriesListed_;
+    size_t directoriesReused_;
+    size_t subtreesSkipped_;
+};
+
+}
@@ -3,6 +3,7 @@
 #include <string>
 #include <fstream>
 #include <memory>
+#include <mutex>
 #include "config.h"
 
 namespace CClean {
@@ -25,6 +26,7 @@ public:
     void debug(const std::string& message);
     
     void logCleanupResult(CleanupType type, const CleanupResult& result);
+    static std::string cleanupTypeName(CleanupType type);
     void startSession();
     void endSession();
     
@@ -43,6 +45,7 @@ private:
     void writeToConsole(const std::string& message);
     void rotateLogs();
     
+    std::mutex mutex_;
     std::unique_ptr<std::ofstream> logFile_;
     std::string logFilename_;
     bool consoleLogging_;
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace CClean {
+
+// Read-only memory mapping of a whole file. Pages are faulted in on access,
+// so large on-disk tables cost only the pages a lookup actually touches.
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+
+    bool open(const std::string& path, std::string& error);
+    void close();
+
+    // Hint that accesses will be scattered rather than sequential
+    void adviseRandom();
+
+    bool isOpen() const { return open_; }
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open_;
+    const char* data_;
+    size_t size_;
+#ifdef _WIN32
+    void* file_;
+    void* mapping_;
+#endif
+};
+
+}
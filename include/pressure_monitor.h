@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "config.h"
+
+namespace CClean {
+
+struct PressureThresholds {
+    double slowdownPercent = PRESSURE_SLOWDOWN_PERCENT;
+    double pausePercent = PRESSURE_PAUSE_PERCENT;
+    double resumePercent = PRESSURE_RESUME_PERCENT;
+};
+
+// Samples Linux pressure stall information (the cgroup's io.pressure and
+// memory.pressure when available, /proc/pressure otherwise) and paces the
+// scan and delete loops: above the slowdown threshold workers give up part
+// of each interval, above the pause threshold they block until stalls fall
+// back below the resume threshold.
+class PressureMonitor {
+public:
+    enum class State {
+        RUNNING,
+        SLOWED,
+        PAUSED
+    };
+
+    static PressureMonitor& getInstance();
+
+    // Returns false when no PSI source is readable (non-Linux hosts, kernels
+    // without CONFIG_PSI); pace() is then a no-op.
+    bool start(const PressureThresholds& thresholds,
+               std::chrono::milliseconds interval = std::chrono::milliseconds(PRESSURE_SAMPLE_INTERVAL_MS));
+    void stop();
+
+    // Called once per item by worker loops; cheap while pressure is low
+    void pace();
+
+    bool isActive() const { return active_; }
+    State state() const { return state_.load(std::memory_order_relaxed); }
+    double pausedSeconds() const;
+    double slowedSeconds() const;
+    std::string sourceDescription() const;
+
+private:
+    PressureMonitor();
+    ~PressureMonitor();
+    PressureMonitor(const PressureMonitor&) = delete;
+    PressureMonitor& operator=(const PressureMonitor&) = delete;
+
+    struct Source {
+        std::string path;
+        int fd = -1;
+        unsigned long long lastTotal = 0;
+    };
+
+    bool openSource(Source& source, const std::string& cgroupFile, const std::string& systemFile);
+    bool readStallTotal(Source& source, unsigned long long& total);
+    void samplingLoop();
+    void updateState(double stallPercent);
+
+    PressureThresholds thresholds_;
+    std::chrono::milliseconds interval_;
+    Source ioSource_;
+    Source memorySource_;
+
+    std::atomic<State> state_;
+    std::atomic<double> severity_;
+    std::atomic<bool> active_;
+    bool stopping_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable resumed_;
+    std::condition_variable stopRequested_;
+    std::thread sampler_;
+    std::chrono::steady_clock::duration pausedTime_;
+    std::chrono::steady_clock::duration slowedTime_;
+};
+
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <mutex>
+#include "config.h"
+
+namespace CClean {
+
+// One deleted item, described by its $I metadata record. The payload lives
+// in the $R file (or directory) with the same suffix.
+struct RecycleBinEntry {
+    std::string infoPath;
+    std::string dataPath;
+    std::string originalPath;
+    uint64_t size = 0;
+    int64_t deletionTime = 0;  // Unix seconds
+};
+
+// Sizes and purges a $Recycle.Bin tree from the small $I records alone,
+// processing every per-user <SID> folder in parallel. Works on any host, so
+// fixture directories can stand in for a real drive.
+class RecycleBinCleaner {
+public:
+    explicit RecycleBinCleaner(size_t threadCount = 0);
+
+    // Parses a version 1 (Vista-8.1) or version 2 (Windows 10+) $I record
+    static bool parseInfoRecord(const std::string& data, RecycleBinEntry& entry);
+    static bool parseInfoFile(const std::string& infoPath, RecycleBinEntry& entry);
+
+    // Returns false if rootPath has no <SID> folders, i.e. it is not a
+    // $Recycle.Bin directory the parser understands.
+    bool scan(const std::string& rootPath);
+
+    // Removes the $R payload and $I record of every scanned entry older
+    // than the configured minimum age (all entries if the age is 0).
+    CleanupResult purge();
+
+    const std::vector<RecycleBinEntry>& entries() const { return entries_; }
+    CleanupResult scanResult() const;
+
+    void setMinimumAgeDays(int days);
+    void setDryRun(bool enabled);
+    void setVerbose(bool enabled);
+
+private:
+    bool isEligible(const RecycleBinEntry& entry) const;
+    void scanUserFolder(const std::string& sidPath, std::vector<RecycleBinEntry>& entries);
+    void purgeEntry(const RecycleBinEntry& entry);
+    void finishEntry(const RecycleBinEntry& entry, std::string error);
+
+    size_t threadCount_;
+    int minimumAgeDays_;
+    int64_t cutoffTime_;
+    bool dryRun_;
+    bool verbose_;
+
+    std::mutex resultMutex_;
+    std::vector<RecycleBinEntry> entries_;
+    std::vector<const RecycleBinEntry*> pendingDirectories_;
+    CleanupResult result_;
+};
+
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include "config.h"
+
+namespace CClean {
+
+class IoThrottle;
+
+// Returns zero-filled regions of large files (VM images, preallocated
+// databases, core dumps) to the filesystem. Existing holes are skipped with
+// SEEK_DATA/SEEK_HOLE, data is read in large chunks and checked for all-zero
+// blocks with a SIMD kernel, and zero runs are deallocated with
+// fallocate(FALLOC_FL_PUNCH_HOLE). Contents and mtime are unchanged.
+//
+// Files that another process holds a lock on, or that were modified within
+// SPARSIFY_MIN_IDLE_SECONDS, are skipped: a concurrent write into a range we
+// have just read as zero would otherwise be lost.
+class Sparsifier {
+public:
+    explicit Sparsifier(size_t threadCount = 0);
+
+    // Scan mode reports the zero bytes that could be punched; clean mode
+    // punches them and reports the allocation actually returned.
+    CleanupResult process(const std::vector<std::string>& rootPaths, bool cleanMode);
+
+    void setMinimumFileSize(size_t bytes);
+    void setThrottle(IoThrottle* throttle);
+    void setDryRun(bool enabled);
+    void setVerbose(bool enabled);
+
+    static bool isZeroBlock(const char* data, size_t size);
+
+private:
+    struct FileResult {
+        size_t zeroBytes = 0;
+        size_t bytesReturned = 0;
+    };
+
+    void collectCandidates(const std::string& rootPath, std::vector<std::pair<size_t, std::string>>& candidates);
+    bool sparsifyFile(const std::string& filePath, bool punch, FileResult& fileResult, std::string& error);
+
+    size_t threadCount_;
+    size_t minimumFileSize_;
+    IoThrottle* throttle_;
+    bool dryRun_;
+    bool verbose_;
+
+    std::mutex resultMutex_;
+    CleanupResult result_;
+};
+
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <queue>
+#include <thread>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+namespace CClean {
+
+class ThreadPool {
+public:
+    struct Worker;
+    using Submitter = std::function<void(std::function<void()>)>;
+
+    explicit ThreadPool(size_t threadCount = 0);
+    ~ThreadPool();
+
+    // Tasks may submit further tasks; wait() returns once the queue is
+    // drained and no task is running.
+    void submit(std::function<void()> task);
+    void wait();
+
+    // Submits into this pool and stays safe to call after the pool is gone
+    // (the task is then dropped), for tasks that may outlive it
+    Submitter submitter();
+
+    size_t size() const;
+
+    static size_t defaultThreadCount();
+
+    // The pool worker running the calling thread, or null outside any pool
+    static std::shared_ptr<Worker> currentWorker();
+    // Identifies the task the calling worker is running; 0 outside any pool
+    static uint64_t currentTaskId();
+
+    // Gives up on a worker whose task is blocked (e.g. in a hung stat): its
+    // task no longer counts towards wait(), a replacement worker takes over
+    // the queue, and the blocked thread exits on its own if the call ever
+    // returns. Tasks that can be abandoned must only capture state they
+    // share ownership of.
+    // Nothing happens unless taskId is still the task the worker runs, so a
+    // task that finished meanwhile is never written off in its successor's place.
+    static void abandon(const std::shared_ptr<Worker>& worker, uint64_t taskId);
+
+private:
+    struct State;
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    static void startWorker(const std::shared_ptr<State>& state);
+    static void enqueue(const std::shared_ptr<State>& state, std::function<void()> task);
+    static void workerLoop(std::shared_ptr<State> state, std::shared_ptr<Worker> worker);
+
+    std::shared_ptr<State> state_;
+    size_t threadCount_;
+};
+
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "config.h"
+
+namespace CClean {
+
+// Removes freedesktop.org thumbnails (~/.cache/thumbnails) whose source file
+// no longer exists. Only the PNG text chunks in front of the image data are
+// read to find each thumbnail's Thumb::URI. Sources are then checked one
+// directory at a time: a directory with many thumbnailed files is listed
+// once instead of stat'ing each source. Sources under removable-media mount
+// points whose directory is missing are kept, since the drive may just be
+// unplugged.
+class ThumbnailCleaner {
+public:
+    using FileFilter = std::function<bool(const std::string&)>;
+
+    explicit ThumbnailCleaner(size_t threadCount = 0);
+
+    CleanupResult process(const std::vector<std::string>& rootPaths, bool cleanMode);
+
+    void setFileFilter(FileFilter filter);
+    void setDryRun(bool enabled);
+    void setVerbose(bool enabled);
+
+    // $XDG_CACHE_HOME/thumbnails and the legacy ~/.thumbnails
+    static std::vector<std::string> defaultRoots();
+
+    // Thumb::URI from a tEXt or uncompressed iTXt chunk before the image data
+    static bool readSourceUri(const std::string& thumbnailPath, std::string& uri);
+    // Local path of a file:// URI; false for other schemes and remote hosts
+    static bool uriToPath(const std::string& uri, std::string& path);
+
+private:
+    enum class SourceState {
+        UNKNOWN,
+        EXISTS,
+        MISSING
+    };
+
+    struct Thumbnail {
+        std::string path;
+        std::string sourcePath;
+        SourceState state = SourceState::UNKNOWN;
+    };
+
+    void collectThumbnails(const std::string& rootPath, std::vector<Thumbnail>& thumbnails);
+    void checkSources(const std::string& directory, std::vector<Thumbnail*>& thumbnails);
+
+    size_t threadCount_;
+    FileFilter filter_;
+    bool dryRun_;
+    bool verbose_;
+
+    std::mutex resultMutex_;
+    CleanupResult result_;
+};
+
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "config.h"
+
+namespace CClean {
+
+class IoThrottle;
+
+// Moves files nobody has used for a while to a slower, cheaper volume
+// instead of deleting them. Each file lands at DESTINATION/<its absolute
+// path>. Within one filesystem that is a rename; across filesystems the
+// data goes through copy_file_range, falling back to sendfile and then to a
+// buffered copy. Mode, ownership, timestamps and extended attributes are
+// carried over, the copy is synced and size-checked, and the source is only
+// removed if it did not change while it was being copied.
+class TierMover {
+public:
+    using FileFilter = std::function<bool(const std::string&)>;
+
+    explicit TierMover(size_t threadCount = 0);
+
+    CleanupResult process(const std::vector<std::string>& rootPaths, bool cleanMode);
+
+    void setDestination(const std::string& destination);
+    // A file counts as used when it was read or written
+    void setMinimumIdleDays(int days);
+    void setFileFilter(FileFilter filter);
+    void setThrottle(IoThrottle* throttle);
+    void setDryRun(bool enabled);
+    void setVerbose(bool enabled);
+
+    // Bytes whose data had to be copied and the rate achieved, for the last run
+    size_t bytesCopied() const;
+    double throughputMBps() const;
+
+private:
+    struct Candidate {
+        std::string path;
+        size_t size = 0;
+    };
+
+    void collectCandidates(const std::string& rootPath, std::vector<Candidate>& candidates);
+    std::string targetPathFor(const std::string& sourcePath) const;
+    bool moveFile(const Candidate& candidate, bool& copied, std::string& error);
+    bool copyFile(const std::string& sourcePath, const std::string& targetPath, std::string& error);
+
+    std::string destination_;
+    size_t threadCount_;
+    int minimumIdleDays_;
+    FileFilter filter_;
+    IoThrottle* throttle_;
+    bool dryRun_;
+    bool verbose_;
+
+    std::mutex resultMutex_;
+    CleanupResult result_;
+    size_t bytesCopied_;
+    double throughputMBps_;
+};
+
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "config.h"
+
+namespace CClean {
+
+class ThreadPool;
+
+// Parallel rm -rf for subtrees that need no per-file decision. Each
+// directory is enumerated by one worker through its directory fd; files are
+// unlinked relative to that fd, subdirectories are fanned out to other
+// workers, and a directory is removed as soon as its last child completes.
+// A directory with more than TREE_REMOVER_SPLIT_ENTRIES entries is split:
+// its enumerating worker streams batches of names to the others, which
+// stat and unlink them concurrently through the same fd.
+// Each directory's fd stays open until its children finish, so once
+// TREE_REMOVER_MAX_OPEN_DIRECTORIES are open, newly found subdirectories are
+// removed depth-first by the worker that found them instead of being queued.
+class TreeRemover {
+public:
+    using ProgressCallback = std::function<void(size_t filesRemoved, size_t bytesRemoved)>;
+
+    explicit TreeRemover(size_t threadCount = 0);
+    ~TreeRemover();
+
+    CleanupResult remove(const std::string& rootPath, bool keepRoot = false);
+    CleanupResult remove(const std::vector<std::string>& rootPaths, bool keepRoots = false);
+
+    // Invoked from worker threads roughly every TREE_REMOVER_PROGRESS_STEP files
+    void setProgressCallback(ProgressCallback callback);
+
+    // Byte counts cost one fstatat per file; disable when only speed matters
+    void setCountBytes(bool enabled);
+
+    // A directory holding an entry with this name (e.g. ".git") is left in
+    // place with everything below it, and so are its ancestors
+    void setPreserveMarker(const std::string& name);
+
+    size_t directoriesRemoved() const { return directoriesRemoved_; }
+    const std::vector<std::string>& preservedDirectories() const { return preserved_; }
+
+private:
+    struct Node;
+
+    void processDirectory(Node* node);
+#ifndef _WIN32
+    void enumerateDirectory(Node* node, std::vector<Node*>& deferred);
+    void removeEntry(Node* node, const char* name, unsigned char type, std::vector<Node*>& deferred);
+#endif
+    void preserve(Node* node);
+    void finishChild(Node* node);
+    void completeDirectory(Node* node);
+    void countFile(size_t bytes);
+    void recordError(const std::string& error);
+
+    size_t threadCount_;
+    bool countBytes_;
+    std::string preserveMarker_;
+    ProgressCallback progressCallback_;
+
+    ThreadPool* pool_;
+    std::atomic<size_t> filesRemoved_;
+    std::atomic<size_t> bytesRemoved_;
+    std::atomic<size_t> directoriesRemoved_;
+    std::atomic<size_t> errorCount_;
+    std::atomic<size_t> openDirectories_;
+    std::atomic<size_t> openLimit_;
+
+    std::mutex mutex_;
+    std::string firstError_;
+    std::vector<std::string> preserved_;
+};
+
+}
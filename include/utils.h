@@ -1,8 +1,11 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <string>
 #include <vector>
-#include <windows.h>
+#include "config.h"
 
 namespace CClean {
 namespace Utils {
@@ -11,8 +14,36 @@ std::string expandEnvironmentVariables(const std::string& path);
 
 std::vector<std::string> findFiles(const std::string& path, const std::string& pattern = "*");
 
+// Streams the files below a directory to consumer in batches of up to
+// batchSize, handed on while the directory is still being read, from
+// threadCount walker threads (0 picks the default). The consumer is called
+// concurrently and may block, which holds back that walker only.
+using FileBatchConsumer = std::function<void(std::vector<std::string>& files)>;
+void walkFiles(const std::string& path, const FileBatchConsumer& consumer, size_t threadCount = 0,
+               size_t batchSize = WALK_BATCH_FILES);
+
 size_t getFileSize(const std::string& filePath);
 
+// Which file a path names and its version: same device, inode and
+// modification time means the file has not been replaced or rewritten
+struct FileIdentity {
+    uint64_t device = 0;
+    uint64_t inode = 0;
+    int64_t modified = 0;       // nanoseconds since the epoch
+    size_t size = 0;
+};
+
+// One stat (lstat on POSIX, an attribute-only open on Windows)
+bool getFileIdentity(const std::string& filePath, FileIdentity& identity);
+
+// Free bytes on the filesystem holding path; filesystemId is equal for
+// paths on the same filesystem
+bool getFilesystemSpace(const std::string& path, uint64_t& filesystemId, uint64_t& freeBytes);
+
+// Commits the filesystem holding path, so space freed by deletions shows up
+// in getFilesystemSpace (ext4 and XFS release blocks at journal commit)
+bool syncFilesystem(const std::string& path);
+
 size_t getDirectorySize(const std::string& dirPath);
 
 bool deleteFileSecure(const std::string& filePath);
@@ -23,6 +54,9 @@ bool isFileInUse(const std::string& filePath);
 
 std::string formatBytes(size_t bytes);
 
+// Parses "512", "64K", "1.5G", "10MB" (binary units) into a byte count
+bool parseByteSize(const std::string& text, size_t& bytes);
+
 std::string getCurrentTimestamp();
 
 bool hasAdminRights();
@@ -31,11 +65,56 @@ void requestAdminRights();
 
 std::string getRecycleBinPath();
 
+// Per-user directory for state kept between runs (created on demand by callers)
+std::string getCacheDirectory();
+
 bool emptyRecycleBin();
 
 bool pathExists(const std::string& path);
 
 std::string getLastError();
 
+// errno, or GetLastError() on Windows; read it before anything else can reset it
+int getLastErrorCode();
+
+// Sequential content access that leaves the page cache as it found it:
+// read-ahead is requested for a bounded window in front of the cursor,
+// pages we pulled in are dropped behind it (pages that were already cached
+// are left alone), O_DIRECT is used when asked for and the filesystem
+// accepts it, and atime is not touched when we are allowed to say so.
+struct ContentIoOptions {
+    size_t chunkSize = CONTENT_IO_CHUNK_SIZE;
+    size_t readAhead = CONTENT_IO_READAHEAD;
+    size_t limit = SIZE_MAX;        // stop after this many bytes
+    bool direct = false;
+    bool dropBehind = true;
+};
+
+// The consumer sees the file in order; returning false stops the read early
+using ContentConsumer = std::function<bool(const char* data, size_t size)>;
+
+bool readFileContents(const std::string& filePath, const ContentConsumer& consumer, std::string& error,
+                      const ContentIoOptions& options = ContentIoOptions());
+
+// Creates (or truncates) target; written pages are flushed and dropped as
+// the copy advances
+bool copyFileContents(const std::string& sourcePath, const std::string& targetPath, std::string& error,
+                      const ContentIoOptions& options = ContentIoOptions());
+
+// Bytes of the file currently resident in the page cache
+bool pageCacheResidency(const std::string& filePath, size_t& cachedBytes, size_t& totalBytes);
+
+// Parses and formats CPU lists such as "0-3,8,10-11"
+bool parseCpuList(const std::string& text, std::vector<unsigned int>& cpus);
+std::string formatCpuList(const std::vector<unsigned int>& cpus);
+
+// CPUs this process may run on: its affinity mask, which cgroup cpusets and
+// taskset narrow, rather than the machine's core count
+std::vector<unsigned int> allowedCpus();
+
+// Restricts the process to cpus. Threads inherit the mask when they are
+// created, so this must run before any worker or monitor thread starts.
+bool setCpuAffinity(const std::vector<unsigned int>& cpus, std::string& error);
+
 }
 }
\ No newline at end of file
@@ -0,0 +1,207 @@
+#include "age_sketch.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace CClean {
+
+namespace {
+
+const double PI = 3.14159265358979323846;
+
+// The t-digest k1 scale: a centroid may span one unit of k, which keeps
+// centroids small near q = 0 and q = 1 and lets them grow in the middle
+double scaleOf(double q, double compression) {
+    return compression / (2 * PI) * std::asin(2 * q - 1);
+}
+
+double quantileOfScale(double k, double compression) {
+    if (k >= compression / 4) {
+        return 1;
+    }
+    return (std::sin(k * 2 * PI / compression) + 1) / 2;
+}
+
+double interpolate(double from, double to, double t) {
+    return from + (to - from) * std::min(std::max(t, 0.0), 1.0);
+}
+
+}
+
+AgeSketch::AgeSketch(double compression)
+    : compression_(compression)
+    , totalBytes_(0)
+    , minimum_(std::numeric_limits<double>::max())
+    , maximum_(0) {
+}
+
+void AgeSketch::add(double ageDays, double bytes) {
+    if (bytes <= 0) {
+        return;
+    }
+    ageDays = std::max(ageDays, 0.0);       // modified in the future
+
+    buffer_.push_back({ageDays, bytes});
+    totalBytes_ += bytes;
+    minimum_ = std::min(minimum_, ageDays);
+    maximum_ = std::max(maximum_, ageDays);
+
+    if (buffer_.size() >= AGE_SKETCH_BUFFER_SIZE) {
+        flush();
+    }
+}
+
+void AgeSketch::merge(const AgeSketch& other) {
+    if (other.empty()) {
+        return;
+    }
+    buffer_.insert(buffer_.end(), other.centroids_.begin(), other.centroids_.end());
+    buffer_.insert(buffer_.end(), other.buffer_.begin(), other.buffer_.end());
+    totalBytes_ += other.totalBytes_;
+    minimum_ = std::min(minimum_, other.minimum_);
+    maximum_ = std::max(maximum_, other.maximum_);
+    flush();
+}
+
+bool AgeSketch::empty() const {
+    return totalBytes_ <= 0;
+}
+
+double AgeSketch::totalBytes() const {
+    return totalBytes_;
+}
+
+size_t AgeSketch::centroidCount() const {
+    return compressed().size();
+}
+
+double AgeSketch::quantile(double fraction) const {
+    auto centroids = compressed();
+    if (centroids.empty()) {
+        return 0;
+    }
+    if (centroids.size() == 1) {
+        return interpolate(minimum_, maximum_, fraction);
+    }
+
+    // Each centroid's mean sits at the middle of its weight; between two
+    // middles the age is interpolated linearly, and towards the ends
+    // against the exact minimum and maximum
+    double target = std::min(std::max(fraction, 0.0), 1.0) * totalBytes_;
+    const Centroid& first = centroids.front();
+    if (target < first.weight / 2) {
+        return interpolate(minimum_, first.mean, target / (first.weight / 2));
+    }
+
+    double cumulative = 0;
+    for (size_t i = 0; i + 1 < centroids.size(); ++i) {
+        double left = cumulative + centroids[i].weight / 2;
+        double right = cumulative + centroids[i].weight + centroids[i + 1].weight / 2;
+        if (target < right) {
+            return interpolate(centroids[i].mean, centroids[i + 1].mean, (target - left) / (right - left));
+        }
+        cumulative += centroids[i].weight;
+    }
+
+    const Centroid& last = centroids.back();
+    double lastMiddle = totalBytes_ - last.weight / 2;
+    return interpolate(last.mean, maximum_, (target - lastMiddle) / (last.weight / 2));
+}
+
+double AgeSketch::bytesOlderThan(double ageDays) const {
+    auto centroids = compressed();
+    if (centroids.empty() || ageDays < minimum_) {
+        return totalBytes_;
+    }
+    if (ageDays >= maximum_) {
+        return 0;
+    }
+
+    // Bytes younger than ageDays, by the same interpolation as quantile()
+    double younger = 0;
+    const Centroid& first = centroids.front();
+    const Centroid& last = centroids.back();
+    if (centroids.size() == 1) {
+        younger = totalBytes_ * (ageDays - minimum_) / (maximum_ - minimum_);
+    } else if (ageDays < first.mean) {
+        younger = first.weight / 2 * (ageDays - minimum_) / (first.mean - minimum_);
+    } else if (ageDays >= last.mean) {
+        younger = totalBytes_ - last.weight / 2 + last.weight / 2 * (ageDays - last.mean) / (maximum_ - last.mean);
+    } else {
+        double cumulative = 0;
+        for (size_t i = 0; i + 1 < centroids.size(); ++i) {
+            if (ageDays < centroids[i + 1].mean) {
+                double left = cumulative + centroids[i].weight / 2;
+                double right = cumulative + centroids[i].weight + centroids[i + 1].weight / 2;
+                double span = centroids[i + 1].mean - centroids[i].mean;
+                younger = interpolate(left, right, span > 0 ? (ageDays - centroids[i].mean) / span : 1);
+                break;
+            }
+            cumulative += centroids[i].weight;
+        }
+    }
+    return std::max(totalBytes_ - younger, 0.0);
+}
+
+bool AgeSketch::cutoffForBytes(double targetBytes, double& ageDays) const {
+    if (empty() || targetBytes > totalBytes_) {
+        return false;
+    }
+    ageDays = quantile(1 - targetBytes / totalBytes_);
+    return true;
+}
+
+void AgeSketch::flush() {
+    if (buffer_.empty()) {
+        return;
+    }
+    buffer_.insert(buffer_.end(), centroids_.begin(), centroids_.end());
+    centroids_ = compress(std::move(buffer_));
+    buffer_.clear();
+}
+
+std::vector<AgeSketch::Centroid> AgeSketch::compressed() const {
+    if (buffer_.empty()) {
+        return centroids_;
+    }
+    std::vector<Centroid> points = centroids_;
+    points.insert(points.end(), buffer_.begin(), buffer_.end());
+    return compress(std::move(points));
+}
+
+std::vector<AgeSketch::Centroid> AgeSketch::compress(std::vector<Centroid> points) const {
+    std::sort(points.begin(), points.end(),
+              [](const Centroid& a, const Centroid& b) { return a.mean < b.mean; });
+
+    double total = 0;
+    for (const auto& point : points) {
+        total += point.weight;
+    }
+
+    std::vector<Centroid> merged;
+    if (points.empty()) {
+        return merged;
+    }
+
+    // One pass in age order, merging each point into the current centroid
+    // while that stays within one unit of the scale function
+    Centroid current = points.front();
+    double before = 0;
+    double limit = quantileOfScale(scaleOf(0, compression_) + 1, compression_);
+    for (size_t i = 1; i < points.size(); ++i) {
+        const Centroid& point = points[i];
+        if ((before + current.weight + point.weight) / total <= limit) {
+            current.mean += (point.mean - current.mean) * point.weight / (current.weight + point.weight);
+            current.weight += point.weight;
+        } else {
+            merged.push_back(current);
+            before += current.weight;
+            limit = quantileOfScale(scaleOf(before / total, compression_) + 1, compression_);
+            current = point;
+        }
+    }
+    merged.push_back(current);
+    return merged;
+}
+
+}
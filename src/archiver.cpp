@@ -0,0 +1,775 @@
+#include "archiver.h"
+#include "io_throttle.h"
+#include "keep_list.h"
+#include "logger.h"
+#include "pressure_monitor.h"
+#include "thread_pool.h"
+#include "utils.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <sys/stat.h>
+#include <sys/types.h>
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <sys/utime.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <utime.h>
+#endif
+#ifdef CCLEAN_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#if defined(_WIN32) && !defined(S_ISREG)
+#define S_ISREG(m) (((m) & S_IFMT) == S_IFREG)
+#endif
+
+namespace fs = std::filesystem;
+
+namespace CClean {
+
+namespace {
+
+const size_t TAR_BLOCK_SIZE = 512;
+const char ARCHIVE_PREFIX[] = "cclean-archive-";
+const unsigned long long FNV_OFFSET_BASIS = 14695981039346656037ULL;
+const unsigned long long FNV_PRIME = 1099511628211ULL;
+
+unsigned long long fnv1a(unsigned long long hash, const char* data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+// Sequential archive I/O with a large buffer, through zlib when the archive
+// is compressed. gzread also passes plain tar files through untouched.
+class ArchiveStream {
+public:
+    ~ArchiveStream() { close(); }
+
+    bool openWrite(const std::string& path, bool compress) {
+#ifdef CCLEAN_HAVE_ZLIB
+        if (compress) {
+            gz_ = gzopen(path.c_str(), "wb6");
+            if (gz_) {
+                gzbuffer(gz_, static_cast<unsigned>(ARCHIVE_IO_BUFFER_SIZE));
+            }
+            return gz_ != nullptr;
+        }
+#else
+        (void)compress;
+#endif
+        return openFile(path, "wb");
+    }
+
+    bool openRead(const std::string& path) {
+#ifdef CCLEAN_HAVE_ZLIB
+        gz_ = gzopen(path.c_str(), "rb");
+        if (gz_) {
+            gzbuffer(gz_, static_cast<unsigned>(ARCHIVE_IO_BUFFER_SIZE));
+        }
+        return gz_ != nullptr;
+#else
+        return openFile(path, "rb");
+#endif
+    }
+
+    bool write(const char* data, size_t size) {
+#ifdef CCLEAN_HAVE_ZLIB
+        if (gz_) {
+            return size == 0 || gzwrite(gz_, data, static_cast<unsigned>(size)) == static_cast<int>(size);
+        }
+#endif
+        return std::fwrite(data, 1, size, file_) == size;
+    }
+
+    bool read(char* data, size_t size) {
+#ifdef CCLEAN_HAVE_ZLIB
+        if (gz_) {
+            return gzread(gz_, data, static_cast<unsigned>(size)) == static_cast<int>(size);
+        }
+#endif
+        return std::fread(data, 1, size, file_) == size;
+    }
+
+    bool close() {
+        bool ok = true;
+#ifdef CCLEAN_HAVE_ZLIB
+        if (gz_) {
+            ok = gzclose(gz_) == Z_OK;
+            gz_ = nullptr;
+        }
+#endif
+        if (file_) {
+            ok = std::fclose(file_) == 0 && ok;
+            file_ = nullptr;
+        }
+        return ok;
+    }
+
+private:
+    bool openFile(const std::string& path, const char* mode) {
+        file_ = std::fopen(path.c_str(), mode);
+        if (!file_) {
+            return false;
+        }
+        buffer_.resize(ARCHIVE_IO_BUFFER_SIZE);
+        std::setvbuf(file_, buffer_.data(), _IOFBF, buffer_.size());
+        return true;
+    }
+
+    std::FILE* file_ = nullptr;
+#ifdef CCLEAN_HAVE_ZLIB
+    gzFile gz_ = nullptr;
+#endif
+    std::vector<char> buffer_;
+};
+
+struct TarHeader {
+    std::string name;
+    size_t size = 0;
+    long long mtime = 0;
+    unsigned int mode = 0;
+    char type = '0';
+};
+
+// NUL-terminated octal when the value fits the field, otherwise GNU tar's
+// base-256 form (first byte 0x80, then the value big-endian), e.g. for
+// uids from container subuid ranges
+void writeOctal(char* field, size_t width, unsigned long long value) {
+    size_t digits = width - 1;
+    if (digits * 3 >= 64 || value < (1ULL << (digits * 3))) {
+        field[digits] = '\0';
+        for (size_t i = digits; i-- > 0;) {
+            field[i] = static_cast<char>('0' + (value & 7));
+            value >>= 3;
+        }
+        return;
+    }
+
+    std::memset(field, 0, width);
+    field[0] = static_cast<char>(0x80);
+    for (size_t i = width - 1; i > 0 && value != 0; --i) {
+        field[i] = static_cast<char>(value & 0xFF);
+        value >>= 8;
+    }
+}
+
+unsigned long long parseOctal(const char* field, size_t width) {
+    if (static_cast<unsigned char>(field[0]) & 0x80) {
+        unsigned long long value = 0;
+        for (size_t i = 1; i < width; ++i) {
+            value = (value << 8) | static_cast<unsigned char>(field[i]);
+        }
+        return value;
+    }
+    std::string text(field, strnlen(field, width));
+    return std::strtoull(text.c_str(), nullptr, 8);
+}
+
+unsigned int headerChecksum(const char* block) {
+    unsigned int sum = 0;
+    for (size_t i = 0; i < TAR_BLOCK_SIZE; ++i) {
+        // The checksum field itself counts as eight spaces
+        sum += (i >= 148 && i < 156) ? ' ' : static_cast<unsigned char>(block[i]);
+    }
+    return sum;
+}
+
+void buildHeader(char* block, const std::string& name, size_t size, long long mtime,
+                 unsigned int mode, unsigned int uid, unsigned int gid) {
+    std::memset(block, 0, TAR_BLOCK_SIZE);
+    std::memcpy(block, name.data(), std::min<size_t>(name.size(), 100));
+    writeOctal(block + 100, 8, mode & 07777);
+    writeOctal(block + 108, 8, uid);
+    writeOctal(block + 116, 8, gid);
+    writeOctal(block + 124, 12, size);
+    writeOctal(block + 136, 12, static_cast<unsigned long long>(std::max(mtime, 0LL)));
+    block[156] = '0';
+    std::memcpy(block + 257, "ustar", 6);
+    std::memcpy(block + 263, "00", 2);
+
+    writeOctal(block + 148, 7, headerChecksum(block));
+    block[155] = ' ';
+}
+
+// Returns false at the end-of-archive marker or on a malformed header
+bool parseHeader(const char* block, TarHeader& header, std::string& error) {
+    bool empty = std::all_of(block, block + TAR_BLOCK_SIZE, [](char c) { return c == 0; });
+    if (empty) {
+        return false;
+    }
+
+    if (parseOctal(block + 148, 8) != headerChecksum(block)) {
+        error = "corrupt header checksum";
+        return false;
+    }
+
+    header.name.assign(block, strnlen(block, 100));
+    if (std::memcmp(block + 257, "ustar", 5) == 0 && block[345] != '\0') {
+        header.name = std::string(block + 345, strnlen(block + 345, 155)) + "/" + header.name;
+    }
+    header.mode = static_cast<unsigned int>(parseOctal(block + 100, 8));
+    header.size = static_cast<size_t>(parseOctal(block + 124, 12));
+    header.mtime = static_cast<long long>(parseOctal(block + 136, 12));
+    header.type = block[156] == '\0' ? '0' : block[156];
+    return true;
+}
+
+size_t paddingFor(size_t size) {
+    return (TAR_BLOCK_SIZE - size % TAR_BLOCK_SIZE) % TAR_BLOCK_SIZE;
+}
+
+bool syncPath(const std::string& path) {
+#ifdef _WIN32
+    (void)path;
+    return true;
+#else
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+#endif
+}
+
+// Nanosecond modification and status-change times; a rewrite within the
+// same second, or a chmod or rename over the file, changes one of them
+long long modifiedNanoseconds(const struct stat& st) {
+#ifdef _WIN32
+    return static_cast<long long>(st.st_mtime) * 1000000000LL;
+#else
+    return static_cast<long long>(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+#endif
+}
+
+long long changedNanoseconds(const struct stat& st) {
+#ifdef _WIN32
+    return static_cast<long long>(st.st_ctime) * 1000000000LL;
+#else
+    return static_cast<long long>(st.st_ctim.tv_sec) * 1000000000LL + st.st_ctim.tv_nsec;
+#endif
+}
+
+// A new file only: an existing name, or a symlink planted under it, is
+// refused instead of being followed or truncated
+std::FILE* createExclusive(const std::string& path) {
+#ifdef _WIN32
+    int fd = _open(path.c_str(), _O_WRONLY | _O_CREAT | _O_EXCL | _O_BINARY, _S_IREAD | _S_IWRITE);
+    std::FILE* file = fd >= 0 ? _fdopen(fd, "wb") : nullptr;
+    if (fd >= 0 && !file) {
+        _close(fd);
+    }
+#else
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0600);
+    std::FILE* file = fd >= 0 ? fdopen(fd, "wb") : nullptr;
+    if (fd >= 0 && !file) {
+        close(fd);
+    }
+#endif
+    return file;
+}
+
+std::string archiveTimestamp() {
+    std::string timestamp = Utils::getCurrentTimestamp();
+    std::string compact;
+    for (char c : timestamp) {
+        if (c == ' ') {
+            compact += '-';
+        } else if (c != ':' && c != '-') {
+            compact += c;
+        }
+    }
+    return compact;
+}
+
+}
+
+Archiver::Archiver(size_t threadCount)
+    : threadCount_(threadCount)
+    , minimumAgeDays_(ARCHIVE_MIN_AGE_DAYS)
+    , compress_(false)
+    , throttle_(nullptr)
+    , keepList_(nullptr)
+    , dryRun_(false)
+    , verbose_(false)
+    , archivesWritten_(0) {
+}
+
+void Archiver::setMinimumAgeDays(int days) {
+    minimumAgeDays_ = days;
+}
+
+void Archiver::setCompression(bool enabled) {
+    compress_ = enabled && compressionSupported();
+}
+
+void Archiver::setThrottle(IoThrottle* throttle) {
+    throttle_ = throttle;
+}
+
+void Archiver::setKeepList(const KeepList* keepList) {
+    keepList_ = keepList;
+}
+
+void Archiver::setDryRun(bool enabled) {
+    dryRun_ = enabled;
+}
+
+void Archiver::setVerbose(bool enabled) {
+    verbose_ = enabled;
+}
+
+bool Archiver::compressionSupported() {
+#ifdef CCLEAN_HAVE_ZLIB
+    return true;
+#else
+    return false;
+#endif
+}
+
+CleanupResult Archiver::process(const std::vector<std::string>& rootPaths, bool cleanMode) {
+    result_ = CleanupResult();
+    archivesWritten_ = 0;
+
+    std::vector<std::pair<std::string, std::vector<Member>>> directories;
+    for (const auto& rootPath : rootPaths) {
+        collectDirectories(rootPath, directories);
+    }
+
+    size_t candidateFiles = 0;
+    size_t candidateBytes = 0;
+    size_t allocatedBytes = 0;
+    size_t tarBytes = 0;
+    for (const auto& directory : directories) {
+        candidateFiles += directory.second.size();
+        tarBytes += 2 * TAR_BLOCK_SIZE;
+        for (const auto& member : directory.second) {
+            candidateBytes += member.size;
+            allocatedBytes += member.allocated;
+            tarBytes += TAR_BLOCK_SIZE + member.size + paddingFor(member.size);
+        }
+    }
+    result_.filesScanned = candidateFiles;
+
+    if (!cleanMode || dryRun_) {
+        // Estimated against an uncompressed archive
+        result_.bytesFreed = allocatedBytes > tarBytes ? allocatedBytes - tarBytes : 0;
+        Logger::getInstance().info(std::string(cleanMode ? "DRY RUN: Would archive " : "Archivable: ") +
+                                   std::to_string(candidateFiles) + " files (" + Utils::formatBytes(candidateBytes) +
+                                   ") in " + std::to_string(directories.size()) + " directories");
+        if (cleanMode) {
+            result_.filesDeleted = candidateFiles;
+        }
+        return result_;
+    }
+
+    ThreadPool pool(threadCount_);
+    for (auto& directory : directories) {
+        auto* entry = &directory;
+        pool.submit([this, entry] { archiveDirectory(entry->first, entry->second); });
+    }
+    pool.wait();
+
+    Logger::getInstance().info("Archived " + std::to_string(result_.filesDeleted) + " files into " +
+                               std::to_string(archivesWritten_) + " archives (" +
+                               Utils::formatBytes(result_.bytesFreed) + " saved)");
+    return result_;
+}
+
+void Archiver::collectDirectories(const std::string& rootPath,
+                                  std::vector<std::pair<std::string, std::vector<Member>>>& directories) {
+    long long cutoff = static_cast<long long>(std::time(nullptr)) - static_cast<long long>(minimumAgeDays_) * 86400;
+    std::vector<std::string> pending = { rootPath };
+
+    while (!pending.empty()) {
+        std::string directory = pending.back();
+        pending.pop_back();
+
+        std::vector<Member> members;
+        std::error_code ec;
+        fs::directory_iterator it(directory, fs::directory_options::skip_permission_denied, ec);
+
+        for (; !ec && it != fs::directory_iterator(); it.increment(ec)) {
+            PressureMonitor::getInstance().pace();
+
+            std::error_code statEc;
+            if (it->is_symlink(statEc)) {
+                continue;
+            }
+            if (it->is_directory(statEc)) {
+                pending.push_back(it->path().string());
+                continue;
+            }
+
+            Member member;
+            member.path = it->path().string();
+            member.name = it->path().filename().string();
+
+            // ustar limits: 100-byte names and 8 GiB members
+            if (member.name.size() > 100 || member.name.compare(0, sizeof(ARCHIVE_PREFIX) - 1, ARCHIVE_PREFIX) == 0) {
+                continue;
+            }
+            if (keepList_ && keepList_->contains(member.path)) {
+                continue;
+            }
+
+            struct stat st;
+            if (stat(member.path.c_str(), &st) != 0 || !S_ISREG(st.st_mode) ||
+                static_cast<long long>(st.st_mtime) >= cutoff ||
+                static_cast<unsigned long long>(st.st_size) >= (1ULL << 33)) {
+                continue;
+            }
+
+            member.size = static_cast<size_t>(st.st_size);
+#ifdef _WIN32
+            member.allocated = member.size;
+#else
+            member.allocated = static_cast<size_t>(st.st_blocks) * 512;
+#endif
+            member.mtime = static_cast<long long>(st.st_mtime);
+            member.device = static_cast<unsigned long long>(st.st_dev);
+            member.inode = static_cast<unsigned long long>(st.st_ino);
+            member.modified = modifiedNanoseconds(st);
+            member.changed = changedNanoseconds(st);
+            member.mode = static_cast<unsigned int>(st.st_mode);
+            member.uid = static_cast<unsigned int>(st.st_uid);
+            member.gid = static_cast<unsigned int>(st.st_gid);
+            members.push_back(std::move(member));
+        }
+
+        if (members.size() >= ARCHIVE_MIN_FILES) {
+            directories.emplace_back(directory, std::move(members));
+        }
+    }
+}
+
+void Archiver::archiveDirectory(const std::string& directory, std::vector<Member>& members) {
+    std::string baseName = std::string(ARCHIVE_PREFIX) + archiveTimestamp();
+    std::string extension = compress_ ? ".tar.gz" : ".tar";
+    fs::path archivePath = fs::path(directory) / (baseName + extension);
+    for (int suffix = 1; fs::exists(archivePath); ++suffix) {
+        archivePath = fs::path(directory) / (baseName + "-" + std::to_string(suffix) + extension);
+    }
+    std::string partialPath = archivePath.string() + ".partial";
+
+    std::string error;
+    if (!writeArchive(partialPath, members, error) || !verifyArchive(partialPath, members, error)) {
+        std::error_code ec;
+        fs::remove(partialPath, ec);
+        recordError("Failed to archive " + directory + ": " + error);
+        return;
+    }
+
+    std::error_code ec;
+    fs::rename(partialPath, archivePath, ec);
+    if (ec || !syncPath(directory)) {
+        fs::remove(partialPath, ec);
+        recordError("Failed to archive " + directory + ": cannot move archive into place");
+        return;
+    }
+
+    size_t archiveSize = 0;
+    struct stat archiveStat;
+    if (stat(archivePath.string().c_str(), &archiveStat) == 0) {
+#ifdef _WIN32
+        archiveSize = static_cast<size_t>(archiveStat.st_size);
+#else
+        archiveSize = static_cast<size_t>(archiveStat.st_blocks) * 512;
+#endif
+    }
+    size_t removedFiles = 0;
+    size_t removedBytes = 0;
+
+    for (const auto& member : members) {
+        // Only originals still identical to the archived copy are removed
+        struct stat st;
+        if (stat(member.path.c_str(), &st) != 0 || static_cast<size_t>(st.st_size) != member.size ||
+            static_cast<unsigned long long>(st.st_dev) != member.device ||
+            static_cast<unsigned long long>(st.st_ino) != member.inode ||
+            modifiedNanoseconds(st) != member.modified || changedNanoseconds(st) != member.changed) {
+            continue;
+        }
+
+        if (Utils::deleteFileSecure(member.path)) {
+            removedFiles++;
+            removedBytes += member.allocated;
+        }
+    }
+
+    if (verbose_) {
+        Logger::getInstance().debug("Archived " + std::to_string(removedFiles) + " files from " + directory +
+                                    " into " + archivePath.filename().string() + " (" +
+                                    Utils::formatBytes(archiveSize) + ")");
+    }
+
+    std::lock_guard<std::mutex> lock(resultMutex_);
+    archivesWritten_++;
+    result_.filesDeleted += removedFiles;
+    result_.bytesFreed += removedBytes > archiveSize ? removedBytes - archiveSize : 0;
+}
+
+bool Archiver::writeArchive(const std::string& archivePath, std::vector<Member>& members, std::string& error) {
+    ArchiveStream out;
+    if (!out.openWrite(archivePath, compress_)) {
+        error = "cannot create " + archivePath;
+        return false;
+    }
+
+    char header[TAR_BLOCK_SIZE];
+    const char zeros[TAR_BLOCK_SIZE] = {};
+
+    for (auto& member : members) {
+        PressureMonitor::getInstance().pace();
+
+        buildHeader(header, member.name, member.size, member.mtime, member.mode, member.uid, member.gid);
+        if (!out.write(header, TAR_BLOCK_SIZE)) {
+            error = "write error on " + archivePath;
+            return false;
+        }
+
+        // Exactly the recorded size goes in, even if the file grows meanwhile
+        Utils::ContentIoOptions options;
+        options.chunkSize = ARCHIVE_IO_BUFFER_SIZE;
+        options.limit = member.size;
+
+        unsigned long long checksum = FNV_OFFSET_BASIS;
+        size_t copied = 0;
+        bool writeFailed = false;
+        bool ok = Utils::readFileContents(member.path, [&](const char* data, size_t size) {
+            if (throttle_) {
+                throttle_->acquire(size);
+            }
+            checksum = fnv1a(checksum, data, size);
+            copied += size;
+            writeFailed = !out.write(data, size);
+            return !writeFailed;
+        }, error, options);
+
+        if (ok && !writeFailed && copied != member.size) {
+            error = member.path + " shrank while archiving";
+            ok = false;
+        }
+
+        if (!ok || writeFailed || !out.write(zeros, paddingFor(member.size))) {
+            if (error.empty()) {
+                error = "write error on " + archivePath;
+            }
+            return false;
+        }
+        member.checksum = checksum;
+    }
+
+    if (!out.write(zeros, TAR_BLOCK_SIZE) || !out.write(zeros, TAR_BLOCK_SIZE) || !out.close()) {
+        error = "write error on " + archivePath;
+        return false;
+    }
+
+    if (!syncPath(archivePath)) {
+        error = "cannot flush " + archivePath;
+        return false;
+    }
+    return true;
+}
+
+bool Archiver::verifyArchive(const std::string& archivePath, const std::vector<Member>& members, std::string& error) {
+    ArchiveStream in;
+    if (!in.openRead(archivePath)) {
+        error = "cannot reopen " + archivePath;
+        return false;
+    }
+
+    std::vector<char> buffer(ARCHIVE_IO_BUFFER_SIZE);
+    char block[TAR_BLOCK_SIZE];
+
+    for (const auto& member : members) {
+        TarHeader header;
+        if (!in.read(block, TAR_BLOCK_SIZE) || !parseHeader(block, header, error) ||
+            header.name != member.name || header.size != member.size) {
+            error = "verification failed at " + member.name + (error.empty() ? "" : ": " + error);
+            return false;
+        }
+
+        unsigned long long checksum = FNV_OFFSET_BASIS;
+        size_t remaining = member.size + paddingFor(member.size);
+        size_t dataLeft = member.size;
+        while (remaining > 0) {
+            size_t length = std::min(remaining, buffer.size());
+            if (!in.read(buffer.data(), length)) {
+                error = "verification failed: archive truncated in " + member.name;
+                return false;
+            }
+            checksum = fnv1a(checksum, buffer.data(), std::min(length, dataLeft));
+            dataLeft -= std::min(length, dataLeft);
+            remaining -= length;
+        }
+
+        if (checksum != member.checksum) {
+            error = "verification failed: content mismatch in " + member.name;
+            return false;
+        }
+    }
+
+    TarHeader trailer;
+    if (!in.read(block, TAR_BLOCK_SIZE) || parseHeader(block, trailer, error)) {
+        error = "verification failed: missing end-of-archive marker";
+        return false;
+    }
+    return true;
+}
+
+bool Archiver::list(const std::string& archivePath, std::ostream& out, std::string& error) {
+    ArchiveStream in;
+    if (!in.openRead(archivePath)) {
+        error = "Cannot open " + archivePath;
+        return false;
+    }
+
+    std::vector<char> buffer(ARCHIVE_IO_BUFFER_SIZE);
+    char block[TAR_BLOCK_SIZE];
+    size_t members = 0;
+    size_t totalBytes = 0;
+
+    while (in.read(block, TAR_BLOCK_SIZE)) {
+        TarHeader header;
+        if (!parseHeader(block, header, error)) {
+            break;
+        }
+
+        std::time_t mtime = static_cast<std::time_t>(header.mtime);
+        char when[32] = "";
+        if (std::tm* local = std::localtime(&mtime)) {
+            std::strftime(when, sizeof(when), "%Y-%m-%d %H:%M", local);
+        }
+        out << std::string(12 - std::min<size_t>(12, std::to_string(header.size).size()), ' ')
+            << header.size << "  " << when << "  " << header.name << "\n";
+        members++;
+        totalBytes += header.size;
+
+        for (size_t remaining = header.size + paddingFor(header.size); remaining > 0;) {
+            size_t length = std::min(remaining, buffer.size());
+            if (!in.read(buffer.data(), length)) {
+                error = "Archive truncated in " + header.name;
+                return false;
+            }
+            remaining -= length;
+        }
+    }
+
+    if (!error.empty()) {
+        error = archivePath + ": " + error;
+        return false;
+    }
+
+    out << members << " files, " << Utils::formatBytes(totalBytes) << "\n";
+    return true;
+}
+
+bool Archiver::extract(const std::string& archivePath, const std::string& destination, std::string& error) {
+    ArchiveStream in;
+    if (!in.openRead(archivePath)) {
+        error = "Cannot open " + archivePath;
+        return false;
+    }
+
+    std::error_code ec;
+    fs::create_directories(destination, ec);
+
+    std::vector<char> buffer(ARCHIVE_IO_BUFFER_SIZE);
+    char block[TAR_BLOCK_SIZE];
+
+    while (in.read(block, TAR_BLOCK_SIZE)) {
+        TarHeader header;
+        if (!parseHeader(block, header, error)) {
+            break;
+        }
+
+        // cclean archives are flat; refuse anything that would escape
+        bool regular = header.type == '0';
+        if (!regular || header.name.empty() || header.name.find_first_of("/\\") != std::string::npos ||
+            header.name == "." || header.name == "..") {
+            error = "Unsupported archive member: " + header.name;
+            return false;
+        }
+
+        std::string targetPath = (fs::path(destination) / header.name).string();
+        std::FILE* out = createExclusive(targetPath);
+        if (!out) {
+            error = "Cannot create " + targetPath + ": " + std::strerror(errno);
+            return false;
+        }
+
+        bool ok = true;
+        size_t dataLeft = header.size;
+        for (size_t remaining = header.size + paddingFor(header.size); remaining > 0;) {
+            size_t length = std::min(remaining, buffer.size());
+            if (!in.read(buffer.data(), length)) {
+                error = "Archive truncated in " + header.name;
+                ok = false;
+                break;
+            }
+            size_t dataLength = std::min(length, dataLeft);
+            if (std::fwrite(buffer.data(), 1, dataLength, out) != dataLength) {
+                error = "Write error on " + targetPath;
+                ok = false;
+                break;
+            }
+            dataLeft -= dataLength;
+            remaining -= length;
+        }
+
+#ifndef _WIN32
+        // Through the descriptor we created, never by name again
+        if (ok && std::fflush(out) == 0) {
+            fchmod(fileno(out), static_cast<mode_t>(header.mode & 0777));
+            struct timespec times[2];
+            times[0].tv_sec = times[1].tv_sec = static_cast<std::time_t>(header.mtime);
+            times[0].tv_nsec = times[1].tv_nsec = 0;
+            futimens(fileno(out), times);
+        }
+#endif
+
+        if (std::fclose(out) != 0 || !ok) {
+            if (error.empty()) {
+                error = "Write error on " + targetPath;
+            }
+            return false;
+        }
+
+#ifdef _WIN32
+        fs::permissions(targetPath, static_cast<fs::perms>(header.mode & 0777), ec);
+
+        struct utimbuf times;
+        times.actime = static_cast<std::time_t>(header.mtime);
+        times.modtime = static_cast<std::time_t>(header.mtime);
+        utime(targetPath.c_str(), &times);
+#endif
+    }
+
+    if (!error.empty()) {
+        error = archivePath + ": " + error;
+        return false;
+    }
+    return true;
+}
+
+void Archiver::recordError(const std::string& error) {
+    Logger::getInstance().warning(error);
+
+    std::lock_guard<std::mutex> lock(resultMutex_);
+    if (result_.errorMessage.empty()) {
+        result_.errorMessage = error;
+    }
+}
+
+}
@@ -0,0 +1,237 @@
+#include "clean_pipeline.h"
+#include "bounded_queue.h"
+#include "logger.h"
+#include "pressure_monitor.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <thread>
+
+namespace CClean {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Time a stage thread spent on its own work, waiting for input and
+// waiting for room downstream
+struct ThreadTimes {
+    size_t items = 0;
+    double total = 0;
+    double starved = 0;
+    double blocked = 0;
+};
+
+void addThreadTimes(PipelineStageStats& stats, const std::vector<ThreadTimes>& times) {
+    for (const auto& thread : times) {
+        stats.items += thread.items;
+        stats.busySeconds += thread.total - thread.starved - thread.blocked;
+        stats.starvedSeconds += thread.starved;
+        stats.blockedSeconds += thread.blocked;
+    }
+}
+
+using PathBatch = std::vector<std::string>;
+using CandidateBatch = std::vector<CleanPipeline::Candidate>;
+
+// Everything the stage threads and walk tasks share. Walk tasks can be
+// abandoned by the I/O watchdog and deliver after run() has returned, so
+// they hold this by shared_ptr instead of referring to run()'s locals.
+struct RunState {
+    RunState(size_t queueBatches, size_t filterThreads, size_t deleteThreads)
+        : pathQueue(queueBatches)
+        , candidateQueue(queueBatches)
+        , filterTimes(filterThreads)
+        , deleteTimes(deleteThreads) {
+    }
+
+    BoundedQueue<PathBatch> pathQueue;
+    BoundedQueue<CandidateBatch> candidateQueue;
+    std::vector<ThreadTimes> filterTimes;
+    std::vector<ThreadTimes> deleteTimes;
+    std::atomic<size_t> enumerated{0};
+    std::atomic<int64_t> enumerateBlockedNanoseconds{0};
+};
+
+template <typename T>
+void addQueueStats(PipelineStageStats& stats, const BoundedQueue<T>& queue) {
+    auto queueStats = queue.stats();
+    stats.queueCapacity = queueStats.capacity;
+    stats.maxQueueDepth = queueStats.maxDepth;
+    stats.meanQueueDepth = queueStats.meanDepth;
+}
+
+}
+
+CleanPipeline::CleanPipeline(const PipelineOptions& options)
+    : options_(options)
+    , elapsedSeconds_(0) {
+    size_t defaultThreads = ThreadPool::defaultThreadCount();
+    if (options_.enumerateThreads == 0) options_.enumerateThreads = defaultThreads;
+    if (options_.filterThreads == 0) options_.filterThreads = defaultThreads;
+    if (options_.deleteThreads == 0) options_.deleteThreads = defaultThreads;
+    if (options_.enumerateBatch == 0) options_.enumerateBatch = 1;
+    if (options_.filterBatch == 0) options_.filterBatch = 1;
+}
+
+void CleanPipeline::run(const std::string& rootPath, const Filter& filter, const Remover& remover) {
+    auto state = std::make_shared<RunState>(options_.queueBatches, options_.filterThreads, options_.deleteThreads);
+    size_t filterBatch = options_.filterBatch;
+    auto start = Clock::now();
+
+    // The stage threads are joined before run() returns, so they may use
+    // filter and remover by reference
+    std::vector<std::thread> filterThreads;
+    for (size_t t = 0; t < options_.filterThreads; ++t) {
+        filterThreads.emplace_back([state, &filter, filterBatch, t] {
+            ThreadTimes& times = state->filterTimes[t];
+            auto threadStart = Clock::now();
+            CandidateBatch accepted;
+            accepted.reserve(filterBatch);
+
+            for (;;) {
+                PathBatch paths;
+                auto waitStart = Clock::now();
+                bool more = state->pathQueue.pop(paths);
+                times.starved += secondsSince(waitStart);
+                if (!more) {
+                    break;
+                }
+
+                for (auto& path : paths) {
+                    PressureMonitor::getInstance().pace();
+                    times.items++;
+
+                    Candidate candidate;
+                    candidate.path = std::move(path);
+                    try {
+                        if (!filter(candidate)) {
+                            continue;
+                        }
+                    } catch (const std::exception& e) {
+                        Logger::getInstance().warning("Error checking " + candidate.path + ": " + e.what());
+                        continue;
+                    }
+
+                    accepted.push_back(std::move(candidate));
+                    if (accepted.size() >= filterBatch) {
+                        times.blocked += state->candidateQueue.push(std::move(accepted));
+                        accepted = CandidateBatch();
+                        accepted.reserve(filterBatch);
+                    }
+                }
+            }
+            if (!accepted.empty()) {
+                times.blocked += state->candidateQueue.push(std::move(accepted));
+            }
+            times.total = secondsSince(threadStart);
+        });
+    }
+
+    std::vector<std::thread> deleteThreads;
+    for (size_t t = 0; t < options_.deleteThreads; ++t) {
+        deleteThreads.emplace_back([state, &remover, t] {
+            ThreadTimes& times = state->deleteTimes[t];
+            auto threadStart = Clock::now();
+
+            for (;;) {
+                CandidateBatch candidates;
+                auto waitStart = Clock::now();
+                bool more = state->candidateQueue.pop(candidates);
+                times.starved += secondsSince(waitStart);
+                if (!more) {
+                    break;
+                }
+
+                for (auto& candidate : candidates) {
+                    PressureMonitor::getInstance().pace();
+                    times.items++;
+                    try {
+                        remover(candidate);
+                    } catch (const std::exception& e) {
+                        Logger::getInstance().warning("Error deleting " + candidate.path + ": " + e.what());
+                    }
+                }
+            }
+            times.total = secondsSince(threadStart);
+        });
+    }
+
+    // Walker threads only ever wait on a full path queue
+    size_t enumerateBatch = options_.enumerateBatch;
+    Utils::walkFiles(rootPath, [state, enumerateBatch](std::vector<std::string>& files) {
+        state->enumerated += files.size();
+        for (size_t offset = 0; offset < files.size(); offset += enumerateBatch) {
+            size_t end = std::min(offset + enumerateBatch, files.size());
+            PathBatch batch(std::make_move_iterator(files.begin() + offset),
+                            std::make_move_iterator(files.begin() + end));
+            double waited = state->pathQueue.push(std::move(batch));
+            state->enumerateBlockedNanoseconds += static_cast<int64_t>(waited * 1e9);
+        }
+    }, options_.enumerateThreads, enumerateBatch);
+    double enumerateSeconds = secondsSince(start);
+
+    state->pathQueue.close();
+    for (auto& thread : filterThreads) {
+        thread.join();
+    }
+    state->candidateQueue.close();
+    for (auto& thread : deleteThreads) {
+        thread.join();
+    }
+    elapsedSeconds_ = secondsSince(start);
+
+    stats_.assign(3, PipelineStageStats());
+
+    PipelineStageStats& enumerate = stats_[0];
+    enumerate.name = "enumerate";
+    enumerate.threads = options_.enumerateThreads;
+    enumerate.items = state->enumerated;
+    enumerate.blockedSeconds = static_cast<double>(state->enumerateBlockedNanoseconds.load()) / 1e9;
+    // Idle walkers can't be told apart from busy ones, so this is an upper bound
+    enumerate.busySeconds = enumerateSeconds * static_cast<double>(enumerate.threads) - enumerate.blockedSeconds;
+
+    PipelineStageStats& filtering = stats_[1];
+    filtering.name = "filter";
+    filtering.threads = options_.filterThreads;
+    addThreadTimes(filtering, state->filterTimes);
+    addQueueStats(filtering, state->pathQueue);
+
+    PipelineStageStats& deletion = stats_[2];
+    deletion.name = "delete";
+    deletion.threads = options_.deleteThreads;
+    addThreadTimes(deletion, state->deleteTimes);
+    addQueueStats(deletion, state->candidateQueue);
+}
+
+std::vector<std::string> CleanPipeline::describeStats() const {
+    std::vector<std::string> lines;
+    for (const auto& stage : stats_) {
+        double threadSeconds = elapsedSeconds_ * static_cast<double>(stage.threads);
+        auto percent = [threadSeconds](double seconds) {
+            return threadSeconds > 0 ? seconds * 100.0 / threadSeconds : 0.0;
+        };
+
+        std::ostringstream line;
+        line << std::fixed << std::setprecision(0) << stage.name << ": " << stage.threads << " threads, "
+             << stage.items << " files, busy " << percent(stage.busySeconds) << "%, starved "
+             << percent(stage.starvedSeconds) << "%, blocked " << percent(stage.blockedSeconds) << "%";
+        if (stage.queueCapacity > 0) {
+            line << std::setprecision(1) << ", input queue " << stage.meanQueueDepth << " avg / "
+                 << stage.maxQueueDepth << " max of " << stage.queueCapacity;
+        }
+        lines.push_back(line.str());
+    }
+    return lines;
+}
+
+}
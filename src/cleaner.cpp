@@ -1,14 +1,44 @@
 #include "cleaner.h"
 #include "utils.h"
 #include "logger.h"
+#include "git_artifacts.h"
+#include "recycle_bin.h"
+#include "pressure_monitor.h"
+#include "sparsifier.h"
+#include "inode_relief.h"
+#include "archiver.h"
+#include "thumbnail_cleaner.h"
+#include "journal_vacuum.h"
+#include "clean_pipeline.h"
+#include "tier_mover.h"
+#include "mft_scanner.h"
+#include "thread_pool.h"
+#include "handle_list.h"
 #include <iostream>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <sstream>
 
 namespace CClean {
 
 CCleaner::CCleaner() 
     : dryRun_(false)
     , verbose_(false)
+    , recycleBinMinimumAge_(0)
+    , minimumFileSize_(SPARSIFY_MIN_FILE_SIZE)
+    , freeInodesTarget_(0)
+    , freeInodesTargetPercent_(false)
+    , archiveMinimumAge_(ARCHIVE_MIN_AGE_DAYS)
+    , archiveCompression_(false)
+    , tierMinimumAge_(TIER_MIN_IDLE_DAYS)
+    , journalMaximumAge_(JOURNAL_MAX_AGE_DAYS)
+    , journalMaximumSize_(0)
+    , perFileSize_(true)
+    , useMft_(false)
+    , handleList_(nullptr)
     , totalBytesFound_(0)
     , totalFilesFound_(0) {
 }
@@ -17,32 +47,54 @@ CCleaner::~CCleaner() = default;
 
 CleanupResult CCleaner::scanTempFiles() {
     updateProgress("Scanning temporary files...", 0);
-    return processPaths(TEMP_PATHS, false);
+    return processPaths(TEMP_PATHS, false, "Temp Files");
 }
 
 CleanupResult CCleaner::cleanTempFiles() {
     updateProgress("Cleaning temporary files...", 0);
-    return processPaths(TEMP_PATHS, true);
+    return processPaths(TEMP_PATHS, true, "Temp Files");
 }
 
 CleanupResult CCleaner::scanBrowserCache() {
     updateProgress("Scanning browser cache...", 0);
-    return processPaths(BROWSER_CACHE_PATHS, false);
+    return processPaths(BROWSER_CACHE_PATHS, false, "Browser Cache");
 }
 
 CleanupResult CCleaner::cleanBrowserCache() {
     updateProgress("Cleaning browser cache...", 0);
-    return processPaths(BROWSER_CACHE_PATHS, true);
+    return processPaths(BROWSER_CACHE_PATHS, true, "Browser Cache");
 }
 
 CleanupResult CCleaner::scanSystemFiles() {
     updateProgress("Scanning system files...", 0);
-    return processPaths(SYSTEM_CLEANUP_PATHS, false);
+    return processPaths(SYSTEM_CLEANUP_PATHS, false, "System Files");
 }
 
 CleanupResult CCleaner::cleanSystemFiles() {
     updateProgress("Cleaning system files...", 0);
-    return processPaths(SYSTEM_CLEANUP_PATHS, true);
+    return processPaths(SYSTEM_CLEANUP_PATHS, true, "System Files");
+}
+
+CleanupResult CCleaner::scanRecycleBin() {
+    updateProgress("Scanning Recycle Bin...", 0);
+    
+    CleanupResult result;
+    std::string rootPath = recycleBinRoot();
+    
+    RecycleBinCleaner recycleBin;
+    recycleBin.setMinimumAgeDays(recycleBinMinimumAge_);
+    recycleBin.setVerbose(verbose_);
+    
+    if (recycleBin.scan(rootPath)) {
+        result = recycleBin.scanResult();
+    } else {
+        // Not a $Recycle.Bin layout (e.g. a freedesktop trash); size it directly
+        result.filesScanned = 1;
+        result.bytesFreed = Utils::getDirectorySize(rootPath);
+    }
+    
+    updateProgress("Recycle Bin scan completed", 100);
+    return result;
 }
 
 CleanupResult CCleaner::cleanRecycleBin() {
@@ -50,8 +102,34 @@ CleanupResult CCleaner::cleanRecycleBin() {
     updateProgress("Cleaning Recycle Bin...", 0);
     
     try {
-        std::string recycleBinPath = Utils::getRecycleBinPath();
-        size_t sizeBeforeClean = Utils::getDirectorySize(recycleBinPath);
+        std::string rootPath = recycleBinRoot();
+        
+        RecycleBinCleaner recycleBin;
+        recycleBin.setMinimumAgeDays(recycleBinMinimumAge_);
+        recycleBin.setDryRun(dryRun_);
+        recycleBin.setVerbose(verbose_);
+        bool parsed = recycleBin.scan(rootPath);
+        
+        // Partial emptying, or a bin other than the shell's, goes through the
+        // $I records; only a full empty of the system bin uses the shell API
+        if (recycleBinMinimumAge_ > 0 || !recycleBinRoot_.empty()) {
+            if (!parsed) {
+                result.success = false;
+                result.errorMessage = "No $Recycle.Bin user folders found in " + rootPath;
+                Logger::getInstance().error(result.errorMessage);
+                return result;
+            }
+            
+            result = recycleBin.purge();
+            recordCleanedFilesystems({ rootPath }, result);
+            Logger::getInstance().info(std::string(dryRun_ ? "DRY RUN: Would remove " : "Removed ") +
+                                     std::to_string(result.filesDeleted) + " Recycle Bin items (" +
+                                     Utils::formatBytes(result.bytesFreed) + ")");
+            updateProgress("Recycle Bin cleanup completed", 100);
+            return result;
+        }
+        
+        size_t sizeBeforeClean = parsed ? recycleBin.scanResult().bytesFreed : Utils::getDirectorySize(rootPath);
         
         if (dryRun_) {
             result.bytesFreed = sizeBeforeClean;
@@ -64,6 +142,7 @@ CleanupResult CCleaner::cleanRecycleBin() {
                 result.bytesFreed = sizeBeforeClean;
                 result.filesDeleted = 1;
                 result.success = true;
+                recordCleanedFilesystems({ rootPath }, result);
                 Logger::getInstance().info("Recycle Bin emptied successfully");
             } else {
                 result.success = false;
@@ -82,6 +161,220 @@ CleanupResult CCleaner::cleanRecycleBin() {
     return result;
 }
 
+CleanupResult CCleaner::scanGitArtifacts(const std::string& rootPath) {
+    updateProgress("Scanning git-ignored build artifacts...", 0);
+    
+    GitArtifactCleaner gitCleaner;
+    gitCleaner.setKeepList(&keepList_);
+    gitCleaner.setVerbose(verbose_);
+    CleanupResult result = gitCleaner.process(Utils::expandEnvironmentVariables(rootPath), false);
+    
+    updateProgress("Git artifact scan completed", 100);
+    return result;
+}
+
+CleanupResult CCleaner::cleanGitArtifacts(const std::string& rootPath) {
+    updateProgress("Cleaning git-ignored build artifacts...", 0);
+    
+    GitArtifactCleaner gitCleaner;
+    gitCleaner.setKeepList(&keepList_);
+    gitCleaner.setDryRun(dryRun_);
+    gitCleaner.setVerbose(verbose_);
+    std::string expandedRoot = Utils::expandEnvironmentVariables(rootPath);
+    CleanupResult result = gitCleaner.process(expandedRoot, true);
+    recordCleanedFilesystems({ expandedRoot }, result);
+    
+    updateProgress("Git artifact cleanup completed", 100);
+    return result;
+}
+
+CleanupResult CCleaner::scanSparsify(const std::vector<std::string>& rootPaths) {
+    updateProgress("Scanning large files for zero-filled regions...", 0);
+    
+    Sparsifier sparsifier;
+    sparsifier.setMinimumFileSize(minimumFileSize_);
+    sparsifier.setThrottle(&ioThrottle_);
+    sparsifier.setVerbose(verbose_);
+    
+    std::vector<std::string> expandedPaths;
+    for (const auto& path : rootPaths) {
+        expandedPaths.push_back(Utils::expandEnvironmentVariables(path));
+    }
+    CleanupResult result = sparsifier.process(expandedPaths, false);
+    
+    updateProgress("Sparsify scan completed", 100);
+    return result;
+}
+
+CleanupResult CCleaner::cleanSparsify(const std::vector<std::string>& rootPaths) {
+    updateProgress("Punching holes in zero-filled regions...", 0);
+    
+    Sparsifier sparsifier;
+    sparsifier.setMinimumFileSize(minimumFileSize_);
+    sparsifier.setThrottle(&ioThrottle_);
+    sparsifier.setDryRun(dryRun_);
+    sparsifier.setVerbose(verbose_);
+    
+    std::vector<std::string> expandedPaths;
+    for (const auto& path : rootPaths) {
+        expandedPaths.push_back(Utils::expandEnvironmentVariables(path));
+    }
+    CleanupResult result = sparsifier.process(expandedPaths, true);
+    recordCleanedFilesystems(expandedPaths, result);
+    
+    updateProgress("Sparsify completed", 100);
+    return result;
+}
+
+CleanupResult CCleaner::scanArchive(const std::vector<std::string>& rootPaths) {
+    updateProgress("Scanning for small old files to archive...", 0);
+    
+    Archiver archiver;
+    archiver.setMinimumAgeDays(archiveMinimumAge_);
+    archiver.setCompression(archiveCompression_);
+    archiver.setKeepList(&keepList_);
+    archiver.setVerbose(verbose_);
+    
+    std::vector<std::string> expandedPaths;
+    for (const auto& path : rootPaths) {
+        expandedPaths.push_back(Utils::expandEnvironmentVariables(path));
+    }
+    CleanupResult result = archiver.process(expandedPaths, false);
+    
+    updateProgress("Archive scan completed", 100);
+    return result;
+}
+
+CleanupResult CCleaner::cleanArchive(const std::vector<std::string>& rootPaths) {
+    updateProgress("Packing small old files into archives...", 0);
+    
+    Archiver archiver;
+    archiver.setMinimumAgeDays(archiveMinimumAge_);
+    archiver.setCompression(archiveCompression_);
+    archiver.setKeepList(&keepList_);
+    archiver.setThrottle(&ioThrottle_);
+    archiver.setDryRun(dryRun_);
+    archiver.setVerbose(verbose_);
+    
+    std::vector<std::string> expandedPaths;
+    for (const auto& path : rootPaths) {
+        expandedPaths.push_back(Utils::expandEnvironmentVariables(path));
+    }
+    CleanupResult result = archiver.process(expandedPaths, true);
+    recordCleanedFilesystems(expandedPaths, result);
+    
+    updateProgress("Archive completed", 100);
+    return result;
+}
+
+CleanupResult CCleaner::scanThumbnails() {
+    updateProgress("Scanning thumbnails of deleted files...", 0);
+    
+    ThumbnailCleaner thumbnailCleaner;
+    thumbnailCleaner.setFileFilter([this](const std::string& file) { return shouldDeleteFile(file); });
+    thumbnailCleaner.setVerbose(verbose_);
+    CleanupResult result = thumbnailCleaner.process(ThumbnailCleaner::defaultRoots(), false);
+    
+    updateProgress("Thumbnail scan completed", 100);
+    return result;
+}
+
+CleanupResult CCleaner::cleanThumbnails() {
+    updateProgress("Removing thumbnails of deleted files...", 0);
+    
+    ThumbnailCleaner thumbnailCleaner;
+    thumbnailCleaner.setFileFilter([this](const std::string& file) { return shouldDeleteFile(file); });
+    thumbnailCleaner.setDryRun(dryRun_);
+    thumbnailCleaner.setVerbose(verbose_);
+    std::vector<std::string> roots = ThumbnailCleaner::defaultRoots();
+    CleanupResult result = thumbnailCleaner.process(roots, true);
+    recordCleanedFilesystems(roots, result);
+    
+    updateProgress("Thumbnail cleanup completed", 100);
+    return result;
+}
+
+CleanupResult CCleaner::scanJournal() {
+    updateProgress("Scanning archived journal files...", 0);
+    
+    JournalVacuum vacuum;
+    vacuum.setMaximumAgeDays(journalMaximumAge_);
+    vacuum.setMaximumSize(journalMaximumSize_);
+    vacuum.setFileFilter([this](const std::string& file) { return shouldDeleteFile(file); });
+    vacuum.setVerbose(verbose_);
+    CleanupResult result = vacuum.process(JournalVacuum::defaultRoots(), false);
+    
+    updateProgress("Journal scan completed", 100);
+    return result;
+}
+
+CleanupResult CCleaner::cleanJournal() {
+    updateProgress("Vacuuming archived journal files...", 0);
+    
+    JournalVacuum vacuum;
+    vacuum.setMaximumAgeDays(journalMaximumAge_);
+    vacuum.setMaximumSize(journalMaximumSize_);
+    vacuum.setFileFilter([this](const std::string& file) { return shouldDeleteFile(file); });
+    vacuum.setDryRun(dryRun_);
+    vacuum.setVerbose(verbose_);
+    std::vector<std::string> roots = JournalVacuum::defaultRoots();
+    CleanupResult result = vacuum.process(roots, true);
+    recordCleanedFilesystems(roots, result);
+    
+    updateProgress("Journal vacuum completed", 100);
+    return result;
+}
+
+const std::vector<CleanupType>& CCleaner::fullCategories() {
+    static const std::vector<CleanupType> categories = {
+        CleanupType::TEMP_FILES,
+        CleanupType::BROWSER_CACHE,
+        CleanupType::SYSTEM_FILES,
+        CleanupType::RECYCLE_BIN
+    };
+    return categories;
+}
+
+CleanupResult CCleaner::scanCategory(CleanupType type) {
+    switch (type) {
+        case CleanupType::TEMP_FILES:
+            return scanTempFiles();
+        case CleanupType::BROWSER_CACHE:
+            return scanBrowserCache();
+        case CleanupType::SYSTEM_FILES:
+            return scanSystemFiles();
+        case CleanupType::RECYCLE_BIN:
+            return scanRecycleBin();
+        default:
+            break;
+    }
+    
+    CleanupResult result;
+    result.success = false;
+    result.errorMessage = Logger::cleanupTypeName(type) + " needs its own options to scan";
+    return result;
+}
+
+CleanupResult CCleaner::cleanCategory(CleanupType type) {
+    switch (type) {
+        case CleanupType::TEMP_FILES:
+            return cleanTempFiles();
+        case CleanupType::BROWSER_CACHE:
+            return cleanBrowserCache();
+        case CleanupType::SYSTEM_FILES:
+            return cleanSystemFiles();
+        case CleanupType::RECYCLE_BIN:
+            return cleanRecycleBin();
+        default:
+            break;
+    }
+    
+    CleanupResult result;
+    result.success = false;
+    result.errorMessage = Logger::cleanupTypeName(type) + " needs its own options to clean";
+    return result;
+}
+
 CleanupResult CCleaner::performFullScan() {
     updateProgress("Performing full system scan...", 0);
     
@@ -105,10 +398,9 @@ CleanupResult CCleaner::performFullScan() {
     
     updateProgress("Full scan: system files completed", 75);
     
-    std::string recycleBinPath = Utils::getRecycleBinPath();
-    size_t recycleBinSize = Utils::getDirectorySize(recycleBinPath);
-    totalResult.filesScanned += 1;
-    totalResult.bytesFreed += recycleBinSize;
+    auto recycleBinResult = scanRecycleBin();
+    totalResult.filesScanned += recycleBinResult.filesScanned;
+    totalResult.bytesFreed += recycleBinResult.bytesFreed;
     
     updateProgress("Full scan completed", 100);
     
@@ -172,9 +464,111 @@ void CCleaner::setVerbose(bool enabled) {
     verbose_ = enabled;
 }
 
-CleanupResult CCleaner::processPaths(const std::vector<std::string>& paths, bool cleanMode) {
+void CCleaner::setRecycleBinRoot(const std::string& rootPath) {
+    recycleBinRoot_ = rootPath;
+}
+
+void CCleaner::setRecycleBinMinimumAge(int days) {
+    recycleBinMinimumAge_ = days;
+}
+
+void CCleaner::setMinimumFileSize(size_t bytes) {
+    minimumFileSize_ = bytes;
+}
+
+void CCleaner::setIoRateLimit(size_t bytesPerSecond) {
+    ioThrottle_.setRate(bytesPerSecond);
+}
+
+void CCleaner::setFreeInodesTarget(size_t target, bool percent) {
+    freeInodesTarget_ = target;
+    freeInodesTargetPercent_ = percent;
+}
+
+void CCleaner::setArchiveMinimumAge(int days) {
+    archiveMinimumAge_ = days;
+}
+
+void CCleaner::setArchiveCompression(bool enabled) {
+    archiveCompression_ = enabled;
+}
+
+bool CCleaner::setKeepList(const std::string& listPath, std::string& error) {
+    return keepList_.load(Utils::expandEnvironmentVariables(listPath), error);
+}
+
+void CCleaner::setTierDestination(const std::string& destination) {
+    tierDestination_ = destination.empty() ? destination : Utils::expandEnvironmentVariables(destination);
+}
+
+void CCleaner::setTierMinimumAge(int days) {
+    tierMinimumAge_ = days;
+}
+
+void CCleaner::setJournalMaximumAge(int days) {
+    journalMaximumAge_ = days;
+}
+
+void CCleaner::setJournalMaximumSize(size_t bytes) {
+    journalMaximumSize_ = bytes;
+}
+
+void CCleaner::setPerFileSize(bool enabled) {
+    perFileSize_ = enabled;
+}
+
+void CCleaner::setUseMft(bool enabled) {
+    useMft_ = enabled;
+}
+
+void CCleaner::setPipelineOptions(const PipelineOptions& options) {
+    pipelineOptions_ = options;
+}
+
+bool CCleaner::setFailureCache(const std::string& cachePath, std::string& error) {
+    return failureCache_.load(Utils::expandEnvironmentVariables(cachePath), error);
+}
+
+bool CCleaner::saveFailureCache(std::string& error) {
+    return failureCache_.save(error);
+}
+
+CleanupResult CCleaner::processPaths(const std::vector<std::string>& paths, bool cleanMode, const std::string& category) {
+    if (!tierDestination_.empty()) {
+        return processPathsForTier(paths, cleanMode, category);
+    }
+    
+    if (freeInodesTarget_ > 0) {
+        // Never fall back to deleting everything when asked to stop early
+        if (!InodeReliefCleaner::isSupported()) {
+            CleanupResult result;
+            result.success = false;
+            result.errorMessage = category + ": an inode target is not supported on this platform";
+            Logger::getInstance().error(result.errorMessage);
+            return result;
+        }
+        return processPathsForInodes(paths, cleanMode);
+    }
+    
     CleanupResult totalResult;
     
+    // Without per-file sizes, bytes freed is the growth in free space of
+    // every filesystem the paths live on
+    bool measureFreeSpace = cleanMode && !dryRun_ && !perFileSize_;
+    std::map<uint64_t, std::pair<std::string, uint64_t>> freeSpaceBefore;
+    if (measureFreeSpace) {
+        for (const auto& path : paths) {
+            std::string expandedPath = Utils::expandEnvironmentVariables(path);
+            uint64_t filesystemId = 0;
+            uint64_t freeBytes = 0;
+            if (Utils::pathExists(expandedPath) && Utils::getFilesystemSpace(expandedPath, filesystemId, freeBytes)) {
+                freeSpaceBefore.emplace(filesystemId, std::make_pair(expandedPath, freeBytes));
+            }
+        }
+    }
+    
+    AgeSketch ages;
+    
     for (size_t i = 0; i < paths.size(); ++i) {
         const std::string& path = paths[i];
         
@@ -182,7 +576,11 @@ CleanupResult CCleaner::processPaths(const std::vector<std::string>& paths, bool
         if (cleanMode) {
             pathResult = cleanPath(path);
         } else {
-            pathResult = scanPath(path);
+            pathResult = scanPath(path, ages);
+        }
+        
+        if (cleanMode) {
+            recordCleanedFilesystems({ Utils::expandEnvironmentVariables(path) }, pathResult);
         }
         
         totalResult.filesScanned += pathResult.filesScanned;
@@ -202,12 +600,109 @@ CleanupResult CCleaner::processPaths(const std::vector<std::string>& paths, bool
         updateProgress(cleanMode ? "Cleaning..." : "Scanning...", progress);
     }
     
+    if (measureFreeSpace) {
+        for (const auto& filesystem : freeSpaceBefore) {
+            uint64_t filesystemId = 0;
+            uint64_t freeBytes = 0;
+            // Blocks of deleted files only count as free once committed
+            Utils::syncFilesystem(filesystem.second.first);
+            if (Utils::getFilesystemSpace(filesystem.second.first, filesystemId, freeBytes) &&
+                freeBytes > filesystem.second.second) {
+                totalResult.bytesFreed += freeBytes - filesystem.second.second;
+            }
+        }
+        
+        // Other processes writing meanwhile make this an underestimate, ones
+        // deleting an overestimate; files still held open free nothing yet
+        Logger::getInstance().info(category + ": bytes freed measured from free space on " +
+                                   std::to_string(freeSpaceBefore.size()) + " filesystem(s)");
+    }
+    
+    if (!cleanMode && !ages.empty()) {
+        std::ostringstream ss;
+        ss << std::fixed;
+        ss.precision(0);
+        ss << category << ": by bytes, files are " << ages.quantile(0.5) << " days old at the median, "
+           << ages.quantile(0.9) << " days at the 90th percentile";
+        Logger::getInstance().info(ss.str());
+        
+        std::lock_guard<std::mutex> lock(ageSketchMutex_);
+        ageSketches_[category] = std::move(ages);
+    }
+    
     return totalResult;
 }
 
-CleanupResult CCleaner::scanPath(const std::string& path) {
+CleanupResult CCleaner::processPathsForInodes(const std::vector<std::string>& paths, bool cleanMode) {
+    std::vector<std::string> expandedPaths;
+    for (const auto& path : paths) {
+        if (Utils::pathExists(path)) {
+            expandedPaths.push_back(Utils::expandEnvironmentVariables(path));
+        }
+    }
+    
+    InodeReliefCleaner inodeCleaner;
+    inodeCleaner.setTarget(freeInodesTarget_, freeInodesTargetPercent_);
+    inodeCleaner.setFileFilter([this](const std::string& file) { return shouldDeleteFile(file); });
+    inodeCleaner.setDryRun(dryRun_);
+    inodeCleaner.setVerbose(verbose_);
+    
+    CleanupResult result = inodeCleaner.process(expandedPaths, cleanMode);
+    if (cleanMode) {
+        recordCleanedFilesystems(expandedPaths, result);
+    }
+    updateProgress(cleanMode ? "Cleaning..." : "Scanning...", 100);
+    return result;
+}
+
+CleanupResult CCleaner::processPathsForTier(const std::vector<std::string>& paths, bool cleanMode, const std::string& category) {
+    std::vector<std::string> expandedPaths;
+    for (const auto& path : paths) {
+        if (Utils::pathExists(path)) {
+            expandedPaths.push_back(Utils::expandEnvironmentVariables(path));
+        }
+    }
+    
+    TierMover mover;
+    mover.setDestination(tierDestination_);
+    mover.setMinimumIdleDays(tierMinimumAge_);
+    mover.setFileFilter([this](const std::string& file) { return shouldDeleteFile(file); });
+    mover.setThrottle(&ioThrottle_);
+    mover.setDryRun(dryRun_);
+    mover.setVerbose(verbose_);
+    
+    CleanupResult result = mover.process(expandedPaths, cleanMode);
+    if (cleanMode) {
+        recordCleanedFilesystems(expandedPaths, result);
+    }
+    
+    std::ostringstream ss;
+    ss.precision(1);
+    if (cleanMode && !dryRun_) {
+        ss << std::fixed << category << ": moved " << result.filesDeleted << " files ("
+           << Utils::formatBytes(result.bytesFreed) << ", " << Utils::formatBytes(mover.bytesCopied())
+           << " copied) to " << tierDestination_ << " at " << mover.throughputMBps() << " MB/s";
+    } else {
+        ss << category << ": " << result.filesScanned << " files (" << Utils::formatBytes(result.bytesFreed)
+           << ") unused for " << tierMinimumAge_ << " days would move to " << tierDestination_;
+    }
+    Logger::getInstance().info(ss.str());
+    
+    updateProgress(cleanMode ? "Moving cold files..." : "Scanning...", 100);
+    return result;
+}
+
+CleanupResult CCleaner::scanPath(const std::string& path, AgeSketch& ages) {
     CleanupResult result;
     
+    // Before the existence check: the MFT also resolves wildcard roots
+    if (useMft_ && scanPathFromMft(Utils::expandEnvironmentVariables(path), result)) {
+        if (verbose_) {
+            Logger::getInstance().debug("Sized from the MFT: " + path + " (" + Utils::formatBytes(result.bytesFreed) + ")");
+        }
+        return result;
+    }
+    
     if (!Utils::pathExists(path)) {
         if (verbose_) {
             Logger::getInstance().debug("Path does not exist: " + path);
@@ -219,16 +714,93 @@ CleanupResult CCleaner::scanPath(const std::string& path) {
         std::string expandedPath = Utils::expandEnvironmentVariables(path);
         auto files = Utils::findFiles(expandedPath);
         
-        for (const auto& file : files) {
-            if (shouldDeleteFile(file)) {
-                size_t fileSize = Utils::getFileSize(file);
-                result.filesScanned++;
-                result.bytesFreed += fileSize;
+        int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        
+        // Each thread sizes a slice of the files into its own counters and
+        // age sketch; they are merged once all are done
+        struct Slice {
+            size_t files = 0;
+            size_t bytes = 0;
+            size_t knownFailures = 0;
+            size_t unrecorded = 0;
+            std::string unrecordedError;
+            AgeSketch ages;
+        };
+        
+        size_t sliceCount = std::min(ThreadPool::defaultThreadCount(), files.size() / SCAN_MIN_FILES_PER_THREAD);
+        std::vector<Slice> slices(std::max<size_t>(sliceCount, 1));
+        
+        auto scanSlice = [&](size_t index) {
+            Slice& slice = slices[index];
+            for (size_t i = index; i < files.size(); i += slices.size()) {
+                const std::string& file = files[i];
+                PressureMonitor::getInstance().pace();
                 
-                if (verbose_) {
-                    Logger::getInstance().debug("Found: " + file + " (" + Utils::formatBytes(fileSize) + ")");
+                Utils::FileIdentity identity;
+                bool haveIdentity = Utils::getFileIdentity(file, identity);
+                if (haveIdentity && failureCache_.isLoaded() && failureCache_.shouldSkip(identity)) {
+                    slice.knownFailures++;
+                    continue;
                 }
+                
+                if (shouldDeleteFile(file)) {
+                    size_t fileSize = haveIdentity ? identity.size : Utils::getFileSize(file);
+                    slice.files++;
+                    slice.bytes += fileSize;
+                    if (haveIdentity) {
+                        slice.ages.add(static_cast<double>(now - identity.modified) / 86400e9,
+                                       static_cast<double>(fileSize));
+                    }
+                    if (handleList_) {
+                        std::string error;
+                        if (!haveIdentity || !handleList_->add(file, identity, error)) {
+                            slice.unrecorded++;
+                            if (slice.unrecordedError.empty()) {
+                                slice.unrecordedError = haveIdentity ? error : "Cannot stat " + file;
+                            }
+                        }
+                    }
+                    
+                    if (verbose_) {
+                        Logger::getInstance().debug("Found: " + file + " (" + Utils::formatBytes(fileSize) + ")");
+                    }
+                }
+            }
+        };
+        
+        if (slices.size() == 1) {
+            scanSlice(0);
+        } else {
+            ThreadPool pool(slices.size());
+            for (size_t index = 0; index < slices.size(); ++index) {
+                pool.submit([&scanSlice, index] { scanSlice(index); });
             }
+            pool.wait();
+        }
+        
+        size_t knownFailures = 0;
+        size_t unrecorded = 0;
+        std::string unrecordedError;
+        for (const auto& slice : slices) {
+            result.filesScanned += slice.files;
+            result.bytesFreed += slice.bytes;
+            knownFailures += slice.knownFailures;
+            ages.merge(slice.ages);
+            unrecorded += slice.unrecorded;
+            if (unrecordedError.empty()) {
+                unrecordedError = slice.unrecordedError;
+            }
+        }
+        
+        if (unrecorded > 0) {
+            Logger::getInstance().warning("Could not record " + std::to_string(unrecorded) + " files in " +
+                                          expandedPath + " by handle (" + unrecordedError + ")");
+        }
+        
+        if (knownFailures > 0) {
+            Logger::getInstance().info("Not counting " + std::to_string(knownFailures) +
+                                       " files in " + expandedPath + " that failed to delete recently");
         }
         
         result.success = true;
@@ -241,6 +813,56 @@ CleanupResult CCleaner::scanPath(const std::string& path) {
     return result;
 }
 
+// Volumes whose MFT cannot be read (not NTFS, no administrator rights) are
+// remembered as null and walked instead, without retrying
+bool CCleaner::scanPathFromMft(const std::string& expandedPath, CleanupResult& result) {
+#ifdef _WIN32
+    if (expandedPath.size() < 2 || expandedPath[1] != ':') {
+        return false;
+    }
+    
+    std::string volume = expandedPath.substr(0, 2);
+    std::lock_guard<std::mutex> lock(mftMutex_);
+    auto it = mftVolumes_.find(volume);
+    if (it == mftVolumes_.end()) {
+        auto scanner = std::make_unique<MftScanner>();
+        std::string error;
+        auto start = std::chrono::steady_clock::now();
+        
+        if (scanner->open(volume, error) && scanner->scan(error)) {
+            std::ostringstream ss;
+            ss.precision(2);
+            ss << std::fixed << "Read " << scanner->recordCount() << " MFT records of " << volume << " in "
+               << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << "s"
+               << "; folder sizes from it include files cleaning skips (in use, protected names, keep list,"
+               << " failure cache)";
+            Logger::getInstance().info(ss.str());
+        } else {
+            Logger::getInstance().warning("Cannot read the MFT of " + volume + " (" + error + "); walking directories");
+            scanner.reset();
+        }
+        it = mftVolumes_.emplace(volume, std::move(scanner)).first;
+    }
+    
+    if (!it->second) {
+        return false;
+    }
+    
+    // A root that does not exist simply has nothing to clean
+    MftTotals totals;
+    if (it->second->totalsFor(expandedPath, totals)) {
+        result.filesScanned = totals.files;
+        result.bytesFreed = totals.bytes;
+    }
+    result.success = true;
+    return true;
+#else
+    (void)expandedPath;
+    (void)result;
+    return false;
+#endif
+}
+
 CleanupResult CCleaner::cleanPath(const std::string& path) {
     CleanupResult result;
     
@@ -253,37 +875,100 @@ CleanupResult CCleaner::cleanPath(const std::string& path) {
     
     try {
         std::string expandedPath = Utils::expandEnvironmentVariables(path);
-        auto files = Utils::findFiles(expandedPath);
         
-        for (const auto& file : files) {
-            if (shouldDeleteFile(file)) {
-                size_t fileSize = Utils::getFileSize(file);
+        std::atomic<size_t> knownFailures(0);
+        bool sizeFree = !dryRun_ && !perFileSize_;
+        std::mutex resultMutex;
+        
+        // Runs on the filter stage's threads
+        auto filter = [&](CleanPipeline::Candidate& candidate) {
+            // The stat doubles as the size lookup, so known failures cost nothing extra.
+            // Size-free mode skips it; the failure cache then goes unused.
+            const std::string& file = candidate.path;
+            candidate.haveIdentity = !sizeFree && failureCache_.isLoaded() &&
+                                     Utils::getFileIdentity(file, candidate.identity);
+            if (candidate.haveIdentity && failureCache_.shouldSkip(candidate.identity)) {
+                knownFailures++;
+                if (verbose_) {
+                    Logger::getInstance().debug("Skipping recently failed " + file);
+                }
+                return false;
+            }
+            
+            if (!shouldDeleteFile(file)) {
+                return false;
+            }
+            if (candidate.haveIdentity) {
+                candidate.size = candidate.identity.size;
+            } else if (!sizeFree) {
+                candidate.size = Utils::getFileSize(file);
+            }
+            return true;
+        };
+        
+        // Runs on the delete stage's threads
+        auto remover = [&](CleanPipeline::Candidate& candidate) {
+            const std::string& file = candidate.path;
+            size_t fileSize = candidate.size;
+            
+            if (dryRun_) {
+                if (verbose_) {
+                    Logger::getInstance().debug("DRY RUN: Would delete " + file + " (" + Utils::formatBytes(fileSize) + ")");
+                }
+                std::lock_guard<std::mutex> lock(resultMutex);
                 result.filesScanned++;
+                result.bytesFreed += fileSize;
+                result.filesDeleted++;
+                return;
+            }
+            
+            if (Utils::deleteFileSecure(file)) {
+                if (candidate.haveIdentity) {
+                    failureCache_.recordSuccess(candidate.identity);
+                }
+                if (verbose_) {
+                    Logger::getInstance().debug("Deleted: " + file +
+                        (sizeFree ? std::string() : " (" + Utils::formatBytes(fileSize) + ")"));
+                }
                 
-                if (dryRun_) {
-                    if (verbose_) {
-                        Logger::getInstance().debug("DRY RUN: Would delete " + file + " (" + Utils::formatBytes(fileSize) + ")");
-                    }
-                    result.bytesFreed += fileSize;
-                    result.filesDeleted++;
-                } else {
-                    if (Utils::deleteFileSecure(file)) {
-                        result.filesDeleted++;
-                        result.bytesFreed += fileSize;
-                        
-                        if (verbose_) {
-                            Logger::getInstance().debug("Deleted: " + file + " (" + Utils::formatBytes(fileSize) + ")");
-                        }
-                    } else {
-                        std::string error = "Failed to delete " + file + ": " + Utils::getLastError();
-                        Logger::getInstance().warning(error);
-                        
-                        if (result.errorMessage.empty()) {
-                            result.errorMessage = error;
-                        }
-                    }
+                std::lock_guard<std::mutex> lock(resultMutex);
+                result.filesScanned++;
+                result.filesDeleted++;
+                result.bytesFreed += fileSize;
+            } else {
+                int errorCode = Utils::getLastErrorCode();
+                std::string error = "Failed to delete " + file + ": " + Utils::getLastError();
+                Logger::getInstance().warning(error);
+                if (candidate.haveIdentity) {
+                    failureCache_.recordFailure(candidate.identity, errorCode);
+                }
+                
+                std::lock_guard<std::mutex> lock(resultMutex);
+                result.filesScanned++;
+                if (result.errorMessage.empty()) {
+                    result.errorMessage = error;
                 }
             }
+        };
+        
+        CleanPipeline pipeline(pipelineOptions_);
+        pipeline.run(expandedPath, filter, remover);
+        
+        if (pipeline.stats().front().items > 0) {
+            Logger& logger = Logger::getInstance();
+            std::ostringstream elapsed;
+            elapsed.precision(2);
+            elapsed << std::fixed << pipeline.elapsedSeconds();
+            logger.info("Cleaning pipeline for " + expandedPath + " took " + elapsed.str() + "s:");
+            for (const auto& line : pipeline.describeStats()) {
+                logger.info("  " + line);
+            }
+        }
+        
+        if (knownFailures > 0) {
+            Logger::getInstance().info("Skipped " + std::to_string(knownFailures) + " files in " + expandedPath +
+                                       " that failed to delete recently; they are retried once they change"
+                                       " or their backoff expires");
         }
         
         result.success = true;
@@ -296,6 +981,13 @@ CleanupResult CCleaner::cleanPath(const std::string& path) {
     return result;
 }
 
+std::string CCleaner::recycleBinRoot() const {
+    if (recycleBinRoot_.empty()) {
+        return Utils::getRecycleBinPath();
+    }
+    return Utils::expandEnvironmentVariables(recycleBinRoot_);
+}
+
 void CCleaner::updateProgress(const std::string& message, int percentage) {
     if (progressCallback_) {
         progressCallback_(message, percentage);
@@ -306,14 +998,108 @@ void CCleaner::updateProgress(const std::string& message, int percentage) {
     }
 }
 
+void CCleaner::setHandleList(HandleList* list) {
+    handleList_ = list;
+}
+
+CleanupResult CCleaner::applyHandleList(HandleList& list) {
+    updateProgress("Deleting saved candidates...", 0);
+    
+    list.setFileFilter([this](const std::string& file) { return shouldDeleteFile(file); });
+    list.setFailureCache(failureCache_.isLoaded() ? &failureCache_ : nullptr);
+    list.setDryRun(dryRun_);
+    list.setVerbose(verbose_);
+    
+    CleanupResult result = list.apply();
+    recordCleanedFilesystems(list.mountPaths(), result);
+    updateProgress("Saved candidates deleted", 100);
+    return result;
+}
+
+std::vector<LargeFile> CCleaner::findLargeFiles(const std::vector<std::string>& rootPaths, size_t minimumSize,
+                                                const std::function<void(const LargeFile&)>& found) {
+    updateProgress("Looking for large files...", 0);
+    
+    LargeFileFinder finder;
+    finder.setMinimumSize(minimumSize);
+    finder.setFileFilter([this](const std::string& file) { return shouldDeleteFile(file); });
+    finder.setVerbose(verbose_);
+    
+    std::string error;
+    finder.loadSummary(LargeFileFinder::defaultSummaryPath(), error);
+    if (!error.empty()) {
+        Logger::getInstance().warning(error);
+    }
+    
+    auto files = finder.find(rootPaths, found);
+    
+    Logger::getInstance().info("Large files: " + std::to_string(files.size()) + " of at least " +
+                               Utils::formatBytes(minimumSize) + "; listed " +
+                               std::to_string(finder.directoriesListed()) + " directories, reused " +
+                               std::to_string(finder.directoriesReused()) + " and skipped " +
+                               std::to_string(finder.subtreesSkipped()) + " subtrees from the summary");
+    
+    error.clear();
+    if (!finder.saveSummary(error)) {
+        Logger::getInstance().warning(error);
+    }
+    
+    updateProgress("Large file search completed", 100);
+    return files;
+}
+
+bool CCleaner::ageSketch(const std::string& category, AgeSketch& sketch) {
+    std::lock_guard<std::mutex> lock(ageSketchMutex_);
+    auto it = ageSketches_.find(category);
+    if (it == ageSketches_.end()) {
+        return false;
+    }
+    sketch = it->second;
+    return true;
+}
+
+std::vector<std::string> CCleaner::cleanedFilesystems() {
+    std::lock_guard<std::mutex> lock(cleanedMutex_);
+    std::vector<std::string> paths;
+    for (const auto& filesystem : cleanedFilesystems_) {
+        paths.push_back(filesystem.second);
+    }
+    return paths;
+}
+
+void CCleaner::recordCleanedFilesystems(const std::vector<std::string>& paths, const CleanupResult& result) {
+    if (dryRun_ || (result.filesDeleted == 0 && result.bytesFreed == 0)) {
+        return;
+    }
+    
+    for (const auto& path : paths) {
+        uint64_t filesystemId = 0;
+        uint64_t freeBytes = 0;
+        if (Utils::pathExists(path) && Utils::getFilesystemSpace(path, filesystemId, freeBytes)) {
+            std::lock_guard<std::mutex> lock(cleanedMutex_);
+            cleanedFilesystems_.emplace(filesystemId, path);
+        }
+    }
+}
+
+bool CCleaner::isProtectedFileName(const std::string& filePath) {
+    std::string fileName = filePath.substr(filePath.find_last_of("\\/") + 1);
+    return fileName == "desktop.ini" || fileName == "thumbs.db";
+}
+
 bool CCleaner::shouldDeleteFile(const std::string& filePath) {
     if (Utils::isFileInUse(filePath)) {
         return false;
     }
     
-    std::string fileName = filePath.substr(filePath.find_last_of("\\/") + 1);
+    if (isProtectedFileName(filePath)) {
+        return false;
+    }
     
-    if (fileName == "desktop.ini" || fileName == "thumbs.db") {
+    if (keepList_.contains(filePath)) {
+        if (verbose_) {
+            Logger::getInstance().debug("Keeping listed file: " + filePath);
+        }
         return false;
     }
     
@@ -0,0 +1,192 @@
+#include "failure_cache.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace CClean {
+
+namespace {
+
+const char FAILURE_CACHE_MAGIC[8] = { 'C', 'C', 'F', 'A', 'I', 'L', '0', '1' };
+
+int64_t secondsNow() {
+    return std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+}
+
+size_t FailureCache::KeyHash::operator()(const Key& key) const {
+    return std::hash<uint64_t>()(key.first * 0x9E3779B97F4A7C15ULL ^ key.second);
+}
+
+FailureCache::FailureCache()
+    : loaded_(false)
+    , dirty_(false) {
+}
+
+std::string FailureCache::defaultPath() {
+    return (fs::path(Utils::getCacheDirectory()) / FAILURE_CACHE_FILE).string();
+}
+
+bool FailureCache::load(const std::string& cachePath, std::string& error) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    path_ = cachePath;
+    entries_.clear();
+    dirty_ = false;
+    loaded_ = true;
+
+    std::ifstream in(cachePath, std::ios::binary);
+    if (!in) {
+        return true;
+    }
+
+    FileHeader header;
+    std::error_code ec;
+    uintmax_t fileSize = fs::file_size(cachePath, ec);
+    if (ec || !in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, FAILURE_CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.entryCount > (fileSize - sizeof(header)) / sizeof(Entry)) {
+        // Written by another version or truncated; start over rather than fail the run
+        error = "Ignoring unreadable failure cache " + cachePath;
+        dirty_ = true;
+        return true;
+    }
+
+    std::vector<Entry> entries(static_cast<size_t>(header.entryCount));
+    if (!in.read(reinterpret_cast<char*>(entries.data()), entries.size() * sizeof(Entry))) {
+        error = "Ignoring unreadable failure cache " + cachePath;
+        dirty_ = true;
+        return true;
+    }
+
+    entries_.reserve(entries.size());
+    for (const auto& entry : entries) {
+        entries_[Key(entry.device, entry.inode)] = entry;
+    }
+    return true;
+}
+
+bool FailureCache::save(std::string& error) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!loaded_ || !dirty_) {
+        return true;
+    }
+
+    prune(secondsNow());
+
+    std::error_code ec;
+    fs::path target(path_);
+    if (target.has_parent_path()) {
+        fs::create_directories(target.parent_path(), ec);
+    }
+
+    std::string partialPath = path_ + ".partial";
+    {
+        std::ofstream out(partialPath, std::ios::binary | std::ios::trunc);
+        FileHeader header;
+        std::memcpy(header.magic, FAILURE_CACHE_MAGIC, sizeof(header.magic));
+        header.entryCount = entries_.size();
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (const auto& entry : entries_) {
+            out.write(reinterpret_cast<const char*>(&entry.second), sizeof(Entry));
+        }
+        if (!out) {
+            error = "Cannot write failure cache " + partialPath;
+            fs::remove(partialPath, ec);
+            return false;
+        }
+    }
+
+    fs::rename(partialPath, target, ec);
+    if (ec) {
+        error = "Cannot replace failure cache " + path_ + ": " + ec.message();
+        fs::remove(partialPath, ec);
+        return false;
+    }
+
+    dirty_ = false;
+    return true;
+}
+
+bool FailureCache::isLoaded() const {
+    return loaded_;
+}
+
+size_t FailureCache::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
+
+bool FailureCache::shouldSkip(const Utils::FileIdentity& identity) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(Key(identity.device, identity.inode));
+    return it != entries_.end() && it->second.modified == identity.modified && secondsNow() < it->second.retryAfter;
+}
+
+void FailureCache::recordFailure(const Utils::FileIdentity& identity, int errorCode) {
+    if (!loaded_) {
+        return;
+    }
+
+    int64_t now = secondsNow();
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry& entry = entries_[Key(identity.device, identity.inode)];
+
+    // Only the same failure on the same version of the file escalates
+    bool repeated = entry.failures > 0 && entry.modified == identity.modified && entry.errorCode == errorCode;
+    entry.failures = repeated ? entry.failures + 1 : 1;
+    entry.device = identity.device;
+    entry.inode = identity.inode;
+    entry.modified = identity.modified;
+    entry.errorCode = errorCode;
+    entry.lastFailure = now;
+
+    int64_t backoff = FAILURE_CACHE_BASE_BACKOFF_SECONDS;
+    for (uint32_t i = 1; i < entry.failures && backoff < FAILURE_CACHE_MAX_BACKOFF_SECONDS; ++i) {
+        backoff *= 2;
+    }
+    entry.retryAfter = now + std::min(backoff, FAILURE_CACHE_MAX_BACKOFF_SECONDS);
+    dirty_ = true;
+}
+
+void FailureCache::recordSuccess(const Utils::FileIdentity& identity) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (entries_.erase(Key(identity.device, identity.inode)) > 0) {
+        dirty_ = true;
+    }
+}
+
+// Called with the mutex held
+void FailureCache::prune(int64_t now) {
+    // Entries nobody has retried in a long time usually name files that are gone
+    for (auto it = entries_.begin(); it != entries_.end();) {
+        if (now - it->second.lastFailure > 2 * FAILURE_CACHE_MAX_BACKOFF_SECONDS) {
+            it = entries_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    if (entries_.size() <= FAILURE_CACHE_MAX_ENTRIES) {
+        return;
+    }
+
+    std::vector<std::pair<int64_t, Key>> byAge;
+    byAge.reserve(entries_.size());
+    for (const auto& entry : entries_) {
+        byAge.emplace_back(entry.second.lastFailure, entry.first);
+    }
+    size_t excess = entries_.size() - FAILURE_CACHE_MAX_ENTRIES;
+    std::nth_element(byAge.begin(), byAge.begin() + excess, byAge.end());
+    for (size_t i = 0; i < excess; ++i) {
+        entries_.erase(byAge[i].second);
+    }
+}
+
+}
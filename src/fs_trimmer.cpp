@@ -0,0 +1,162 @@
+#include "fs_trimmer.h"
+#include "pressure_monitor.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/statvfs.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace CClean {
+
+std::atomic<bool> FilesystemTrimmer::stopRequested_(false);
+
+namespace {
+
+#ifdef __linux__
+// From linux/ioprio.h, which older kernel headers don't ship
+const int IOPRIO_CLASS_SHIFT = 13;
+const int IOPRIO_CLASS_IDLE = 3;
+const int IOPRIO_WHO_PROCESS = 1;
+
+// Drops the calling thread to the idle I/O class for its lifetime, so the
+// discards only use bandwidth nothing else wants
+class IdleIoPriority {
+public:
+    IdleIoPriority()
+        : previous_(static_cast<int>(syscall(SYS_ioprio_get, IOPRIO_WHO_PROCESS, 0))) {
+        syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT);
+    }
+
+    ~IdleIoPriority() {
+        if (previous_ >= 0) {
+            syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, previous_);
+        }
+    }
+
+private:
+    int previous_;
+};
+#endif
+
+}
+
+FilesystemTrimmer::FilesystemTrimmer()
+    : chunkSize_(TRIM_CHUNK_SIZE)
+    , minimumExtent_(TRIM_MIN_EXTENT)
+    , pauseMilliseconds_(TRIM_CHUNK_PAUSE_MS) {
+}
+
+void FilesystemTrimmer::setChunkSize(uint64_t bytes) {
+    chunkSize_ = bytes;
+}
+
+void FilesystemTrimmer::setMinimumExtent(uint64_t bytes) {
+    minimumExtent_ = bytes;
+}
+
+void FilesystemTrimmer::setPause(int milliseconds) {
+    pauseMilliseconds_ = milliseconds;
+}
+
+void FilesystemTrimmer::requestStop() {
+    stopRequested_ = true;
+}
+
+void FilesystemTrimmer::clearStop() {
+    stopRequested_ = false;
+}
+
+bool FilesystemTrimmer::isSupported() {
+#ifdef __linux__
+    return true;
+#else
+    return false;
+#endif
+}
+
+#ifdef __linux__
+
+bool FilesystemTrimmer::trim(const std::string& path, Result& result, std::string& error) {
+    result = Result();
+
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        error = "Cannot open " + path + ": " + std::strerror(errno);
+        return false;
+    }
+
+    struct statvfs vfs;
+    if (fstatvfs(fd, &vfs) != 0) {
+        error = "Cannot stat filesystem of " + path + ": " + std::strerror(errno);
+        close(fd);
+        return false;
+    }
+    result.totalBytes = static_cast<uint64_t>(vfs.f_blocks) * vfs.f_frsize;
+
+    IdleIoPriority priority;
+    uint64_t chunkSize = chunkSize_ > 0 ? chunkSize_ : result.totalBytes;
+    bool ok = true;
+
+    // Ranges are in filesystem byte offsets; the kernel rounds them to
+    // blocks and reports in len how much it actually discarded
+    for (uint64_t start = 0; start < result.totalBytes; start += chunkSize) {
+        if (stopRequested_) {
+            result.interrupted = true;
+            break;
+        }
+        PressureMonitor::getInstance().pace();
+
+        struct fstrim_range range;
+        range.start = start;
+        // f_blocks leaves out ext4's metadata overhead and btrfs trims
+        // logical addresses beyond it, so like fstrim the last range runs
+        // to the end of the address space
+        range.len = chunkSize < result.totalBytes - start ? chunkSize : UINT64_MAX - start;
+        range.minlen = minimumExtent_;
+
+        if (ioctl(fd, FITRIM, &range) != 0) {
+            if (errno == EOPNOTSUPP || errno == ENOTTY) {
+                error = "Filesystem of " + path + " does not support trimming";
+            } else if (errno == EPERM) {
+                error = "Trimming " + path + " needs administrator rights";
+            } else {
+                error = "Cannot trim " + path + ": " + std::strerror(errno);
+            }
+            ok = false;
+            break;
+        }
+
+        result.trimmedBytes += range.len;
+        result.coveredBytes = std::min(start + chunkSize, result.totalBytes);
+        result.chunks++;
+
+        if (pauseMilliseconds_ > 0 && result.coveredBytes < result.totalBytes) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(pauseMilliseconds_));
+        }
+    }
+
+    close(fd);
+    return ok;
+}
+
+#else
+
+bool FilesystemTrimmer::trim(const std::string& path, Result& result, std::string& error) {
+    (void)path;
+    result = Result();
+    error = "Trimming is only supported on Linux; Windows retrims volumes on its own schedule";
+    return false;
+}
+
+#endif
+
+}
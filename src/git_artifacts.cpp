@@ -0,0 +1,774 @@
+#include "git_artifacts.h"
+#include "keep_list.h"
+#include "thread_pool.h"
+#include "tree_remover.h"
+#include "logger.h"
+#include "pressure_monitor.h"
+#include "utils.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+namespace CClean {
+
+namespace {
+
+bool hasWildcard(const std::string& text) {
+    return text.find_first_of("*?[\\") != std::string::npos;
+}
+
+bool endsWith(const std::string& text, const std::string& suffix) {
+    return text.size() >= suffix.size() &&
+           text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Matches one bracket expression at p against c. Returns false if the
+// expression is unterminated, in which case '[' is taken literally.
+bool matchBracket(const char* p, char c, const char** end, bool* matched) {
+    const char* q = p + 1;
+    bool negate = false;
+    if (*q == '!' || *q == '^') {
+        negate = true;
+        q++;
+    }
+
+    bool found = false;
+    bool first = true;
+    while (*q && (first || *q != ']')) {
+        first = false;
+        char low = *q;
+        if (low == '\\' && q[1]) {
+            low = *++q;
+        }
+        char high = low;
+        if (q[1] == '-' && q[2] && q[2] != ']') {
+            high = q[2];
+            if (high == '\\' && q[3]) {
+                high = q[3];
+                q++;
+            }
+            q += 2;
+        }
+        if (c >= low && c <= high) {
+            found = true;
+        }
+        q++;
+    }
+
+    if (*q != ']') {
+        return false;
+    }
+
+    *end = q + 1;
+    *matched = found != negate;
+    return true;
+}
+
+// Glob match with git's pathname rules: '*', '?' and brackets never match
+// '/', and a "**" segment matches any number of directories.
+bool globMatch(const char* pattern, const char* p, const char* t) {
+    while (*p) {
+        switch (*p) {
+            case '*': {
+                const char* stars = p;
+                while (*p == '*') {
+                    p++;
+                }
+
+                bool segmentStart = stars == pattern || stars[-1] == '/';
+                bool segmentEnd = *p == '\0' || *p == '/';
+                if (p - stars >= 2 && segmentStart && segmentEnd) {
+                    if (*p == '\0') {
+                        return true;
+                    }
+                    const char* rest = p + 1;
+                    for (const char* s = t;;) {
+                        if (globMatch(pattern, rest, s)) {
+                            return true;
+                        }
+                        const char* slash = std::strchr(s, '/');
+                        if (!slash) {
+                            return false;
+                        }
+                        s = slash + 1;
+                    }
+                }
+
+                for (const char* s = t;; s++) {
+                    if (globMatch(pattern, p, s)) {
+                        return true;
+                    }
+                    if (*s == '\0' || *s == '/') {
+                        return false;
+                    }
+                }
+            }
+            case '?':
+                if (*t == '\0' || *t == '/') {
+                    return false;
+                }
+                p++;
+                t++;
+                break;
+            case '[': {
+                if (*t == '\0' || *t == '/') {
+                    return false;
+                }
+                const char* end = nullptr;
+                bool matched = false;
+                if (!matchBracket(p, *t, &end, &matched)) {
+                    if (*t != '[') {
+                        return false;
+                    }
+                    p++;
+                    t++;
+                    break;
+                }
+                if (!matched) {
+                    return false;
+                }
+                p = end;
+                t++;
+                break;
+            }
+            case '\\':
+                if (p[1]) {
+                    p++;
+                }
+                // fall through
+            default:
+                if (*p != *t) {
+                    return false;
+                }
+                p++;
+                t++;
+                break;
+        }
+    }
+
+    return *t == '\0';
+}
+
+bool readFileContents(const std::string& filePath, std::string& contents) {
+    std::ifstream file(filePath, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+
+    std::ostringstream ss;
+    ss << file.rdbuf();
+    contents = ss.str();
+    return true;
+}
+
+uint32_t readBigEndian32(const unsigned char* p) {
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+// Resolves the git directory of a working tree, following the "gitdir:"
+// indirection used by submodules and linked worktrees.
+std::string resolveGitDir(const fs::path& workTree) {
+    fs::path dotGit = workTree / ".git";
+    std::error_code ec;
+
+    if (fs::is_directory(dotGit, ec)) {
+        return dotGit.string();
+    }
+
+    std::string contents;
+    if (!readFileContents(dotGit.string(), contents) || contents.compare(0, 8, "gitdir: ") != 0) {
+        return std::string();
+    }
+
+    std::string target = contents.substr(8);
+    while (!target.empty() && (target.back() == '\n' || target.back() == '\r')) {
+        target.pop_back();
+    }
+
+    fs::path gitDir(target);
+    if (gitDir.is_relative()) {
+        gitDir = workTree / gitDir;
+    }
+    return gitDir.lexically_normal().string();
+}
+
+bool isWorkTree(const fs::path& dirPath) {
+    std::error_code ec;
+    return fs::exists(dirPath / ".git", ec);
+}
+
+// Counts what removing dirPath whole would free. Stops with false at a
+// repository below it, which git clean -dX keeps unless forced twice.
+bool measureTree(const fs::path& dirPath, size_t& files, size_t& bytes) {
+    std::error_code ec;
+    fs::recursive_directory_iterator it(dirPath, fs::directory_options::skip_permission_denied, ec);
+
+    for (; !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+        std::error_code statEc;
+        if (it->path().filename() == ".git") {
+            return false;
+        }
+        if (it->is_regular_file(statEc) && !it->is_symlink(statEc)) {
+            files++;
+            bytes += it->file_size(statEc);
+        } else if (!it->is_directory(statEc) || it->is_symlink(statEc)) {
+            files++;
+        }
+    }
+    return true;
+}
+
+}
+
+GitIgnoreList::GitIgnoreList(const std::string& content, const std::string& baseDir)
+    : baseDir_(baseDir) {
+    std::istringstream stream(content);
+    std::string line;
+
+    while (std::getline(stream, line)) {
+        addPattern(line);
+    }
+}
+
+GitIgnoreList GitIgnoreList::load(const std::string& filePath, const std::string& baseDir) {
+    std::string contents;
+    if (!readFileContents(filePath, contents)) {
+        return GitIgnoreList();
+    }
+    return GitIgnoreList(contents, baseDir);
+}
+
+void GitIgnoreList::addPattern(std::string line) {
+    if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+    }
+
+    // Trailing spaces are dropped unless escaped with a backslash
+    while (!line.empty() && line.back() == ' ' &&
+           !(line.size() >= 2 && line[line.size() - 2] == '\\')) {
+        line.pop_back();
+    }
+
+    if (line.empty() || line[0] == '#') {
+        return;
+    }
+
+    GitIgnorePattern pattern;
+
+    if (line[0] == '!') {
+        pattern.negated = true;
+        line.erase(0, 1);
+    } else if (line[0] == '\\' && line.size() > 1 && (line[1] == '#' || line[1] == '!')) {
+        line.erase(0, 1);
+    }
+
+    if (!line.empty() && line.back() == '/') {
+        pattern.directoryOnly = true;
+        line.pop_back();
+    }
+
+    if (line.empty()) {
+        return;
+    }
+
+    if (line.find('/') != std::string::npos) {
+        pattern.anchored = true;
+        if (line[0] == '/') {
+            line.erase(0, 1);
+        }
+    }
+
+    if (!hasWildcard(line)) {
+        pattern.kind = GitIgnorePattern::Kind::LITERAL;
+    } else if (!pattern.anchored && line[0] == '*' && !hasWildcard(line.substr(1))) {
+        pattern.kind = GitIgnorePattern::Kind::SUFFIX;
+        line.erase(0, 1);
+    } else if (!pattern.anchored && line.back() == '*' && !hasWildcard(line.substr(0, line.size() - 1))) {
+        pattern.kind = GitIgnorePattern::Kind::PREFIX;
+        line.pop_back();
+    } else {
+        pattern.kind = GitIgnorePattern::Kind::GLOB;
+    }
+
+    pattern.pattern = line;
+    patterns_.push_back(std::move(pattern));
+}
+
+int GitIgnoreList::match(const std::string& relPath, const std::string& name, bool isDirectory) const {
+    // Anchored patterns are matched against the path below this file's directory
+    const char* pathBelowBase = nullptr;
+    if (baseDir_.empty()) {
+        pathBelowBase = relPath.c_str();
+    } else if (relPath.size() > baseDir_.size() &&
+               relPath.compare(0, baseDir_.size(), baseDir_) == 0 &&
+               relPath[baseDir_.size()] == '/') {
+        pathBelowBase = relPath.c_str() + baseDir_.size() + 1;
+    }
+
+    for (auto it = patterns_.rbegin(); it != patterns_.rend(); ++it) {
+        const GitIgnorePattern& pattern = *it;
+
+        if (pattern.directoryOnly && !isDirectory) {
+            continue;
+        }
+
+        bool matched = false;
+        if (pattern.anchored) {
+            if (!pathBelowBase) {
+                continue;
+            }
+            if (pattern.kind == GitIgnorePattern::Kind::LITERAL) {
+                matched = pattern.pattern == pathBelowBase;
+            } else {
+                matched = globMatch(pattern.pattern.c_str(), pattern.pattern.c_str(), pathBelowBase);
+            }
+        } else {
+            switch (pattern.kind) {
+                case GitIgnorePattern::Kind::LITERAL:
+                    matched = name == pattern.pattern;
+                    break;
+                case GitIgnorePattern::Kind::SUFFIX:
+                    matched = endsWith(name, pattern.pattern);
+                    break;
+                case GitIgnorePattern::Kind::PREFIX:
+                    matched = name.compare(0, pattern.pattern.size(), pattern.pattern) == 0;
+                    break;
+                case GitIgnorePattern::Kind::GLOB:
+                    matched = globMatch(pattern.pattern.c_str(), pattern.pattern.c_str(), name.c_str());
+                    break;
+            }
+        }
+
+        if (matched) {
+            return pattern.negated ? -1 : 1;
+        }
+    }
+
+    return 0;
+}
+
+bool GitIndex::load(const std::string& indexPath) {
+    paths_.clear();
+
+    std::string data;
+    if (!readFileContents(indexPath, data)) {
+        return false;
+    }
+
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data.data());
+    size_t size = data.size();
+
+    if (size < 12 || std::memcmp(bytes, "DIRC", 4) != 0) {
+        return false;
+    }
+
+    uint32_t version = readBigEndian32(bytes + 4);
+    uint32_t entryCount = readBigEndian32(bytes + 8);
+    if (version < 2 || version > 4) {
+        return false;
+    }
+
+    // SHA-256 repositories store 32-byte object ids in each entry
+    size_t hashSize = 20;
+    std::string config;
+    fs::path gitDir = fs::path(indexPath).parent_path();
+    if (readFileContents((gitDir / "config").string(), config)) {
+        std::transform(config.begin(), config.end(), config.begin(),
+                       [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        if (config.find("objectformat = sha256") != std::string::npos) {
+            hashSize = 32;
+        }
+    }
+
+    const size_t statSize = 40;
+    size_t offset = 12;
+    std::string previous;
+    paths_.reserve(entryCount);
+
+    for (uint32_t i = 0; i < entryCount; ++i) {
+        size_t entryStart = offset;
+        size_t flagsOffset = entryStart + statSize + hashSize;
+        if (flagsOffset + 2 > size) {
+            return false;
+        }
+
+        uint16_t flags = static_cast<uint16_t>((bytes[flagsOffset] << 8) | bytes[flagsOffset + 1]);
+        size_t nameOffset = flagsOffset + 2;
+        if (version >= 3 && (flags & 0x4000)) {
+            nameOffset += 2;
+        }
+        if (nameOffset >= size) {
+            return false;
+        }
+
+        std::string path;
+        if (version == 4) {
+            // Prefix-compressed: strip N bytes from the previous path, then append
+            size_t pos = nameOffset;
+            unsigned char c = bytes[pos++];
+            size_t strip = c & 0x7f;
+            while (c & 0x80) {
+                if (pos >= size) {
+                    return false;
+                }
+                c = bytes[pos++];
+                strip = ((strip + 1) << 7) | (c & 0x7f);
+            }
+
+            const void* nul = std::memchr(bytes + pos, 0, size - pos);
+            if (!nul || strip > previous.size()) {
+                return false;
+            }
+            size_t suffixLength = static_cast<const unsigned char*>(nul) - (bytes + pos);
+
+            path = previous.substr(0, previous.size() - strip);
+            path.append(reinterpret_cast<const char*>(bytes + pos), suffixLength);
+            offset = pos + suffixLength + 1;
+        } else {
+            const void* nul = std::memchr(bytes + nameOffset, 0, size - nameOffset);
+            if (!nul) {
+                return false;
+            }
+            size_t nameLength = static_cast<const unsigned char*>(nul) - (bytes + nameOffset);
+
+            path.assign(reinterpret_cast<const char*>(bytes + nameOffset), nameLength);
+            offset = entryStart + ((nameOffset - entryStart + nameLength + 8) & ~static_cast<size_t>(7));
+        }
+
+        // Conflicted paths appear once per stage; keep a single copy
+        if (paths_.empty() || paths_.back() != path) {
+            paths_.push_back(path);
+        }
+        previous = std::move(path);
+    }
+
+    std::sort(paths_.begin(), paths_.end());
+    paths_.erase(std::unique(paths_.begin(), paths_.end()), paths_.end());
+    return true;
+}
+
+bool GitIndex::isTracked(const std::string& relPath) const {
+    return std::binary_search(paths_.begin(), paths_.end(), relPath);
+}
+
+bool GitIndex::hasTrackedUnder(const std::string& relDir) const {
+    std::string prefix = relDir + "/";
+    auto it = std::lower_bound(paths_.begin(), paths_.end(), prefix);
+    return it != paths_.end() && it->compare(0, prefix.size(), prefix) == 0;
+}
+
+struct GitArtifactCleaner::Repository {
+    std::string workTree;
+    GitIndex index;
+    GitIgnoreList excludes;
+    std::deque<GitIgnoreList> ignoreLists;
+    std::vector<std::string> walkedIgnoredDirectories;   // children before parents
+};
+
+GitArtifactCleaner::GitArtifactCleaner(size_t threadCount)
+    : threadCount_(threadCount)
+    , keepList_(nullptr)
+    , dryRun_(false)
+    , verbose_(false)
+    , repositoriesProcessed_(0) {
+}
+
+void GitArtifactCleaner::setKeepList(const KeepList* keepList) {
+    keepList_ = keepList;
+}
+
+void GitArtifactCleaner::setDryRun(bool enabled) {
+    dryRun_ = enabled;
+}
+
+void GitArtifactCleaner::setVerbose(bool enabled) {
+    verbose_ = enabled;
+}
+
+CleanupResult GitArtifactCleaner::process(const std::string& rootPath, bool cleanMode) {
+    result_ = CleanupResult();
+    repositoriesProcessed_ = 0;
+
+    std::error_code ec;
+    if (!fs::is_directory(rootPath, ec)) {
+        result_.success = false;
+        result_.errorMessage = "Not a directory: " + rootPath;
+        return result_;
+    }
+
+    ThreadPool pool(threadCount_);
+
+    pool.submit([this, &pool, rootPath, cleanMode] {
+        discoverRepositories(pool, rootPath, cleanMode);
+    });
+    pool.wait();
+
+    // Ignored directories are removed wholesale, all of them fanned out
+    // across one tree remover. It keeps any repository it finds inside them,
+    // and those are then cleaned as working trees of their own.
+    while (!pendingDirectories_.empty()) {
+        TreeRemover remover(threadCount_);
+        remover.setPreserveMarker(".git");
+        CleanupResult removed = remover.remove(pendingDirectories_);
+        pendingDirectories_.clear();
+
+        result_.filesScanned += removed.filesScanned;
+        result_.filesDeleted += removed.filesDeleted;
+        result_.bytesFreed += removed.bytesFreed;
+        if (!removed.success) {
+            recordError(removed.errorMessage);
+        }
+
+        for (const auto& nestedTree : remover.preservedDirectories()) {
+            pool.submit([this, &pool, nestedTree, cleanMode] {
+                processRepository(pool, nestedTree, cleanMode);
+            });
+        }
+        pool.wait();
+    }
+
+    // Ignored directories walked entry by entry go too once they are empty;
+    // the ones still holding listed or tracked files simply stay
+    for (const auto& dirPath : emptiedDirectories_) {
+        if (fs::remove(dirPath, ec) && verbose_) {
+            Logger::getInstance().debug("Deleted: " + dirPath);
+        }
+    }
+    emptiedDirectories_.clear();
+
+    Logger::getInstance().info("Git artifacts: " + std::to_string(repositoriesProcessed_) +
+                              " working trees, " + std::to_string(result_.filesScanned) +
+                              " ignored files, " + Utils::formatBytes(result_.bytesFreed));
+
+    return result_;
+}
+
+void GitArtifactCleaner::discoverRepositories(ThreadPool& pool, const std::string& dirPath, bool cleanMode) {
+    if (isWorkTree(dirPath)) {
+        processRepository(pool, dirPath, cleanMode);
+        return;
+    }
+
+    std::error_code ec;
+    fs::directory_iterator it(dirPath, fs::directory_options::skip_permission_denied, ec);
+
+    for (; !ec && it != fs::directory_iterator(); it.increment(ec)) {
+        std::error_code statEc;
+        if (it->is_symlink(statEc) || !it->is_directory(statEc)) {
+            continue;
+        }
+
+        std::string childPath = it->path().string();
+        pool.submit([this, &pool, childPath, cleanMode] {
+            discoverRepositories(pool, childPath, cleanMode);
+        });
+    }
+}
+
+void GitArtifactCleaner::processRepository(ThreadPool& pool, const std::string& workTree, bool cleanMode) {
+    Repository repo;
+    repo.workTree = workTree;
+
+    std::string gitDir = resolveGitDir(workTree);
+    if (gitDir.empty()) {
+        return;
+    }
+
+    // A fresh repository has no index yet and tracks nothing. A corrupt one
+    // would make every file look untracked, so that tree is skipped.
+    fs::path indexPath = fs::path(gitDir) / "index";
+    std::error_code ec;
+    if (fs::exists(indexPath, ec) && !repo.index.load(indexPath.string())) {
+        recordError("Unreadable git index in " + workTree);
+        return;
+    }
+
+    repo.excludes = GitIgnoreList::load((fs::path(gitDir) / "info" / "exclude").string(), "");
+
+    std::vector<const GitIgnoreList*> ignoreStack;
+    if (!repo.excludes.empty()) {
+        ignoreStack.push_back(&repo.excludes);
+    }
+
+    std::vector<Artifact> artifacts;
+    walkDirectory(pool, repo, workTree, "", ignoreStack, false, cleanMode, artifacts);
+
+    {
+        std::lock_guard<std::mutex> lock(resultMutex_);
+        repositoriesProcessed_++;
+        for (const auto& artifact : artifacts) {
+            result_.filesScanned += artifact.files;
+            if (!cleanMode || dryRun_) {
+                result_.bytesFreed += artifact.bytes;
+                if (cleanMode) {
+                    result_.filesDeleted += artifact.files;
+                }
+            }
+        }
+    }
+
+    if (verbose_) {
+        Logger::getInstance().debug("Git working tree " + workTree + ": " +
+                                    std::to_string(artifacts.size()) + " ignored entries (" +
+                                    std::to_string(repo.index.size()) + " tracked)");
+    }
+
+    if (!cleanMode) {
+        return;
+    }
+
+    for (auto& artifact : artifacts) {
+        if (dryRun_) {
+            if (verbose_) {
+                Logger::getInstance().debug("DRY RUN: Would delete " + artifact.path + " (" +
+                                            Utils::formatBytes(artifact.bytes) + ")");
+            }
+            continue;
+        }
+
+        if (artifact.isDirectory) {
+            std::lock_guard<std::mutex> lock(resultMutex_);
+            pendingDirectories_.push_back(artifact.path);
+        } else {
+            pool.submit([this, artifact] { removeArtifact(artifact); });
+        }
+    }
+
+    if (!dryRun_ && !repo.walkedIgnoredDirectories.empty()) {
+        std::lock_guard<std::mutex> lock(resultMutex_);
+        emptiedDirectories_.insert(emptiedDirectories_.end(), repo.walkedIgnoredDirectories.begin(),
+                                   repo.walkedIgnoredDirectories.end());
+    }
+}
+
+void GitArtifactCleaner::walkDirectory(ThreadPool& pool, Repository& repo, const std::string& absDir,
+                                       const std::string& relDir, std::vector<const GitIgnoreList*> ignoreStack,
+                                       bool parentIgnored, bool cleanMode, std::vector<Artifact>& artifacts) {
+    if (!parentIgnored) {
+        fs::path ignoreFile = fs::path(absDir) / ".gitignore";
+        std::error_code ec;
+        if (fs::is_regular_file(ignoreFile, ec)) {
+            repo.ignoreLists.push_back(GitIgnoreList::load(ignoreFile.string(), relDir));
+            if (!repo.ignoreLists.back().empty()) {
+                ignoreStack.push_back(&repo.ignoreLists.back());
+            }
+        }
+    }
+
+    std::error_code ec;
+    fs::directory_iterator it(absDir, fs::directory_options::skip_permission_denied, ec);
+    if (ec) {
+        return;
+    }
+
+    for (; !ec && it != fs::directory_iterator(); it.increment(ec)) {
+        PressureMonitor::getInstance().pace();
+
+        std::string name = it->path().filename().string();
+        if (name == ".git") {
+            continue;
+        }
+
+        std::error_code statEc;
+        bool isDirectory = it->is_directory(statEc) && !it->is_symlink(statEc);
+        std::string relPath = relDir.empty() ? name : relDir + "/" + name;
+
+        if (isDirectory && isWorkTree(it->path())) {
+            std::string nestedTree = it->path().string();
+            pool.submit([this, &pool, nestedTree, cleanMode] {
+                processRepository(pool, nestedTree, cleanMode);
+            });
+            continue;
+        }
+
+        if (!isDirectory && repo.index.isTracked(relPath)) {
+            continue;
+        }
+
+        // Deeper ignore files take precedence over their parents
+        bool ignored = parentIgnored;
+        if (!ignored) {
+            for (auto list = ignoreStack.rbegin(); list != ignoreStack.rend(); ++list) {
+                int decision = (*list)->match(relPath, name, isDirectory);
+                if (decision != 0) {
+                    ignored = decision > 0;
+                    break;
+                }
+            }
+        }
+
+        // Listing a directory keeps everything below it
+        bool checkKeepList = keepList_ && keepList_->isLoaded();
+        if (ignored && checkKeepList && keepList_->contains(it->path().string())) {
+            if (verbose_) {
+                Logger::getInstance().debug("Keeping listed path: " + it->path().string());
+            }
+            continue;
+        }
+
+        if (!isDirectory) {
+            if (ignored) {
+                size_t bytes = it->is_regular_file(statEc) ? it->file_size(statEc) : 0;
+                artifacts.push_back({ it->path().string(), false, 1, bytes });
+            }
+            continue;
+        }
+
+        // Only a directory holding listed or tracked paths needs walking
+        // entry by entry. When deleting for real the tree remover counts as
+        // it goes and keeps nested repositories; otherwise measuring finds them.
+        if (ignored && !(checkKeepList && keepList_->containsBelow(it->path().string())) &&
+            !repo.index.hasTrackedUnder(relPath)) {
+            Artifact artifact{ it->path().string(), true, 0, 0 };
+            if ((cleanMode && !dryRun_) || measureTree(it->path(), artifact.files, artifact.bytes)) {
+                artifacts.push_back(std::move(artifact));
+                continue;
+            }
+        }
+
+        walkDirectory(pool, repo, it->path().string(), relPath, ignoreStack, ignored, cleanMode, artifacts);
+        if (ignored && cleanMode) {
+            repo.walkedIgnoredDirectories.push_back(it->path().string());
+        }
+    }
+}
+
+void GitArtifactCleaner::removeArtifact(const Artifact& artifact) {
+    PressureMonitor::getInstance().pace();
+
+    std::error_code ec;
+    fs::remove(artifact.path, ec);
+
+    if (ec) {
+        recordError("Failed to delete " + artifact.path + ": " + ec.message());
+        return;
+    }
+
+    if (verbose_) {
+        Logger::getInstance().debug("Deleted: " + artifact.path + " (" + Utils::formatBytes(artifact.bytes) + ")");
+    }
+
+    std::lock_guard<std::mutex> lock(resultMutex_);
+    result_.filesDeleted += artifact.files;
+    result_.bytesFreed += artifact.bytes;
+}
+
+void GitArtifactCleaner::recordError(const std::string& error) {
+    Logger::getInstance().warning(error);
+
+    std::lock_guard<std::mutex> lock(resultMutex_);
+    if (result_.errorMessage.empty()) {
+        result_.errorMessage = error;
+    }
+}
+
+}
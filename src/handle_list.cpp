@@ -0,0 +1,544 @@
+#include "handle_list.h"
+#include "failure_cache.h"
+#include "logger.h"
+#include "pressure_monitor.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace CClean {
+
+namespace {
+
+const char HANDLE_LIST_MAGIC[8] = { 'C', 'C', 'H', 'N', 'D', 'L', '0', '1' };
+
+struct ListHeader {
+    char magic[8];
+    uint32_t mountCount;
+    uint32_t parentCount;
+    uint64_t entryCount;
+};
+
+// Each record is followed by pathLength, handleBytes or nameLength bytes
+struct MountRecord {
+    uint64_t device;
+    uint32_t pathLength;
+    uint32_t reserved;
+};
+
+struct ParentRecord {
+    uint32_t mount;
+    int32_t handleType;
+    uint32_t handleBytes;
+    uint32_t reserved;
+};
+
+struct EntryRecord {
+    uint64_t device;
+    uint64_t inode;
+    int64_t modified;
+    uint64_t size;
+    uint32_t parent;
+    uint32_t nameLength;
+};
+
+const uint32_t HANDLE_LIST_MAX_STRING = 64 * 1024;
+
+template <typename T>
+void writeRecord(std::ofstream& out, const T& record, const std::string& bytes) {
+    out.write(reinterpret_cast<const char*>(&record), sizeof(record));
+    out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+}
+
+template <typename T>
+bool readRecord(std::ifstream& in, T& record, uint32_t T::*length, std::string& bytes) {
+    if (!in.read(reinterpret_cast<char*>(&record), sizeof(record)) || record.*length > HANDLE_LIST_MAX_STRING) {
+        return false;
+    }
+    bytes.assign(record.*length, '\0');
+    return record.*length == 0 || static_cast<bool>(in.read(&bytes[0], record.*length));
+}
+
+#ifdef __linux__
+// Mount point of a mount id, from /proc/self/mountinfo (field 5, with
+// spaces and the like escaped as \ooo)
+std::string mountPointOf(int mountId) {
+    std::ifstream in("/proc/self/mountinfo");
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        int id = 0;
+        std::string parentId, majorMinor, root, mountPoint;
+        if (!(fields >> id >> parentId >> majorMinor >> root >> mountPoint) || id != mountId) {
+            continue;
+        }
+
+        std::string decoded;
+        for (size_t i = 0; i < mountPoint.size(); ++i) {
+            if (mountPoint[i] == '\\' && i + 3 < mountPoint.size()) {
+                decoded += static_cast<char>(std::stoi(mountPoint.substr(i + 1, 3), nullptr, 8));
+                i += 3;
+            } else {
+                decoded += mountPoint[i];
+            }
+        }
+        return decoded;
+    }
+    return std::string();
+}
+
+int openByHandle(int mountFd, int32_t handleType, const std::string& handleBytes) {
+    std::vector<char> buffer(sizeof(struct file_handle) + handleBytes.size());
+    auto* handle = reinterpret_cast<struct file_handle*>(buffer.data());
+    handle->handle_bytes = static_cast<unsigned int>(handleBytes.size());
+    handle->handle_type = handleType;
+    std::memcpy(handle->f_handle, handleBytes.data(), handleBytes.size());
+    return open_by_handle_at(mountFd, handle, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+}
+#endif
+
+}
+
+HandleList::HandleList()
+    : failureCache_(nullptr)
+    , dryRun_(false)
+    , verbose_(false)
+    , filesMissing_(0)
+    , filesChanged_(0) {
+}
+
+bool HandleList::isSupported() {
+#ifdef __linux__
+    return true;
+#else
+    return false;
+#endif
+}
+
+void HandleList::setFileFilter(FileFilter filter) {
+    filter_ = std::move(filter);
+}
+
+void HandleList::setFailureCache(FailureCache* cache) {
+    failureCache_ = cache;
+}
+
+void HandleList::setDryRun(bool enabled) {
+    dryRun_ = enabled;
+}
+
+void HandleList::setVerbose(bool enabled) {
+    verbose_ = enabled;
+}
+
+size_t HandleList::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
+
+std::vector<std::string> HandleList::mountPaths() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<std::string> paths;
+    for (const auto& mount : mounts_) {
+        paths.push_back(mount.path);
+    }
+    return paths;
+}
+
+#ifdef __linux__
+
+bool HandleList::add(const std::string& filePath, const Utils::FileIdentity& identity, std::string& error) {
+    fs::path path(filePath);
+    std::string parentPath = path.parent_path().string();
+
+    Entry entry;
+    entry.identity = identity;
+    entry.name = path.filename().string();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = parentIndex_.find(parentPath);
+        if (it != parentIndex_.end()) {
+            entry.parent = it->second;
+            entries_.push_back(std::move(entry));
+            return true;
+        }
+    }
+
+    // First candidate in this directory: one handle serves all its files
+    std::vector<char> buffer(sizeof(struct file_handle) + MAX_HANDLE_SZ);
+    auto* handle = reinterpret_cast<struct file_handle*>(buffer.data());
+    handle->handle_bytes = MAX_HANDLE_SZ;
+    int mountId = 0;
+    if (name_to_handle_at(AT_FDCWD, parentPath.c_str(), handle, &mountId, 0) != 0) {
+        if (errno == EOPNOTSUPP) {
+            error = "The filesystem of " + parentPath + " does not support file handles";
+        } else {
+            error = "Cannot get a handle for " + parentPath + ": " + std::strerror(errno);
+        }
+        return false;
+    }
+
+    bool knownMount = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        knownMount = mountIndex_.find(mountId) != mountIndex_.end();
+    }
+    std::string mountPath;
+    uint64_t mountDevice = 0;
+    if (!knownMount) {
+        mountPath = mountPointOf(mountId);
+        if (mountPath.empty()) {
+            error = "Cannot find the mount point of " + parentPath;
+            return false;
+        }
+        // The mount's own device, which apply() checks the reopened mount
+        // point against; on btrfs a file in a subvolume reports another one
+        struct stat mountStat;
+        if (stat(mountPath.c_str(), &mountStat) != 0) {
+            error = "Cannot stat the mount point " + mountPath + ": " + std::strerror(errno);
+            return false;
+        }
+        mountDevice = static_cast<uint64_t>(mountStat.st_dev);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto mount = mountIndex_.find(mountId);
+    if (mount == mountIndex_.end()) {
+        Mount record;
+        record.device = mountDevice;
+        record.path = mountPath;
+        mounts_.push_back(record);
+        mount = mountIndex_.emplace(mountId, static_cast<uint32_t>(mounts_.size() - 1)).first;
+    }
+
+    auto it = parentIndex_.find(parentPath);
+    if (it == parentIndex_.end()) {
+        Parent parent;
+        parent.mount = mount->second;
+        parent.handleType = handle->handle_type;
+        parent.handle.assign(reinterpret_cast<const char*>(handle->f_handle), handle->handle_bytes);
+        parents_.push_back(std::move(parent));
+        it = parentIndex_.emplace(parentPath, static_cast<uint32_t>(parents_.size() - 1)).first;
+    }
+    entry.parent = it->second;
+    entries_.push_back(std::move(entry));
+    return true;
+}
+
+CleanupResult HandleList::apply() {
+    result_ = CleanupResult();
+    filesMissing_ = 0;
+    filesChanged_ = 0;
+
+    std::vector<std::vector<const Entry*>> byParent(parents_.size());
+    for (const auto& entry : entries_) {
+        if (entry.parent < parents_.size()) {
+            byParent[entry.parent].push_back(&entry);
+        }
+    }
+
+    // Mount points are the only paths opened, and must still be the
+    // filesystems the handles were taken on
+    std::vector<int> mountFds(mounts_.size(), -1);
+    for (size_t i = 0; i < mounts_.size(); ++i) {
+        int fd = open(mounts_[i].path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        struct stat st;
+        if (fd >= 0 && fstat(fd, &st) == 0 && static_cast<uint64_t>(st.st_dev) == mounts_[i].device) {
+            mountFds[i] = fd;
+            continue;
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+        Logger::getInstance().warning("Filesystem once mounted at " + mounts_[i].path + " is not there any more");
+    }
+
+    // Probe one handle first: without CAP_DAC_READ_SEARCH every open fails
+    for (size_t i = 0; i < parents_.size(); ++i) {
+        if (mountFds[parents_[i].mount] < 0 || byParent[i].empty()) {
+            continue;
+        }
+        int fd = openByHandle(mountFds[parents_[i].mount], parents_[i].handleType, parents_[i].handle);
+        if (fd >= 0) {
+            close(fd);
+            break;
+        }
+        if (errno == EPERM) {
+            for (int mountFd : mountFds) {
+                if (mountFd >= 0) {
+                    close(mountFd);
+                }
+            }
+            result_.success = false;
+            result_.errorMessage = "Opening files by handle needs administrator rights (CAP_DAC_READ_SEARCH)";
+            return result_;
+        }
+        break;
+    }
+
+    {
+        ThreadPool pool;
+        for (size_t i = 0; i < parents_.size(); ++i) {
+            if (byParent[i].empty()) {
+                continue;
+            }
+            int mountFd = mountFds[parents_[i].mount];
+            pool.submit([this, i, &byParent, mountFd] { applyParent(static_cast<uint32_t>(i), byParent[i], mountFd); });
+        }
+        pool.wait();
+    }
+
+    for (int mountFd : mountFds) {
+        if (mountFd >= 0) {
+            close(mountFd);
+        }
+    }
+
+    if (filesMissing_ > 0 || filesChanged_ > 0) {
+        Logger::getInstance().info("Left alone " + std::to_string(filesMissing_) + " files that are gone and " +
+                                   std::to_string(filesChanged_) + " that changed since the scan");
+    }
+    return result_;
+}
+
+void HandleList::applyParent(uint32_t parentIndex, const std::vector<const Entry*>& entries, int mountFd) {
+    const Parent& parent = parents_[parentIndex];
+
+    int directoryFd = -1;
+    int openError = ESTALE;
+    if (mountFd >= 0) {
+        directoryFd = openByHandle(mountFd, parent.handleType, parent.handle);
+        openError = errno;
+    }
+
+    if (directoryFd < 0) {
+        // A stale handle means the directory itself was deleted
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (openError == ESTALE) {
+            filesMissing_ += entries.size();
+        } else {
+            result_.success = false;
+            if (result_.errorMessage.empty()) {
+                result_.errorMessage = std::string("Cannot open a directory by handle: ") + std::strerror(openError);
+            }
+        }
+        return;
+    }
+
+    // Only for the filter and messages; the deletion itself never uses it
+    std::string directoryPath;
+    if (filter_ || verbose_) {
+        std::error_code ec;
+        directoryPath = fs::read_symlink("/proc/self/fd/" + std::to_string(directoryFd), ec).string();
+    }
+    if (filter_ && directoryPath.empty()) {
+        // The filter cannot be checked without a path; leave the files alone
+        Logger::getInstance().warning("Cannot resolve the path of a recorded directory, skipping its " +
+                                      std::to_string(entries.size()) + " files");
+        close(directoryFd);
+        std::lock_guard<std::mutex> lock(mutex_);
+        filesChanged_ += entries.size();
+        return;
+    }
+
+    for (const Entry* entry : entries) {
+        PressureMonitor::getInstance().pace();
+
+        struct stat st;
+        if (fstatat(directoryFd, entry->name.c_str(), &st, AT_SYMLINK_NOFOLLOW) != 0) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            filesMissing_++;
+            continue;
+        }
+
+        int64_t modified = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+        if (static_cast<uint64_t>(st.st_ino) != entry->identity.inode ||
+            static_cast<uint64_t>(st.st_dev) != entry->identity.device || modified != entry->identity.modified) {
+            if (verbose_) {
+                Logger::getInstance().debug("Changed since the scan: " + directoryPath + "/" + entry->name);
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            filesChanged_++;
+            continue;
+        }
+
+        std::string filePath = directoryPath + "/" + entry->name;
+        if (filter_ && !filter_(filePath)) {
+            continue;
+        }
+
+        size_t fileSize = static_cast<size_t>(st.st_size);
+        if (!dryRun_ && unlinkat(directoryFd, entry->name.c_str(), 0) != 0) {
+            int errorCode = errno;
+            if (failureCache_) {
+                failureCache_->recordFailure(entry->identity, errorCode);
+            }
+            Logger::getInstance().warning("Failed to delete " + filePath + ": " + std::strerror(errorCode));
+            continue;
+        }
+
+        if (failureCache_ && !dryRun_) {
+            failureCache_->recordSuccess(entry->identity);
+        }
+        if (verbose_) {
+            Logger::getInstance().debug(std::string(dryRun_ ? "Would delete: " : "Deleted: ") + filePath);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        result_.filesScanned++;
+        result_.filesDeleted++;
+        result_.bytesFreed += fileSize;
+    }
+
+    close(directoryFd);
+}
+
+#else
+
+bool HandleList::add(const std::string& filePath, const Utils::FileIdentity& identity, std::string& error) {
+    (void)filePath;
+    (void)identity;
+    error = "Saving file handles is only supported on Linux";
+    return false;
+}
+
+CleanupResult HandleList::apply() {
+    result_ = CleanupResult();
+    result_.success = false;
+    result_.errorMessage = "Deleting by file handle is only supported on Linux";
+    return result_;
+}
+
+void HandleList::applyParent(uint32_t parentIndex, const std::vector<const Entry*>& entries, int mountFd) {
+    (void)parentIndex;
+    (void)entries;
+    (void)mountFd;
+}
+
+#endif
+
+bool HandleList::save(const std::string& listPath, std::string& error) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    std::error_code ec;
+    fs::path target(listPath);
+    if (target.has_parent_path()) {
+        fs::create_directories(target.parent_path(), ec);
+    }
+
+    std::string partialPath = listPath + ".partial";
+    {
+        std::ofstream out(partialPath, std::ios::binary | std::ios::trunc);
+        ListHeader header;
+        std::memcpy(header.magic, HANDLE_LIST_MAGIC, sizeof(header.magic));
+        header.mountCount = static_cast<uint32_t>(mounts_.size());
+        header.parentCount = static_cast<uint32_t>(parents_.size());
+        header.entryCount = entries_.size();
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        for (const auto& mount : mounts_) {
+            MountRecord record = { mount.device, static_cast<uint32_t>(mount.path.size()), 0 };
+            writeRecord(out, record, mount.path);
+        }
+        for (const auto& parent : parents_) {
+            ParentRecord record = { parent.mount, parent.handleType, static_cast<uint32_t>(parent.handle.size()), 0 };
+            writeRecord(out, record, parent.handle);
+        }
+        for (const auto& entry : entries_) {
+            EntryRecord record = { entry.identity.device, entry.identity.inode, entry.identity.modified,
+                                   entry.identity.size, entry.parent, static_cast<uint32_t>(entry.name.size()) };
+            writeRecord(out, record, entry.name);
+        }
+
+        if (!out) {
+            error = "Cannot write handle list " + partialPath;
+            fs::remove(partialPath, ec);
+            return false;
+        }
+    }
+
+    fs::rename(partialPath, target, ec);
+    if (ec) {
+        error = "Cannot replace handle list " + listPath + ": " + ec.message();
+        fs::remove(partialPath, ec);
+        return false;
+    }
+    return true;
+}
+
+bool HandleList::load(const std::string& listPath, std::string& error) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    mounts_.clear();
+    parents_.clear();
+    entries_.clear();
+    parentIndex_.clear();
+    mountIndex_.clear();
+
+    std::ifstream in(listPath, std::ios::binary);
+    if (!in) {
+        error = "Cannot open handle list " + listPath;
+        return false;
+    }
+
+    ListHeader header;
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, HANDLE_LIST_MAGIC, sizeof(header.magic)) != 0) {
+        error = listPath + " is not a handle list saved by --save-handles";
+        return false;
+    }
+
+    std::string bytes;
+    for (uint32_t i = 0; i < header.mountCount; ++i) {
+        MountRecord record;
+        if (!readRecord(in, record, &MountRecord::pathLength, bytes)) {
+            error = "Handle list " + listPath + " is truncated";
+            return false;
+        }
+        Mount mount;
+        mount.device = record.device;
+        mount.path = bytes;
+        mounts_.push_back(std::move(mount));
+    }
+    for (uint32_t i = 0; i < header.parentCount; ++i) {
+        ParentRecord record;
+        if (!readRecord(in, record, &ParentRecord::handleBytes, bytes) || record.mount >= mounts_.size()) {
+            error = "Handle list " + listPath + " is truncated";
+            return false;
+        }
+        Parent parent;
+        parent.mount = record.mount;
+        parent.handleType = record.handleType;
+        parent.handle = bytes;
+        parents_.push_back(std::move(parent));
+    }
+    for (uint64_t i = 0; i < header.entryCount; ++i) {
+        EntryRecord record;
+        if (!readRecord(in, record, &EntryRecord::nameLength, bytes) || record.parent >= parents_.size()) {
+            error = "Handle list " + listPath + " is truncated";
+            return false;
+        }
+        Entry entry;
+        entry.parent = record.parent;
+        entry.identity.device = record.device;
+        entry.identity.inode = record.inode;
+        entry.identity.modified = record.modified;
+        entry.identity.size = static_cast<size_t>(record.size);
+        entry.name = bytes;
+        entries_.push_back(std::move(entry));
+    }
+    return true;
+}
+
+}
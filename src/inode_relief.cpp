@@ -0,0 +1,269 @@
+#include "inode_relief.h"
+#include "logger.h"
+#include "pressure_monitor.h"
+#include "utils.h"
+#include <algorithm>
+#include <filesystem>
+#include <unordered_map>
+#ifndef _WIN32
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace CClean {
+
+namespace {
+
+unsigned long long deviceOf(const std::string& path) {
+#ifndef _WIN32
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0) {
+        return static_cast<unsigned long long>(st.st_dev);
+    }
+#else
+    (void)path;
+#endif
+    return 0;
+}
+
+}
+
+InodeReliefCleaner::InodeReliefCleaner()
+    : target_(0)
+    , percent_(false)
+    , dryRun_(false)
+    , verbose_(false) {
+}
+
+void InodeReliefCleaner::setTarget(size_t target, bool percent) {
+    target_ = target;
+    percent_ = percent;
+}
+
+void InodeReliefCleaner::setFileFilter(FileFilter filter) {
+    filter_ = filter;
+}
+
+void InodeReliefCleaner::setDryRun(bool enabled) {
+    dryRun_ = enabled;
+}
+
+void InodeReliefCleaner::setVerbose(bool enabled) {
+    verbose_ = enabled;
+}
+
+bool InodeReliefCleaner::isSupported() {
+#ifdef _WIN32
+    return false;
+#else
+    return true;
+#endif
+}
+
+CleanupResult InodeReliefCleaner::process(const std::vector<std::string>& rootPaths, bool cleanMode) {
+    CleanupResult result;
+    filesystems_.clear();
+
+    std::vector<DirectoryStats> directories;
+    for (const auto& rootPath : rootPaths) {
+        walk(rootPath, directories);
+    }
+
+    for (const auto& directory : directories) {
+        if (!filesystemFor(directory.device, directory.path)) {
+            result.success = false;
+            result.errorMessage = "Cannot read inode counts for " + directory.path + ": " + Utils::getLastError();
+            Logger::getInstance().error(result.errorMessage);
+            return result;
+        }
+    }
+
+    std::vector<size_t> initialAvailable;
+    for (const auto& filesystem : filesystems_) {
+        initialAvailable.push_back(filesystem.available);
+    }
+
+    // Most files per byte first: those directories return inodes cheapest
+    std::sort(directories.begin(), directories.end(), [](const DirectoryStats& a, const DirectoryStats& b) {
+        double densityA = static_cast<double>(a.files.size()) / (a.bytes + 1);
+        double densityB = static_cast<double>(b.files.size()) / (b.bytes + 1);
+        return densityA != densityB ? densityA > densityB : a.files.size() > b.files.size();
+    });
+
+    bool deleting = cleanMode && !dryRun_;
+
+    for (const auto& directory : directories) {
+        FilesystemState* filesystem = filesystemFor(directory.device, directory.path);
+        if (targetReached(*filesystem, deleting)) {
+            continue;
+        }
+
+        size_t removedHere = 0;
+        for (const auto& file : directory.files) {
+            if (targetReached(*filesystem, deleting)) {
+                break;
+            }
+
+            PressureMonitor::getInstance().pace();
+
+            if (filter_ && !filter_(file.first)) {
+                continue;
+            }
+
+            result.filesScanned++;
+
+            if (!deleting) {
+                if (cleanMode) {
+                    result.filesDeleted++;
+                }
+                result.bytesFreed += file.second;
+                filesystem->freedSinceProbe++;
+                removedHere++;
+                continue;
+            }
+
+            if (Utils::deleteFileSecure(file.first)) {
+                result.filesDeleted++;
+                result.bytesFreed += file.second;
+                filesystem->freedSinceProbe++;
+                removedHere++;
+            } else {
+                std::string error = "Failed to delete " + file.first + ": " + Utils::getLastError();
+                Logger::getInstance().warning(error);
+                if (result.errorMessage.empty()) {
+                    result.errorMessage = error;
+                }
+            }
+        }
+
+        // An emptied directory is one more inode back
+        if (deleting && !directory.isRoot && removedHere == directory.files.size()) {
+            std::error_code ec;
+            if (fs::remove(directory.path, ec)) {
+                filesystem->freedSinceProbe++;
+            }
+        }
+
+        if (verbose_ && removedHere > 0) {
+            Logger::getInstance().debug(std::string(deleting ? "Freed " : "Would free ") + std::to_string(removedHere) +
+                                        " inodes in " + directory.path + " (" +
+                                        std::to_string(directory.files.size()) + " files, " +
+                                        Utils::formatBytes(directory.bytes) + ")");
+        }
+    }
+
+    for (size_t i = 0; i < filesystems_.size(); ++i) {
+        FilesystemState& filesystem = filesystems_[i];
+        size_t available = filesystem.available + filesystem.freedSinceProbe;
+        if (deleting && probe(filesystem)) {
+            available = filesystem.available;
+        }
+
+        std::string message = "Free inodes on " + filesystem.probePath + ": " + std::to_string(initialAvailable[i]) +
+                               " -> " + std::to_string(available) + " (target " + std::to_string(filesystem.target) + ")";
+        if (available < filesystem.target) {
+            Logger::getInstance().warning(message + "; not enough deletable files to reach the target");
+        } else {
+            Logger::getInstance().info(message);
+        }
+    }
+
+    return result;
+}
+
+void InodeReliefCleaner::walk(const std::string& rootPath, std::vector<DirectoryStats>& directories) {
+    std::unordered_map<std::string, size_t> indexByPath;
+
+    auto directoryFor = [&](const std::string& path) -> DirectoryStats& {
+        auto it = indexByPath.find(path);
+        if (it != indexByPath.end()) {
+            return directories[it->second];
+        }
+
+        DirectoryStats stats;
+        stats.path = path;
+        stats.device = deviceOf(path);
+        indexByPath.emplace(path, directories.size());
+        directories.push_back(std::move(stats));
+        return directories.back();
+    };
+
+    std::error_code ec;
+    if (!fs::is_directory(rootPath, ec)) {
+        return;
+    }
+    directoryFor(rootPath).isRoot = true;
+
+    fs::recursive_directory_iterator it(rootPath, fs::directory_options::skip_permission_denied, ec);
+    for (; !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+        PressureMonitor::getInstance().pace();
+
+        std::error_code statEc;
+        if (it->is_directory(statEc) && !it->is_symlink(statEc)) {
+            directoryFor(it->path().string());
+            continue;
+        }
+
+        size_t size = it->is_regular_file(statEc) && !it->is_symlink(statEc)
+            ? static_cast<size_t>(it->file_size(statEc))
+            : 0;
+
+        DirectoryStats& parent = directoryFor(it->path().parent_path().string());
+        parent.files.emplace_back(it->path().string(), size);
+        parent.bytes += size;
+    }
+}
+
+InodeReliefCleaner::FilesystemState* InodeReliefCleaner::filesystemFor(unsigned long long device,
+                                                                      const std::string& probePath) {
+    for (auto& filesystem : filesystems_) {
+        if (filesystem.device == device) {
+            return &filesystem;
+        }
+    }
+
+    FilesystemState state;
+    state.device = device;
+    state.probePath = probePath;
+    if (!probe(state)) {
+        return nullptr;
+    }
+
+    filesystems_.push_back(state);
+    return &filesystems_.back();
+}
+
+bool InodeReliefCleaner::probe(FilesystemState& state) {
+#ifdef _WIN32
+    (void)state;
+    return false;
+#else
+    struct statvfs info;
+    if (statvfs(state.probePath.c_str(), &info) != 0) {
+        return false;
+    }
+
+    state.available = static_cast<size_t>(info.f_favail);
+    state.target = percent_ ? static_cast<size_t>(static_cast<double>(info.f_files) * target_ / 100.0) : target_;
+    state.freedSinceProbe = 0;
+    return true;
+#endif
+}
+
+bool InodeReliefCleaner::targetReached(FilesystemState& state, bool deleting) {
+    size_t estimated = state.available + state.freedSinceProbe;
+
+    // Deletions are counted locally and confirmed against statvfs once the
+    // estimate says we are done, or periodically to catch other writers
+    if (deleting && state.freedSinceProbe > 0 && (estimated >= state.target || state.freedSinceProbe >= INODE_RELIEF_PROBE_INTERVAL)) {
+        if (probe(state)) {
+            return state.available >= state.target;
+        }
+    }
+
+    return estimated >= state.target;
+}
+
+}
@@ -0,0 +1,42 @@
+#include "io_throttle.h"
+#include <thread>
+
+namespace CClean {
+
+IoThrottle::IoThrottle(size_t bytesPerSecond)
+    : bytesPerSecond_(bytesPerSecond)
+    , nextAvailable_(std::chrono::steady_clock::now()) {
+}
+
+void IoThrottle::acquire(size_t bytes) {
+    std::chrono::steady_clock::time_point start;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (bytesPerSecond_ == 0) {
+            return;
+        }
+
+        // Idle time doesn't bank credit beyond the present moment
+        auto now = std::chrono::steady_clock::now();
+        start = nextAvailable_ > now ? nextAvailable_ : now;
+
+        auto cost = std::chrono::duration<double>(static_cast<double>(bytes) / bytesPerSecond_);
+        nextAvailable_ = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(cost);
+    }
+
+    std::this_thread::sleep_until(start);
+}
+
+void IoThrottle::setRate(size_t bytesPerSecond) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    bytesPerSecond_ = bytesPerSecond;
+    nextAvailable_ = std::chrono::steady_clock::now();
+}
+
+size_t IoThrottle::rate() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return bytesPerSecond_;
+}
+
+}
@@ -0,0 +1,180 @@
+#include "io_watchdog.h"
+#include "logger.h"
+#include <algorithm>
+#include <sstream>
+
+namespace CClean {
+
+IoWatchdog::Scope::Scope(const char* operation, const std::string& path)
+    : id_(IoWatchdog::getInstance().enter(operation, path))
+    , lastProgress_(std::chrono::steady_clock::now()) {
+}
+
+void IoWatchdog::Scope::progress() {
+    if (id_ == 0) {
+        return;
+    }
+    // Only take the watchdog's lock about once a second
+    auto now = std::chrono::steady_clock::now();
+    if (now - lastProgress_ >= std::chrono::seconds(1)) {
+        lastProgress_ = now;
+        IoWatchdog::getInstance().restart(id_, now);
+    }
+}
+
+IoWatchdog::Scope::~Scope() {
+    if (id_ != 0) {
+        IoWatchdog::getInstance().leave(id_);
+    }
+}
+
+IoWatchdog& IoWatchdog::getInstance() {
+    static IoWatchdog instance;
+    return instance;
+}
+
+IoWatchdog::IoWatchdog()
+    : timeout_(IO_WATCHDOG_TIMEOUT_SECONDS * 1000)
+    , active_(false)
+    , skippedCount_(0)
+    , stopping_(false)
+    , nextId_(1) {
+}
+
+IoWatchdog::~IoWatchdog() {
+    stop();
+}
+
+void IoWatchdog::start(std::chrono::milliseconds timeout) {
+    stop();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    timeout_ = timeout;
+    stopping_ = false;
+    skipped_.clear();
+    stuck_.clear();
+    skippedCount_ = 0;
+    active_ = true;
+    watcher_ = std::thread(&IoWatchdog::watchLoop, this);
+}
+
+void IoWatchdog::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!active_) {
+            return;
+        }
+        stopping_ = true;
+        active_ = false;
+    }
+    stopRequested_.notify_all();
+
+    if (watcher_.joinable()) {
+        watcher_.join();
+    }
+}
+
+bool IoWatchdog::isSkipped(const std::string& path) const {
+    if (skippedCount_.load(std::memory_order_acquire) == 0) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& skipped : skipped_) {
+        if (path.compare(0, skipped.size(), skipped) == 0 &&
+            (path.size() == skipped.size() || path[skipped.size()] == '/' || path[skipped.size()] == '\\')) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<IoWatchdog::StuckOperation> IoWatchdog::stuckOperations() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stuck_;
+}
+
+uint64_t IoWatchdog::enter(const char* operation, const std::string& path) {
+    if (!active_.load(std::memory_order_relaxed)) {
+        return 0;
+    }
+
+    InFlight entry;
+    entry.operation = operation;
+    entry.path = path;
+    entry.started = std::chrono::steady_clock::now();
+    entry.worker = ThreadPool::currentWorker();
+    entry.taskId = ThreadPool::currentTaskId();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint64_t id = nextId_++;
+    inFlight_.emplace(id, std::move(entry));
+    return id;
+}
+
+void IoWatchdog::leave(uint64_t id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    inFlight_.erase(id);
+}
+
+void IoWatchdog::restart(uint64_t id, std::chrono::steady_clock::time_point now) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = inFlight_.find(id);
+    if (it != inFlight_.end() && !it->second.reported) {
+        it->second.started = now;
+    }
+}
+
+void IoWatchdog::watchLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto interval = std::max(timeout_ / 4, std::chrono::milliseconds(10));
+
+    while (!stopRequested_.wait_for(lock, interval, [this] { return stopping_; })) {
+        auto now = std::chrono::steady_clock::now();
+        std::vector<std::pair<std::shared_ptr<ThreadPool::Worker>, uint64_t>> abandoned;
+        std::vector<std::string> messages;
+
+        for (auto& entry : inFlight_) {
+            InFlight& operation = entry.second;
+            if (operation.reported || now - operation.started < timeout_) {
+                continue;
+            }
+            operation.reported = true;
+
+            StuckOperation stuck;
+            stuck.operation = operation.operation;
+            stuck.path = operation.path;
+            stuck.seconds = std::chrono::duration<double>(now - operation.started).count();
+            stuck_.push_back(stuck);
+            skipped_.push_back(operation.path);
+            skippedCount_.store(skipped_.size(), std::memory_order_release);
+
+            std::ostringstream ss;
+            ss.precision(1);
+            ss << std::fixed << "I/O stuck for " << stuck.seconds << "s (" << stuck.operation << " "
+               << stuck.path << "); skipping it";
+            messages.push_back(ss.str());
+
+            if (operation.worker) {
+                abandoned.emplace_back(operation.worker, operation.taskId);
+            }
+        }
+
+        if (messages.empty()) {
+            continue;
+        }
+
+        // The pool and logger take their own locks
+        lock.unlock();
+        // The pool only acts if the worker is still in the stuck task
+        for (const auto& worker : abandoned) {
+            ThreadPool::abandon(worker.first, worker.second);
+        }
+        for (const auto& message : messages) {
+            Logger::getInstance().warning(message);
+        }
+        lock.lock();
+    }
+}
+
+}
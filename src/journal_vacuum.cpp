@@ -0,0 +1,232 @@
+#include "journal_vacuum.h"
+#include "logger.h"
+#include "utils.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace CClean {
+
+namespace {
+
+// Layout of the systemd journal file header (src/libsystemd/sd-journal/journal-def.h)
+const char JOURNAL_SIGNATURE[8] = { 'L', 'P', 'K', 'S', 'H', 'H', 'R', 'H' };
+const size_t HEADER_STATE_OFFSET = 16;
+const size_t HEADER_HEAD_REALTIME_OFFSET = 184;
+const size_t HEADER_TAIL_REALTIME_OFFSET = 192;
+const size_t HEADER_MINIMUM_SIZE = 208;         // every field up to tail_entry_monotonic
+
+const uint8_t JOURNAL_STATE_ARCHIVED = 2;
+
+uint64_t readLittleEndian64(const unsigned char* p) {
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; --i) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+bool endsWith(const std::string& text, const std::string& suffix) {
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+}
+
+JournalVacuum::JournalVacuum()
+    : maximumAgeDays_(JOURNAL_MAX_AGE_DAYS)
+    , maximumSize_(0)
+    , dryRun_(false)
+    , verbose_(false) {
+}
+
+void JournalVacuum::setMaximumAgeDays(int days) {
+    maximumAgeDays_ = days;
+}
+
+void JournalVacuum::setMaximumSize(size_t bytes) {
+    maximumSize_ = bytes;
+}
+
+void JournalVacuum::setFileFilter(FileFilter filter) {
+    filter_ = std::move(filter);
+}
+
+void JournalVacuum::setDryRun(bool enabled) {
+    dryRun_ = enabled;
+}
+
+void JournalVacuum::setVerbose(bool enabled) {
+    verbose_ = enabled;
+}
+
+std::vector<std::string> JournalVacuum::defaultRoots() {
+#ifdef __linux__
+    return { "/var/log/journal", "/run/log/journal" };
+#else
+    return {};
+#endif
+}
+
+bool JournalVacuum::readHeader(const std::string& filePath, JournalHeader& header, uint64_t& diskSize,
+                               std::string& error) {
+    unsigned char buffer[HEADER_MINIMUM_SIZE];
+
+#ifdef __linux__
+    int fd = ::open(filePath.c_str(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+    if (fd < 0) {
+        error = "Cannot open " + filePath + ": " + std::strerror(errno);
+        return false;
+    }
+
+    struct stat st;
+    ssize_t bytesRead = -1;
+    if (::fstat(fd, &st) == 0) {
+        // journald preallocates, so the allocation is what the file costs
+        diskSize = static_cast<uint64_t>(st.st_blocks) * 512;
+        bytesRead = ::pread(fd, buffer, sizeof(buffer), 0);
+    }
+    int savedErrno = errno;
+    ::close(fd);
+
+    if (bytesRead < 0) {
+        error = "Cannot read " + filePath + ": " + std::strerror(savedErrno);
+        return false;
+    }
+    size_t available = static_cast<size_t>(bytesRead);
+#else
+    std::ifstream in(filePath, std::ios::binary);
+    if (!in) {
+        error = "Cannot open " + filePath + ": " + Utils::getLastError();
+        return false;
+    }
+    in.read(reinterpret_cast<char*>(buffer), sizeof(buffer));
+    size_t available = static_cast<size_t>(in.gcount());
+    diskSize = Utils::getFileSize(filePath);
+#endif
+
+    if (available < HEADER_MINIMUM_SIZE || std::memcmp(buffer, JOURNAL_SIGNATURE, sizeof(JOURNAL_SIGNATURE)) != 0) {
+        error = "Not a journal file: " + filePath;
+        return false;
+    }
+
+    header.state = buffer[HEADER_STATE_OFFSET];
+    header.headRealtime = readLittleEndian64(buffer + HEADER_HEAD_REALTIME_OFFSET);
+    header.tailRealtime = readLittleEndian64(buffer + HEADER_TAIL_REALTIME_OFFSET);
+    return true;
+}
+
+CleanupResult JournalVacuum::process(const std::vector<std::string>& rootPaths, bool cleanMode) {
+    CleanupResult result;
+
+    for (const auto& rootPath : rootPaths) {
+        if (!Utils::pathExists(rootPath)) {
+            continue;
+        }
+
+        // Persistent journals live in one directory per machine id, volatile
+        // ones may sit directly in the root
+        vacuumDirectory(rootPath, cleanMode, result);
+
+        std::error_code ec;
+        for (fs::directory_iterator it(rootPath, ec); !ec && it != fs::directory_iterator(); it.increment(ec)) {
+            std::error_code typeEc;
+            if (it->is_directory(typeEc) && !it->is_symlink(typeEc)) {
+                vacuumDirectory(it->path().string(), cleanMode, result);
+            }
+        }
+    }
+
+    return result;
+}
+
+void JournalVacuum::vacuumDirectory(const std::string& directory, bool cleanMode, CleanupResult& result) {
+    Logger& logger = Logger::getInstance();
+    std::vector<JournalFile> files;
+    uint64_t totalSize = 0;
+
+    std::error_code ec;
+    for (fs::directory_iterator it(directory, ec); !ec && it != fs::directory_iterator(); it.increment(ec)) {
+        std::string name = it->path().filename().string();
+        bool dirty = endsWith(name, ".journal~");
+        if (!dirty && !endsWith(name, ".journal")) {
+            continue;
+        }
+
+        JournalFile file;
+        file.path = it->path().string();
+        std::string error;
+        if (!readHeader(file.path, file.header, file.diskSize, error)) {
+            if (verbose_) {
+                logger.debug(error);
+            }
+            continue;
+        }
+        totalSize += file.diskSize;
+
+        // Rotated files carry '@' in their name; "~" marks one journald set
+        // aside after an unclean shutdown, which is never written again
+        file.archived = name.find('@') != std::string::npos &&
+                        (dirty || file.header.state == JOURNAL_STATE_ARCHIVED);
+        if (file.archived) {
+            files.push_back(std::move(file));
+        }
+    }
+
+    if (files.empty()) {
+        return;
+    }
+
+    std::sort(files.begin(), files.end(), [](const JournalFile& a, const JournalFile& b) {
+        return a.header.headRealtime < b.header.headRealtime;
+    });
+
+    uint64_t now = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+    uint64_t maximumAge = maximumAgeDays_ > 0 ? static_cast<uint64_t>(maximumAgeDays_) * 24 * 3600 * 1000000 : 0;
+    bool remove = cleanMode && !dryRun_;
+
+    for (const auto& file : files) {
+        uint64_t newest = std::max(file.header.tailRealtime, file.header.headRealtime);
+        bool expired = maximumAge > 0 && newest + maximumAge < now;
+        bool overCap = maximumSize_ > 0 && totalSize > maximumSize_;
+        if (!expired && !overCap) {
+            continue;
+        }
+
+        if (filter_ && !filter_(file.path)) {
+            continue;
+        }
+
+        result.filesScanned++;
+        if (remove && !Utils::deleteFileSecure(file.path)) {
+            std::string error = "Failed to delete " + file.path + ": " + Utils::getLastError();
+            logger.warning(error);
+            if (result.errorMessage.empty()) {
+                result.errorMessage = error;
+            }
+            continue;
+        }
+
+        totalSize -= file.diskSize;
+        result.bytesFreed += file.diskSize;
+        if (cleanMode) {
+            result.filesDeleted++;
+        }
+        if (verbose_) {
+            logger.debug(std::string(remove ? "Deleted" : "Would delete") + " journal: " + file.path + " (" +
+                         Utils::formatBytes(file.diskSize) + (expired ? ", expired)" : ", over size cap)"));
+        }
+    }
+}
+
+}
@@ -0,0 +1,470 @@
+#include "keep_list.h"
+#include "logger.h"
+#include "thread_pool.h"
+#include "utils.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <sstream>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace CClean {
+
+namespace {
+
+const char INDEX_MAGIC[8] = { 'C', 'C', 'K', 'E', 'E', 'P', '0', '2' };
+const uint32_t MAX_BUCKET_BITS = 32;
+const uint32_t MAX_PARTITION_BITS = 8;
+const size_t BUILD_CHUNK_SIZE = 4 * 1024 * 1024;
+const uint32_t PREFIX_SHIFT = 48;
+const uint64_t OFFSET_MASK = (1ULL << PREFIX_SHIFT) - 1;
+const size_t MAX_PREFIX_LENGTH = 0xFFFF;
+
+bool isSeparator(char c) {
+    return c == '/' || c == '\\';
+}
+
+// Lines may come from Windows tools and paths may carry a trailing slash;
+// neither should change whether they match
+size_t normalizedLength(const char* path, size_t length) {
+    if (length > 0 && path[length - 1] == '\r') {
+        length--;
+    }
+    while (length > 1 && isSeparator(path[length - 1])) {
+        length--;
+    }
+    return length;
+}
+
+uint64_t hashPath(const char* path, size_t length) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= static_cast<unsigned char>(path[i]);
+        hash *= 1099511628211ULL;
+    }
+
+    // FNV alone leaves the high bits, which pick the bucket, poorly mixed
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+template <typename Callback>
+void forEachLine(const char* data, size_t begin, size_t end, Callback callback) {
+    while (begin < end) {
+        const char* newline = static_cast<const char*>(std::memchr(data + begin, '\n', end - begin));
+        size_t lineEnd = newline ? static_cast<size_t>(newline - data) : end;
+
+        size_t length = normalizedLength(data + begin, lineEnd - begin);
+        if (length > 0) {
+            callback(begin, length);
+        }
+        begin = lineEnd + 1;
+    }
+}
+
+// Each line yields its own entry (prefix length 0) plus one per directory
+// above it. Directories shared with the previous line are skipped, so a
+// sorted list adds little more than its distinct directories.
+template <typename Callback>
+void forEachEntry(const char* data, size_t begin, size_t end, Callback callback) {
+    size_t previousOffset = 0;
+    size_t previousLength = 0;
+
+    forEachLine(data, begin, end, [&](size_t offset, size_t length) {
+        callback(offset, length, 0);
+
+        const char* line = data + offset;
+        size_t common = 0;
+        while (common < length && common < previousLength && line[common] == data[previousOffset + common]) {
+            common++;
+        }
+
+        for (size_t i = common; i < length; ++i) {
+            if (!isSeparator(line[i]) || (i > 0 && isSeparator(line[i - 1]))) {
+                continue;
+            }
+            size_t prefixLength = normalizedLength(line, i == 0 ? 1 : i);
+            if (prefixLength <= MAX_PREFIX_LENGTH) {
+                callback(offset, prefixLength, prefixLength);
+            }
+        }
+
+        previousOffset = offset;
+        previousLength = length;
+    });
+}
+
+bool listFingerprint(const std::string& listPath, uint64_t& size, int64_t& modified) {
+    std::error_code ec;
+    size = static_cast<uint64_t>(fs::file_size(listPath, ec));
+    if (ec) {
+        return false;
+    }
+    modified = static_cast<int64_t>(fs::last_write_time(listPath, ec).time_since_epoch().count());
+    return !ec;
+}
+
+}
+
+KeepList::KeepList()
+    : header_(nullptr)
+    , buckets_(nullptr)
+    , entries_(nullptr) {
+}
+
+bool KeepList::isLoaded() const {
+    return header_ != nullptr;
+}
+
+size_t KeepList::size() const {
+    return header_ ? static_cast<size_t>(header_->pathCount) : 0;
+}
+
+std::string KeepList::indexPathFor(const std::string& listPath) {
+    return listPath + ".idx";
+}
+
+bool KeepList::load(const std::string& listPath, std::string& error) {
+    uint64_t sourceSize = 0;
+    int64_t sourceModified = 0;
+    if (!listFingerprint(listPath, sourceSize, sourceModified)) {
+        error = "Cannot read keep-list " + listPath;
+        return false;
+    }
+
+    if (!list_.open(listPath, error)) {
+        return false;
+    }
+    list_.adviseRandom();
+
+    // Next to the list if possible, otherwise in our own cache directory,
+    // which other users cannot write to
+    std::error_code ec;
+    std::string absoluteList = fs::absolute(listPath, ec).string();
+    std::ostringstream fallbackName;
+    fallbackName << "keep-" << std::hex << hashPath(absoluteList.data(), absoluteList.size()) << ".idx";
+    fs::path cacheDirectory = Utils::getCacheDirectory();
+    fs::create_directories(cacheDirectory, ec);
+    fs::permissions(cacheDirectory, fs::perms::owner_all, ec);
+    std::vector<std::string> indexPaths = { indexPathFor(listPath),
+                                            (cacheDirectory / fallbackName.str()).string() };
+
+    for (const auto& indexPath : indexPaths) {
+        if (mapIndex(indexPath, sourceSize, sourceModified)) {
+            return true;
+        }
+    }
+
+    for (const auto& indexPath : indexPaths) {
+        auto start = std::chrono::steady_clock::now();
+        std::string buildError;
+
+        if (buildIndex(listPath, indexPath, 0, buildError) && mapIndex(indexPath, sourceSize, sourceModified)) {
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::ostringstream ss;
+            ss.precision(2);
+            ss << std::fixed << "Indexed " << size() << " keep-list paths into " << indexPath
+               << " in " << seconds << "s";
+            Logger::getInstance().info(ss.str());
+            return true;
+        }
+
+        if (error.empty()) {
+            error = buildError;
+        }
+    }
+
+    if (error.empty()) {
+        error = "Keep-list changed while it was being indexed: " + listPath;
+    }
+    return false;
+}
+
+bool KeepList::mapIndex(const std::string& indexPath, uint64_t sourceSize, int64_t sourceModified) {
+    header_ = nullptr;
+
+#ifndef _WIN32
+    // An index planted by another user could hide listed paths
+    struct stat st;
+    if (lstat(indexPath.c_str(), &st) != 0 || !S_ISREG(st.st_mode) || st.st_uid != geteuid()) {
+        return false;
+    }
+#endif
+
+    std::string error;
+    if (!index_.open(indexPath, error) || index_.size() < sizeof(IndexHeader)) {
+        index_.close();
+        return false;
+    }
+
+    const IndexHeader* header = reinterpret_cast<const IndexHeader*>(index_.data());
+    bool valid = std::memcmp(header->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) == 0 &&
+                 header->sourceSize == sourceSize && header->sourceModified == sourceModified &&
+                 header->bucketBits >= 1 && header->bucketBits <= MAX_BUCKET_BITS;
+
+    uint64_t bucketCount = valid ? (1ULL << header->bucketBits) + 1 : 0;
+    valid = valid && index_.size() == sizeof(IndexHeader) + bucketCount * sizeof(uint64_t) +
+                                      header->entryCount * sizeof(IndexEntry);
+    if (!valid) {
+        index_.close();
+        return false;
+    }
+
+    index_.adviseRandom();
+    header_ = header;
+    buckets_ = reinterpret_cast<const uint64_t*>(index_.data() + sizeof(IndexHeader));
+    entries_ = reinterpret_cast<const IndexEntry*>(buckets_ + bucketCount);
+    return true;
+}
+
+bool KeepList::buildIndex(const std::string& listPath, const std::string& indexPath,
+                          size_t threadCount, std::string& error) {
+    IndexHeader header = {};
+    std::memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    if (!listFingerprint(listPath, header.sourceSize, header.sourceModified)) {
+        error = "Cannot read keep-list " + listPath;
+        return false;
+    }
+
+    MappedFile list;
+    if (!list.open(listPath, error)) {
+        return false;
+    }
+    const char* data = list.data();
+    size_t size = list.size();
+
+    // Chunks end on line boundaries so each worker owns whole lines
+    std::vector<size_t> bounds = { 0 };
+    while (bounds.back() < size) {
+        size_t end = std::min(size, bounds.back() + BUILD_CHUNK_SIZE);
+        if (end < size) {
+            const char* newline = static_cast<const char*>(std::memchr(data + end, '\n', size - end));
+            end = newline ? static_cast<size_t>(newline - data) + 1 : size;
+        }
+        bounds.push_back(end);
+    }
+    size_t chunkCount = bounds.size() - 1;
+
+    ThreadPool pool(threadCount);
+
+    std::vector<size_t> lineCounts(chunkCount, 0);
+    std::vector<size_t> entryCounts(chunkCount, 0);
+    for (size_t chunk = 0; chunk < chunkCount; ++chunk) {
+        pool.submit([&, chunk] {
+            forEachEntry(data, bounds[chunk], bounds[chunk + 1], [&](size_t, size_t, size_t prefixLength) {
+                entryCounts[chunk]++;
+                if (prefixLength == 0) {
+                    lineCounts[chunk]++;
+                }
+            });
+        });
+    }
+    pool.wait();
+
+    uint64_t total = 0;
+    for (size_t chunk = 0; chunk < chunkCount; ++chunk) {
+        total += entryCounts[chunk];
+        header.pathCount += lineCounts[chunk];
+    }
+
+    // About four entries per bucket
+    header.entryCount = total;
+    header.bucketBits = 1;
+    while (header.bucketBits < MAX_BUCKET_BITS && (1ULL << header.bucketBits) * 4 < total) {
+        header.bucketBits++;
+    }
+    uint32_t partitionBits = std::min(header.bucketBits, MAX_PARTITION_BITS);
+    size_t partitionCount = size_t(1) << partitionBits;
+
+    // Hash each chunk straight into per-partition runs...
+    std::vector<std::vector<std::vector<IndexEntry>>> runs(chunkCount, std::vector<std::vector<IndexEntry>>(partitionCount));
+    for (size_t chunk = 0; chunk < chunkCount; ++chunk) {
+        pool.submit([&, chunk] {
+            auto& chunkRuns = runs[chunk];
+            for (auto& run : chunkRuns) {
+                run.reserve(entryCounts[chunk] / partitionCount + 16);
+            }
+            forEachEntry(data, bounds[chunk], bounds[chunk + 1], [&](size_t offset, size_t length, size_t prefixLength) {
+                uint64_t hash = hashPath(data + offset, length);
+                uint64_t tagged = offset | (static_cast<uint64_t>(prefixLength) << PREFIX_SHIFT);
+                chunkRuns[hash >> (64 - partitionBits)].push_back({ hash, tagged });
+            });
+        });
+    }
+    pool.wait();
+
+    std::vector<size_t> partitionStart(partitionCount + 1, 0);
+    for (size_t partition = 0; partition < partitionCount; ++partition) {
+        size_t partitionSize = 0;
+        for (size_t chunk = 0; chunk < chunkCount; ++chunk) {
+            partitionSize += runs[chunk][partition].size();
+        }
+        partitionStart[partition + 1] = partitionStart[partition] + partitionSize;
+    }
+
+    // ...then gather, sort and bucket each partition independently
+    std::vector<IndexEntry> entries(static_cast<size_t>(total));
+    std::vector<uint64_t> buckets((size_t(1) << header.bucketBits) + 1, total);
+    uint32_t bucketShift = 64 - header.bucketBits;
+    size_t bucketsPerPartition = size_t(1) << (header.bucketBits - partitionBits);
+
+    for (size_t partition = 0; partition < partitionCount; ++partition) {
+        pool.submit([&, partition] {
+            IndexEntry* out = entries.data() + partitionStart[partition];
+            for (size_t chunk = 0; chunk < chunkCount; ++chunk) {
+                auto& run = runs[chunk][partition];
+                out = std::copy(run.begin(), run.end(), out);
+                std::vector<IndexEntry>().swap(run);
+            }
+
+            IndexEntry* begin = entries.data() + partitionStart[partition];
+            IndexEntry* end = entries.data() + partitionStart[partition + 1];
+            std::sort(begin, end, [](const IndexEntry& a, const IndexEntry& b) { return a.hash < b.hash; });
+
+            IndexEntry* cursor = begin;
+            for (size_t i = 0; i < bucketsPerPartition; ++i) {
+                uint64_t bucket = partition * bucketsPerPartition + i;
+                while (cursor < end && (cursor->hash >> bucketShift) < bucket) {
+                    cursor++;
+                }
+                buckets[bucket] = static_cast<uint64_t>(cursor - entries.data());
+            }
+        });
+    }
+    pool.wait();
+
+#ifdef _WIN32
+    std::string temporaryPath = indexPath + ".tmp";
+    std::FILE* file = std::fopen(temporaryPath.c_str(), "wb");
+#else
+    // A fresh, exclusively created name: never follows a planted symlink
+    std::string temporaryPath = indexPath + ".XXXXXX";
+    int fd = mkstemp(&temporaryPath[0]);
+    std::FILE* file = fd >= 0 ? fdopen(fd, "wb") : nullptr;
+    if (fd >= 0 && !file) {
+        close(fd);
+        unlink(temporaryPath.c_str());
+    }
+#endif
+    if (!file) {
+        error = "Cannot create keep-list index " + temporaryPath + ": " + Utils::getLastError();
+        return false;
+    }
+
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+              std::fwrite(buckets.data(), sizeof(uint64_t), buckets.size(), file) == buckets.size() &&
+              std::fwrite(entries.data(), sizeof(IndexEntry), entries.size(), file) == entries.size();
+    ok = std::fclose(file) == 0 && ok;
+
+    std::error_code ec;
+    if (ok) {
+        fs::rename(temporaryPath, indexPath, ec);
+    }
+    if (!ok || ec) {
+        error = "Cannot write keep-list index " + indexPath;
+        fs::remove(temporaryPath, ec);
+        return false;
+    }
+    return true;
+}
+
+bool KeepList::containsExact(const char* path, size_t length) const {
+    uint64_t hash = hashPath(path, length);
+    uint64_t bucket = hash >> (64 - header_->bucketBits);
+
+    for (uint64_t i = buckets_[bucket]; i < buckets_[bucket + 1]; ++i) {
+        const IndexEntry& entry = entries_[i];
+        if (entry.hash > hash) {
+            break;
+        }
+        if (entry.hash != hash || entry.offset >= list_.size()) {
+            continue;
+        }
+
+        // Ancestor entries have offsets past any list because of their tag
+        const char* line = list_.data() + entry.offset;
+        size_t available = list_.size() - static_cast<size_t>(entry.offset);
+        const char* newline = static_cast<const char*>(std::memchr(line, '\n', available));
+        size_t lineLength = normalizedLength(line, newline ? static_cast<size_t>(newline - line) : available);
+
+        if (lineLength == length && std::memcmp(line, path, length) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool KeepList::contains(const std::string& path) const {
+    if (!header_ || header_->entryCount == 0) {
+        return false;
+    }
+
+    size_t length = normalizedLength(path.data(), path.size());
+    if (containsExact(path.data(), length)) {
+        return true;
+    }
+
+    // Listing a directory keeps everything below it
+    while (length > 1) {
+        size_t separator = length - 1;
+        while (separator > 0 && !isSeparator(path[separator])) {
+            separator--;
+        }
+        if (!isSeparator(path[separator])) {
+            break;
+        }
+
+        length = normalizedLength(path.data(), separator == 0 ? 1 : separator);
+        if (containsExact(path.data(), length)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool KeepList::containsBelow(const std::string& directory) const {
+    if (!header_ || header_->entryCount == 0) {
+        return false;
+    }
+
+    // Never indexed; claiming a listed path below is the safe answer
+    size_t length = normalizedLength(directory.data(), directory.size());
+    if (length > MAX_PREFIX_LENGTH) {
+        return true;
+    }
+
+    uint64_t hash = hashPath(directory.data(), length);
+    uint64_t bucket = hash >> (64 - header_->bucketBits);
+
+    for (uint64_t i = buckets_[bucket]; i < buckets_[bucket + 1]; ++i) {
+        const IndexEntry& entry = entries_[i];
+        if (entry.hash > hash) {
+            break;
+        }
+        size_t offset = static_cast<size_t>(entry.offset & OFFSET_MASK);
+        if (entry.hash != hash || (entry.offset >> PREFIX_SHIFT) != length || offset >= list_.size()) {
+            continue;
+        }
+
+        // The line runs on past its ancestor, so only the prefix is compared
+        if (list_.size() - offset > length && std::memcmp(list_.data() + offset, directory.data(), length) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+}
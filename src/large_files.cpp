@@ -0,0 +1,453 @@
+#include "large_files.h"
+#include "io_watchdog.h"
+#include "logger.h"
+#include "pressure_monitor.h"
+#include "utils.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+
+namespace fs = std::filesystem;
+
+namespace CClean {
+
+namespace {
+
+const char LARGE_FILE_SUMMARY_MAGIC[8] = { 'C', 'C', 'L', 'A', 'R', 'G', '0', '1' };
+
+struct SummaryHeader {
+    char magic[8];
+    uint64_t recordCount;
+};
+
+// Followed by pathLength bytes of path
+struct SummaryEntry {
+    int64_t modified;
+    int64_t checked;
+    uint64_t largestFile;
+    uint64_t largestInSubtree;
+    uint32_t pathLength;
+    uint32_t reserved;
+};
+
+int64_t secondsNow() {
+    return std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+std::string normalizeRoot(const std::string& path) {
+    std::error_code ec;
+    fs::path absolute = fs::absolute(Utils::expandEnvironmentVariables(path), ec);
+    fs::path normal = (ec ? fs::path(path) : absolute).lexically_normal();
+    // "/usr/" names the same directory as "/usr", but "/" stays "/"
+    if (!normal.has_filename() && normal != normal.root_path()) {
+        normal = normal.parent_path();
+    }
+    return normal.string();
+}
+
+std::string parentOf(const std::string& path) {
+    return fs::path(path).parent_path().string();
+}
+
+bool isUnder(const std::string& path, const std::string& root) {
+    if (path.compare(0, root.size(), root) != 0) {
+        return false;
+    }
+    if (path.size() == root.size()) {
+        return true;
+    }
+    char last = root.back();
+    char next = path[root.size()];
+    return last == '/' || last == '\\' || next == '/' || next == '\\';
+}
+
+}
+
+struct LargeFileFinder::WalkState {
+    size_t minimumSize = 0;
+    FileFilter filter;
+    FoundCallback found;
+    bool verbose = false;
+    int64_t now = 0;
+    int64_t maxAgeSeconds = 0;
+
+    // The summary as loaded, read-only during the walk
+    Summary previous;
+    std::unordered_map<std::string, std::vector<std::string>> children;
+
+    std::mutex mutex;
+    Summary current;
+    std::vector<LargeFile> files;
+
+    std::atomic<size_t> listed{0};
+    std::atomic<size_t> reused{0};
+    std::atomic<size_t> skipped{0};
+};
+
+LargeFileFinder::LargeFileFinder(size_t threadCount)
+    : threadCount_(threadCount)
+    , minimumSize_(LARGE_FILE_MIN_SIZE)
+    , verbose_(false)
+    , summaryChanged_(false)
+    , directoriesListed_(0)
+    , directoriesReused_(0)
+    , subtreesSkipped_(0) {
+}
+
+LargeFileFinder::~LargeFileFinder() = default;
+
+void LargeFileFinder::setMinimumSize(size_t bytes) {
+    minimumSize_ = bytes;
+}
+
+void LargeFileFinder::setFileFilter(FileFilter filter) {
+    filter_ = std::move(filter);
+}
+
+void LargeFileFinder::setVerbose(bool enabled) {
+    verbose_ = enabled;
+}
+
+std::string LargeFileFinder::defaultSummaryPath() {
+    return (fs::path(Utils::getCacheDirectory()) / LARGE_FILE_SUMMARY_FILE).string();
+}
+
+std::vector<LargeFile> LargeFileFinder::find(const std::vector<std::string>& rootPaths, const FoundCallback& found) {
+    auto state = std::make_shared<WalkState>();
+    state->minimumSize = minimumSize_;
+    state->filter = filter_;
+    state->found = found;
+    state->verbose = verbose_;
+    state->now = secondsNow();
+    state->maxAgeSeconds = static_cast<int64_t>(LARGE_FILE_SUMMARY_MAX_AGE_DAYS) * 24 * 60 * 60;
+    state->previous = summary_;
+    for (const auto& record : state->previous) {
+        std::string parent = parentOf(record.first);
+        if (parent != record.first) {
+            state->children[parent].push_back(record.first);
+        }
+    }
+
+    std::vector<std::string> roots;
+    for (const auto& rootPath : rootPaths) {
+        std::string root = normalizeRoot(rootPath);
+        Utils::FileIdentity identity;
+        if (!Utils::getFileIdentity(root, identity)) {
+            Logger::getInstance().warning("Cannot read " + root + ": " + Utils::getLastError());
+            continue;
+        }
+        roots.push_back(root);
+    }
+
+    {
+        ThreadPool pool(threadCount_);
+        ThreadPool::Submitter submit = pool.submitter();
+        for (const auto& root : roots) {
+            Utils::FileIdentity identity;
+            Utils::getFileIdentity(root, identity);
+            uint64_t device = identity.device;
+            submit([root, device, state, submit] { walkDirectory(root, device, state, submit); });
+        }
+        pool.wait();
+    }
+
+    directoriesListed_ = state->listed;
+    directoriesReused_ = state->reused;
+    subtreesSkipped_ = state->skipped;
+
+    std::lock_guard<std::mutex> lock(state->mutex);
+
+    // What was walked replaces what the summary knew below the roots
+    if (!roots.empty()) {
+        for (auto it = summary_.begin(); it != summary_.end();) {
+            bool walked = std::any_of(roots.begin(), roots.end(),
+                                      [&it](const std::string& root) { return isUnder(it->first, root); });
+            it = walked ? summary_.erase(it) : std::next(it);
+        }
+        for (const auto& record : state->current) {
+            summary_[record.first] = record.second;
+        }
+        updateSubtreeMaxima();
+        summaryChanged_ = true;
+    }
+
+    std::vector<LargeFile> files = state->files;
+    std::sort(files.begin(), files.end(), [](const LargeFile& a, const LargeFile& b) {
+        return a.size != b.size ? a.size > b.size : a.path < b.path;
+    });
+    return files;
+}
+
+void LargeFileFinder::walkDirectory(const std::string& directory, uint64_t device,
+                                    const std::shared_ptr<WalkState>& state, const ThreadPool::Submitter& submit) {
+    IoWatchdog& watchdog = IoWatchdog::getInstance();
+    if (watchdog.isSkipped(directory)) {
+        return;
+    }
+    PressureMonitor::getInstance().pace();
+
+    // Other filesystems mounted below the root are not walked
+    Utils::FileIdentity identity;
+    if (!Utils::getFileIdentity(directory, identity) || identity.device != device) {
+        return;
+    }
+
+    const DirectoryRecord* cached = nullptr;
+    auto it = state->previous.find(directory);
+    if (it != state->previous.end() && it->second.modified == identity.modified &&
+        state->now - it->second.checked < state->maxAgeSeconds) {
+        cached = &it->second;
+    }
+
+    if (cached && cached->largestInSubtree < state->minimumSize) {
+        state->skipped++;
+        skipSubtree(directory, device, state, submit);
+        return;
+    }
+
+    DirectoryRecord record;
+    record.modified = identity.modified;
+    std::vector<std::string> subdirectories;
+    std::vector<LargeFile> found;
+
+    if (cached && cached->largestFile < state->minimumSize) {
+        // Nothing here qualified and nothing was added since: only the
+        // subdirectories need a look
+        state->reused++;
+        record.checked = cached->checked;
+        record.largestFile = cached->largestFile;
+        auto children = state->children.find(directory);
+        if (children != state->children.end()) {
+            subdirectories = children->second;
+        }
+    } else {
+        state->listed++;
+        record.checked = state->now;
+
+        IoWatchdog::Scope scope("readdir", directory);
+        std::error_code ec;
+        for (fs::directory_iterator entry(directory, ec), end; !ec && entry != end; entry.increment(ec)) {
+            scope.progress();
+            std::error_code statEc;
+            if (entry->is_symlink(statEc)) {
+                continue;
+            }
+            if (entry->is_directory(statEc)) {
+                subdirectories.push_back(entry->path().string());
+                continue;
+            }
+            if (!entry->is_regular_file(statEc)) {
+                continue;
+            }
+
+            uintmax_t size = entry->file_size(statEc);
+            if (statEc) {
+                continue;
+            }
+            record.largestFile = std::max<uint64_t>(record.largestFile, size);
+            if (size >= state->minimumSize) {
+                LargeFile file;
+                file.path = entry->path().string();
+                file.size = static_cast<size_t>(size);
+                found.push_back(std::move(file));
+            }
+        }
+    }
+    record.largestInSubtree = record.largestFile;
+
+    // Exclusions only hide files from the results; the summary still
+    // records them, since a keep-list can change between runs
+    if (state->filter) {
+        found.erase(std::remove_if(found.begin(), found.end(),
+                                   [&state](const LargeFile& file) { return !state->filter(file.path); }),
+                    found.end());
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->current[directory] = record;
+        state->files.insert(state->files.end(), found.begin(), found.end());
+    }
+
+    if (state->found) {
+        for (const auto& file : found) {
+            state->found(file);
+        }
+    }
+    if (state->verbose) {
+        for (const auto& file : found) {
+            Logger::getInstance().debug("Large file: " + file.path + " (" + Utils::formatBytes(file.size) + ")");
+        }
+    }
+
+    for (auto& subdirectory : subdirectories) {
+        submit([subdirectory, device, state, submit] { walkDirectory(subdirectory, device, state, submit); });
+    }
+}
+
+// Nothing in the subtree qualified last time. Its directories are only
+// stat'ed, here on one thread: while their mtimes match the summary their
+// records are carried over unlisted, and any that changed is walked anew.
+void LargeFileFinder::skipSubtree(const std::string& directory, uint64_t device,
+                                  const std::shared_ptr<WalkState>& state, const ThreadPool::Submitter& submit) {
+    std::vector<std::pair<std::string, DirectoryRecord>> unchanged;
+    std::vector<std::string> pending(1, directory);
+    bool top = true;
+
+    while (!pending.empty()) {
+        std::string current = std::move(pending.back());
+        pending.pop_back();
+
+        auto record = state->previous.find(current);
+        if (record == state->previous.end()) {
+            continue;
+        }
+        if (!top) {
+            PressureMonitor::getInstance().pace();
+            Utils::FileIdentity identity;
+            if (!Utils::getFileIdentity(current, identity) || identity.device != device) {
+                continue;
+            }
+            if (identity.modified != record->second.modified ||
+                state->now - record->second.checked >= state->maxAgeSeconds) {
+                submit([current, device, state, submit] { walkDirectory(current, device, state, submit); });
+                continue;
+            }
+        }
+        top = false;
+        unchanged.emplace_back(current, record->second);
+
+        auto children = state->children.find(current);
+        if (children != state->children.end()) {
+            pending.insert(pending.end(), children->second.begin(), children->second.end());
+        }
+    }
+
+    state->reused += unchanged.size();
+    std::lock_guard<std::mutex> lock(state->mutex);
+    for (auto& record : unchanged) {
+        state->current[record.first] = record.second;
+    }
+}
+
+// Children have longer paths than their parents, so handling the longest
+// paths first sees every subtree complete before its parent
+void LargeFileFinder::updateSubtreeMaxima() {
+    std::vector<std::pair<size_t, Summary::iterator>> byLength;
+    byLength.reserve(summary_.size());
+    for (auto it = summary_.begin(); it != summary_.end(); ++it) {
+        it->second.largestInSubtree = it->second.largestFile;
+        byLength.emplace_back(it->first.size(), it);
+    }
+    std::sort(byLength.begin(), byLength.end(),
+              [](const std::pair<size_t, Summary::iterator>& a, const std::pair<size_t, Summary::iterator>& b) {
+                  return a.first > b.first;
+              });
+
+    for (const auto& entry : byLength) {
+        std::string parent = parentOf(entry.second->first);
+        if (parent == entry.second->first) {
+            continue;
+        }
+        auto it = summary_.find(parent);
+        if (it != summary_.end()) {
+            it->second.largestInSubtree = std::max(it->second.largestInSubtree, entry.second->second.largestInSubtree);
+        }
+    }
+}
+
+bool LargeFileFinder::loadSummary(const std::string& summaryPath, std::string& error) {
+    summaryPath_ = summaryPath;
+    summary_.clear();
+    summaryChanged_ = false;
+
+    std::ifstream in(summaryPath, std::ios::binary);
+    if (!in) {
+        return true;
+    }
+
+    SummaryHeader header;
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, LARGE_FILE_SUMMARY_MAGIC, sizeof(header.magic)) != 0) {
+        // Written by another version; start over rather than fail the run
+        error = "Ignoring unreadable large file summary " + summaryPath;
+        return true;
+    }
+
+    Summary summary;
+    for (uint64_t i = 0; i < header.recordCount; ++i) {
+        SummaryEntry entry;
+        if (!in.read(reinterpret_cast<char*>(&entry), sizeof(entry)) || entry.pathLength > 64 * 1024) {
+            error = "Ignoring truncated large file summary " + summaryPath;
+            return true;
+        }
+        std::string path(entry.pathLength, '\0');
+        if (!in.read(&path[0], entry.pathLength)) {
+            error = "Ignoring truncated large file summary " + summaryPath;
+            return true;
+        }
+
+        DirectoryRecord& record = summary[path];
+        record.modified = entry.modified;
+        record.checked = entry.checked;
+        record.largestFile = entry.largestFile;
+        record.largestInSubtree = entry.largestInSubtree;
+    }
+
+    summary_ = std::move(summary);
+    return true;
+}
+
+bool LargeFileFinder::saveSummary(std::string& error) {
+    if (summaryPath_.empty() || !summaryChanged_) {
+        return true;
+    }
+
+    std::error_code ec;
+    fs::path target(summaryPath_);
+    if (target.has_parent_path()) {
+        fs::create_directories(target.parent_path(), ec);
+    }
+
+    std::string partialPath = summaryPath_ + ".partial";
+    {
+        std::ofstream out(partialPath, std::ios::binary | std::ios::trunc);
+        SummaryHeader header;
+        std::memcpy(header.magic, LARGE_FILE_SUMMARY_MAGIC, sizeof(header.magic));
+        header.recordCount = summary_.size();
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (const auto& record : summary_) {
+            SummaryEntry entry;
+            entry.modified = record.second.modified;
+            entry.checked = record.second.checked;
+            entry.largestFile = record.second.largestFile;
+            entry.largestInSubtree = record.second.largestInSubtree;
+            entry.pathLength = static_cast<uint32_t>(record.first.size());
+            entry.reserved = 0;
+            out.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+            out.write(record.first.data(), static_cast<std::streamsize>(record.first.size()));
+        }
+        if (!out) {
+            error = "Cannot write large file summary " + partialPath;
+            fs::remove(partialPath, ec);
+            return false;
+        }
+    }
+
+    fs::rename(partialPath, target, ec);
+    if (ec) {
+        error = "Cannot replace large file summary " + summaryPath_ + ": " + ec.message();
+        fs::remove(partialPath, ec);
+        return false;
+    }
+
+    summaryChanged_ = false;
+    return true;
+}
+
+}
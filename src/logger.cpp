@@ -3,6 +3,7 @@
 #include <iostream>
 #include <sstream>
 #include <filesystem>
+#include <chrono>
 
 namespace CClean {
 
@@ -37,6 +38,8 @@ void Logger::log(LogLevel level, const std::string& message) {
     
     std::string logMessage = ss.str();
     
+    std::lock_guard<std::mutex> lock(mutex_);
+    
     if (consoleLogging_) {
         writeToConsole(logMessage);
     }
@@ -60,25 +63,34 @@ void Logger::debug(const std::string& message) {
     log(LogLevel::DEBUG, message);
 }
 
-void Logger::logCleanupResult(CleanupType type, const CleanupResult& result) {
-    std::string typeStr;
+std::string Logger::cleanupTypeName(CleanupType type) {
     switch (type) {
         case CleanupType::TEMP_FILES:
-            typeStr = "Temp Files";
-            break;
+            return "Temp Files";
         case CleanupType::BROWSER_CACHE:
-            typeStr = "Browser Cache";
-            break;
+            return "Browser Cache";
         case CleanupType::SYSTEM_FILES:
-            typeStr = "System Files";
-            break;
+            return "System Files";
         case CleanupType::RECYCLE_BIN:
-            typeStr = "Recycle Bin";
-            break;
+            return "Recycle Bin";
+        case CleanupType::GIT_ARTIFACTS:
+            return "Git Artifacts";
+        case CleanupType::SPARSIFY:
+            return "Sparsify";
+        case CleanupType::ARCHIVE:
+            return "Archive";
+        case CleanupType::THUMBNAILS:
+            return "Thumbnails";
+        case CleanupType::JOURNAL:
+            return "Journal";
         case CleanupType::ALL:
-            typeStr = "All Categories";
-            break;
+            return "All Categories";
     }
+    return "Unknown";
+}
+
+void Logger::logCleanupResult(CleanupType type, const CleanupResult& result) {
+    std::string typeStr = cleanupTypeName(type);
     
     std::ostringstream ss;
     ss << typeStr << " cleanup completed: "
@@ -93,15 +105,20 @@ void Logger::logCleanupResult(CleanupType type, const CleanupResult& result) {
     }
 }
 
+static size_t steadyMilliseconds() {
+    return static_cast<size_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
 void Logger::startSession() {
-    sessionStartTime_ = GetTickCount64();
+    sessionStartTime_ = steadyMilliseconds();
     info("=== CClean Session Started ===");
     info("Version: " + VERSION);
     info("Admin Rights: " + std::string(Utils::hasAdminRights() ? "Yes" : "No"));
 }
 
 void Logger::endSession() {
-    size_t sessionDuration = GetTickCount64() - sessionStartTime_;
+    size_t sessionDuration = steadyMilliseconds() - sessionStartTime_;
     double durationSeconds = sessionDuration / 1000.0;
     
     std::ostringstream ss;
@@ -2,17 +2,41 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <cstdlib>
+#include <sstream>
+#include <csignal>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#ifdef _WIN32
 #include <windows.h>
+#endif
 #include "config.h"
 #include "cleaner.h"
 #include "logger.h"
 #include "utils.h"
+#include "pressure_monitor.h"
+#include "io_watchdog.h"
+#include "archiver.h"
+#include "mft_scanner.h"
+#include "fs_trimmer.h"
+#include "inode_relief.h"
+#include "age_sketch.h"
+#include "handle_list.h"
 
 using namespace CClean;
 
 void printUsage() {
     std::cout << "\n" << APP_NAME << " v" << VERSION << "\n";
-    std::cout << "Usage: cclean [options]\n\n";
+    std::cout << "Usage: cclean [options]\n";
+    std::cout << "       cclean large [--min-size SIZE] [options] [PATH...]\n";
+    std::cout << "                     List files of at least SIZE (default: 1G) on the filesystems\n";
+    std::cout << "                     of PATH (default: the system drive), largest first\n\n";
     std::cout << "Options:\n";
     std::cout << "  -s, --scan         Scan for files without deleting\n";
     std::cout << "  -c, --clean        Clean files (default action)\n";
@@ -20,16 +44,88 @@ void printUsage() {
     std::cout << "  -b, --browser      Only process browser cache\n";
     std::cout << "  -r, --recycle      Only empty recycle bin\n";
     std::cout << "  -y, --system       Only process system files\n";
+    std::cout << "  --recycle-older-than DAYS\n";
+    std::cout << "                     Only remove Recycle Bin items deleted more than DAYS ago\n";
+    std::cout << "  --recycle-root DIR Use DIR as the $Recycle.Bin folder\n";
+    std::cout << "  -g, --git-artifacts ROOT\n";
+    std::cout << "                     Only remove git-ignored files in working trees under ROOT\n";
+    std::cout << "  --sparsify PATH    Punch holes in zero-filled regions of large files under PATH\n";
+    std::cout << "  --thumbnails       Only remove cached thumbnails whose source file no longer exists\n";
+    std::cout << "  --journal          Only remove archived systemd journal files older than --older-than\n";
+    std::cout << "                     days (default: 30) or beyond --journal-max-size\n";
+    std::cout << "  --journal-max-size SIZE\n";
+    std::cout << "                     Also remove the oldest archived journal files until each journal\n";
+    std::cout << "                     directory fits in SIZE\n";
+    std::cout << "  --archive PATH     Pack directories of small old files under PATH into tar archives\n";
+    std::cout << "  --tier DEST        Move cold files of the selected categories under DEST instead of\n";
+    std::cout << "                     deleting them\n";
+    std::cout << "  --older-than DAYS  Only archive files unmodified, tier files unused, or vacuum journals\n";
+    std::cout << "                     without entries, for DAYS days\n";
+    std::cout << "                     (default: 30)\n";
+    std::cout << "  --compress         Gzip archives written by --archive\n";
+    std::cout << "  --archive-list FILE\n";
+    std::cout << "                     List the contents of an archive written by --archive\n";
+    std::cout << "  --archive-extract FILE DIR\n";
+    std::cout << "                     Restore the files of an archive into DIR\n";
+    std::cout << "  --mft              Size NTFS category folders from the volume's MFT during scans\n";
+    std::cout << "                     instead of walking them (Windows, administrator)\n";
+    std::cout << "  --mft-sizes SOURCE DIR\n";
+    std::cout << "                     Print the size of DIR and each entry in it, read from the MFT of\n";
+    std::cout << "                     SOURCE (a volume such as C:, or an NTFS image or device)\n";
+    std::cout << "  --keep-list FILE   Never delete the paths listed in FILE (one per line) or anything\n";
+    std::cout << "                     below them; the list is indexed once into FILE.idx\n";
+    std::cout << "  --failure-cache FILE\n";
+    std::cout << "                     Where files that failed to delete are remembered between runs\n";
+    std::cout << "                     (default: the user cache directory)\n";
+    std::cout << "  --no-failure-cache Retry every file on every run\n";
     std::cout << "  -a, --all          Process all categories (default)\n";
+    std::cout << "  -i, --interactive  With --all, confirm each category as soon as its scan finishes;\n";
+    std::cout << "                     approved categories clean while the others still scan\n";
     std::cout << "  -d, --dry-run      Show what would be deleted without deleting\n";
     std::cout << "  -v, --verbose      Enable verbose output\n";
     std::cout << "  -q, --quiet        Suppress console output\n";
+    std::cout << "  --no-per-file-size Delete without a stat per file; bytes freed comes from the change\n";
+    std::cout << "                     in free space, which other writers on the same disk skew\n";
+    std::cout << "  --min-size SIZE    Smallest file considered by --sparsify (default: 64M) or large\n";
+    std::cout << "  --free-inodes-target N[%]\n";
+    std::cout << "                     Delete files with the most files per byte first and stop once\n";
+    std::cout << "                     N inodes (or N% of all inodes) are free on the filesystem\n";
+    std::cout << "                     (not on Windows)\n";
+    std::cout << "  --save-handles FILE\n";
+    std::cout << "                     Scan only, and save each candidate to FILE by its parent\n";
+    std::cout << "                     directory's file handle (Linux)\n";
+    std::cout << "  --apply FILE       Delete the candidates saved in FILE that are unchanged, even\n";
+    std::cout << "                     if a directory above them was renamed (Linux, administrator)\n";
+    std::cout << "  --retention-target SIZE\n";
+    std::cout << "                     After a scan, print per category the file age cutoff that\n";
+    std::cout << "                     would free SIZE, from the bytes found at each age\n";
+    std::cout << "  --trim             After cleaning, FITRIM the filesystems files were deleted from\n";
+    std::cout << "                     in ranges at idle I/O priority (Linux, administrator)\n";
+    std::cout << "  --trim-range SIZE  Bytes of the filesystem per FITRIM call (default: 4G)\n";
+    std::cout << "  --trim-min-extent SIZE\n";
+    std::cout << "                     Leave free extents smaller than SIZE untrimmed (default: 1M)\n";
+    std::cout << "  --trim-pause MS    Pause between trim ranges (default: 100)\n";
+    std::cout << "  --io-limit RATE    Cap bulk read/write bandwidth, e.g. 50M per second\n";
     std::cout << "  -l, --log FILE     Specify log file (default: cclean.log)\n";
+    std::cout << "  --cpuset LIST      Keep every cclean thread on these CPUs, e.g. 0-1,6 (default: the\n";
+    std::cout << "                     CPUs the process is allowed to use); sizes the worker pools\n";
+    std::cout << "  --io-timeout SECONDS\n";
+    std::cout << "                     Skip a directory whose filesystem calls hang this long, e.g. on a\n";
+    std::cout << "                     stale network mount (default: 30, 0 to disable)\n";
+    std::cout << "  --pipeline-threads ENUM,FILTER,DELETE\n";
+    std::cout << "                     Threads of each cleaning stage, 0 for the default (CPUs allowed)\n";
+    std::cout << "  --pipeline-batch ENUM,FILTER\n";
+    std::cout << "                     Files per batch passed on by the enumerate and filter stages\n";
+    std::cout << "                     (default: 256,64); per-stage utilization goes to the log\n";
+    std::cout << "  --pressure-pacing  Slow down or pause when I/O or memory pressure (Linux PSI) is high\n";
+    std::cout << "  --pressure-thresholds SLOW,PAUSE,RESUME\n";
+    std::cout << "                     Stall percentages for pacing (default: 10,40,20)\n";
     std::cout << "  -h, --help         Show this help message\n";
     std::cout << "\nExamples:\n";
     std::cout << "  cclean --scan      # Scan all categories\n";
     std::cout << "  cclean --temp -d   # Dry run temp file cleanup\n";
     std::cout << "  cclean --all -v    # Clean all with verbose output\n";
+    std::cout << "  cclean -g ~/src    # Remove ignored build output from every checkout\n";
     std::cout << "\n";
 }
 
@@ -68,6 +164,102 @@ void printResult(const CleanupResult& result, const std::string& operation) {
     std::cout << "\n";
 }
 
+bool parsePressureThresholds(const std::string& value, PressureThresholds& thresholds) {
+    char separator1 = 0;
+    char separator2 = 0;
+    std::istringstream ss(value);
+    
+    ss >> thresholds.slowdownPercent >> separator1 >> thresholds.pausePercent
+       >> separator2 >> thresholds.resumePercent;
+    
+    return !ss.fail() && separator1 == ',' && separator2 == ',' &&
+           thresholds.slowdownPercent <= thresholds.pausePercent &&
+           thresholds.resumePercent <= thresholds.pausePercent;
+}
+
+bool parsePipelineThreads(const std::string& value, PipelineOptions& options) {
+    char separator1 = 0;
+    char separator2 = 0;
+    std::istringstream ss(value);
+    
+    ss >> options.enumerateThreads >> separator1 >> options.filterThreads
+       >> separator2 >> options.deleteThreads;
+    
+    return !ss.fail() && separator1 == ',' && separator2 == ',';
+}
+
+bool parsePipelineBatches(const std::string& value, PipelineOptions& options) {
+    char separator = 0;
+    std::istringstream ss(value);
+    
+    ss >> options.enumerateBatch >> separator >> options.filterBatch;
+    
+    return !ss.fail() && separator == ',' && options.enumerateBatch > 0 && options.filterBatch > 0;
+}
+
+void printPressureSummary() {
+    PressureMonitor& monitor = PressureMonitor::getInstance();
+    
+    std::ostringstream ss;
+    ss.precision(1);
+    ss << std::fixed << "Pressure pacing: paused " << monitor.pausedSeconds()
+       << "s, slowed " << monitor.slowedSeconds() << "s";
+    
+    Logger::getInstance().info(ss.str());
+}
+
+void printStuckIoSummary(bool quiet) {
+    auto stuck = IoWatchdog::getInstance().stuckOperations();
+    if (stuck.empty()) {
+        return;
+    }
+    
+    Logger::getInstance().warning("Skipped " + std::to_string(stuck.size()) + " path(s) after stuck I/O");
+    if (quiet) {
+        return;
+    }
+    
+    std::cout << "Skipped after stuck I/O:\n";
+    for (const auto& operation : stuck) {
+        std::cout << "  " << operation.path << " (" << operation.operation << ")\n";
+    }
+    std::cout << "\n";
+}
+
+int printMftSizes(const std::string& source, const std::string& directory) {
+    MftScanner scanner;
+    std::string error;
+    auto start = std::chrono::steady_clock::now();
+    
+    if (!scanner.open(source, error) || !scanner.scan(error)) {
+        std::cerr << "Error: " << error << "\n";
+        return 1;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    
+    MftTotals totals;
+    std::vector<std::pair<std::string, MftTotals>> children;
+    if (!scanner.totalsFor(directory, totals) || !scanner.childrenOf(directory, children)) {
+        std::cerr << "Error: " << directory << " not found on " << source << "\n";
+        return 1;
+    }
+    
+    std::sort(children.begin(), children.end(), [](const auto& a, const auto& b) {
+        return a.second.allocated > b.second.allocated;
+    });
+    
+    std::cout << "Read " << scanner.recordCount() << " MFT records in " << std::fixed << std::setprecision(2)
+              << seconds << "s\n\n";
+    std::cout << directory << ": " << totals.files << " files, " << totals.directories << " directories, "
+              << Utils::formatBytes(totals.bytes) << " (" << Utils::formatBytes(totals.allocated) << " on disk)\n";
+    for (const auto& child : children) {
+        std::cout << "  " << std::left << std::setw(40) << child.first << std::right << std::setw(12)
+                  << Utils::formatBytes(child.second.allocated) << " on disk" << std::setw(10)
+                  << child.second.files << " files\n";
+    }
+    return 0;
+}
+
 bool confirmCleanup(const CleanupResult& scanResult) {
     std::cout << "\nScan Summary:\n";
     std::cout << "  Files Found: " << scanResult.filesScanned << "\n";
@@ -80,20 +272,290 @@ bool confirmCleanup(const CleanupResult& scanResult) {
     return !input.empty() && (input[0] == 'y' || input[0] == 'Y');
 }
 
+// For each category the scan sized file by file: how old a file must be
+// for deleting everything at least that old to free target bytes
+void printRetentionAdvice(CCleaner& cleaner, CleanupType cleanupType, size_t target) {
+    std::vector<CleanupType> categories;
+    if (cleanupType == CleanupType::ALL) {
+        categories = CCleaner::fullCategories();
+    } else {
+        categories.push_back(cleanupType);
+    }
+    
+    Logger& logger = Logger::getInstance();
+    std::cout << "\nRetention needed to free " << Utils::formatBytes(target) << ":\n";
+    
+    bool any = false;
+    for (CleanupType category : categories) {
+        std::string name = Logger::cleanupTypeName(category);
+        AgeSketch ages;
+        if (!cleaner.ageSketch(name, ages)) {
+            continue;
+        }
+        any = true;
+        
+        std::ostringstream ss;
+        ss << std::fixed;
+        ss.precision(0);
+        double cutoff = 0;
+        if (ages.cutoffForBytes(static_cast<double>(target), cutoff)) {
+            // Whole days, rounded down so the cutoff frees at least the target
+            double days = std::floor(cutoff);
+            ss << name << ": delete files older than " << days << " days (about "
+               << Utils::formatBytes(static_cast<size_t>(ages.bytesOlderThan(days))) << " of "
+               << Utils::formatBytes(static_cast<size_t>(ages.totalBytes())) << ")";
+        } else {
+            ss << name << ": only " << Utils::formatBytes(static_cast<size_t>(ages.totalBytes()))
+               << " found; even deleting everything falls short";
+        }
+        ss << "; median age " << ages.quantile(0.5) << " days, 90th percentile " << ages.quantile(0.9) << " days";
+        
+        std::cout << "  " << ss.str() << "\n";
+        logger.info(ss.str());
+    }
+    
+    if (!any) {
+        std::cout << "  No category was sized file by file (the MFT, --free-inodes and --tier don't record ages)\n";
+    }
+}
+
+void findLargeFiles(CCleaner& cleaner, std::vector<std::string> roots, size_t minimumSize, bool quiet) {
+    if (roots.empty()) {
+#ifdef _WIN32
+        roots.push_back(Utils::expandEnvironmentVariables("%SystemDrive%\\"));
+#else
+        roots.push_back("/");
+#endif
+    }
+    
+    if (!quiet) {
+        std::cout << "Looking for files of at least " << Utils::formatBytes(minimumSize) << "...\n";
+    }
+    
+    // Printed as the walk finds them, then again in order once it is done
+    std::mutex outputMutex;
+    auto files = cleaner.findLargeFiles(roots, minimumSize, [&](const LargeFile& file) {
+        if (!quiet) {
+            std::lock_guard<std::mutex> lock(outputMutex);
+            std::cout << "  found " << std::setw(10) << Utils::formatBytes(file.size) << "  " << file.path << "\n";
+        }
+    });
+    
+    if (quiet) {
+        return;
+    }
+    
+    size_t totalBytes = 0;
+    for (const auto& file : files) {
+        totalBytes += file.size;
+    }
+    
+    std::cout << "\nLarge files: " << files.size() << " (" << Utils::formatBytes(totalBytes) << ")\n";
+    for (const auto& file : files) {
+        std::cout << std::setw(12) << Utils::formatBytes(file.size) << "  " << file.path << "\n";
+    }
+}
+
+void stopTrimming(int) {
+    FilesystemTrimmer::requestStop();
+}
+
+void trimFilesystems(const std::vector<std::string>& paths, FilesystemTrimmer& trimmer, bool quiet) {
+    if (paths.empty()) {
+        return;
+    }
+    
+    Logger& logger = Logger::getInstance();
+    FilesystemTrimmer::clearStop();
+    auto previousHandler = std::signal(SIGINT, stopTrimming);
+    
+    if (!quiet) {
+        std::cout << "Trimming freed space on " << paths.size()
+                  << " filesystem(s); Ctrl+C stops after the current range...\n";
+    }
+    
+    for (const auto& path : paths) {
+        FilesystemTrimmer::Result trimResult;
+        std::string error;
+        bool ok = trimmer.trim(path, trimResult, error);
+        
+        if (trimResult.chunks > 0) {
+            std::string message = "Trimmed " + Utils::formatBytes(trimResult.trimmedBytes) + " on the filesystem of " +
+                                  path + " in " + std::to_string(trimResult.chunks) + " ranges";
+            if (trimResult.coveredBytes < trimResult.totalBytes) {
+                message += " (stopped after " + Utils::formatBytes(trimResult.coveredBytes) + " of " +
+                           Utils::formatBytes(trimResult.totalBytes) + ")";
+            }
+            logger.info(message);
+            if (!quiet) {
+                std::cout << "  " << message << "\n";
+            }
+        }
+        if (!ok) {
+            logger.warning(error);
+            if (!quiet) {
+                std::cout << "  " << error << "\n";
+            }
+        }
+        if (trimResult.interrupted) {
+            break;
+        }
+    }
+    
+    std::signal(SIGINT, previousHandler);
+}
+
+// Scans every category at once and asks about each one as soon as its scan
+// finishes. Approved categories start cleaning straight away while the rest
+// are still scanning or waiting for an answer, so the wait is closer to the
+// slowest category than to scanning everything and then cleaning it all.
+CleanupResult runInteractiveCleanup(CCleaner& cleaner, bool serializeCleans) {
+    const auto& categories = CCleaner::fullCategories();
+    
+    std::mutex mutex;
+    std::condition_variable scanFinished;
+    std::deque<std::pair<CleanupType, CleanupResult>> scanResults;
+    
+    std::vector<std::thread> scanThreads;
+    for (CleanupType type : categories) {
+        scanThreads.emplace_back([&, type] {
+            CleanupResult scanResult = cleaner.scanCategory(type);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                scanResults.emplace_back(type, scanResult);
+            }
+            scanFinished.notify_one();
+        });
+    }
+    
+    // Without per-file sizes each clean measures free space, which
+    // concurrent cleans on the same disk would count twice
+    std::mutex cleanSerializer;
+    std::vector<std::thread> cleanThreads;
+    std::vector<std::pair<CleanupType, CleanupResult>> cleanResults(categories.size());
+    
+    std::cout << "Scanning " << categories.size() << " categories...\n";
+    
+    for (size_t answered = 0; answered < categories.size(); ++answered) {
+        std::pair<CleanupType, CleanupResult> scanned;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            scanFinished.wait(lock, [&] { return !scanResults.empty(); });
+            scanned = scanResults.front();
+            scanResults.pop_front();
+        }
+        
+        CleanupType type = scanned.first;
+        std::string name = Logger::cleanupTypeName(type);
+        if (scanned.second.filesScanned == 0) {
+            std::cout << "\n" << name << ": nothing to clean\n";
+            continue;
+        }
+        
+        std::cout << "\n" << name << ": " << scanned.second.filesScanned << " files, "
+                  << Utils::formatBytes(scanned.second.bytesFreed) << "\n";
+        std::cout << "Clean " << name << "? (y/N): " << std::flush;
+        std::string input;
+        if (!std::getline(std::cin, input) || input.empty() || (input[0] != 'y' && input[0] != 'Y')) {
+            std::cout << "Skipping " << name << ".\n";
+            continue;
+        }
+        
+        std::cout << "Cleaning " << name << " while the other categories finish...\n";
+        size_t slot = cleanThreads.size();
+        cleanThreads.emplace_back([&, type, slot] {
+            std::unique_lock<std::mutex> serial(cleanSerializer, std::defer_lock);
+            if (serializeCleans) {
+                serial.lock();
+            }
+            CleanupResult cleanResult = cleaner.cleanCategory(type);
+            Logger::getInstance().logCleanupResult(type, cleanResult);
+            
+            std::lock_guard<std::mutex> lock(mutex);
+            cleanResults[slot] = std::make_pair(type, cleanResult);
+        });
+    }
+    
+    for (auto& thread : scanThreads) {
+        thread.join();
+    }
+    for (auto& thread : cleanThreads) {
+        thread.join();
+    }
+    
+    CleanupResult totalResult;
+    std::cout << "\n";
+    for (size_t i = 0; i < cleanThreads.size(); ++i) {
+        const CleanupResult& cleanResult = cleanResults[i].second;
+        std::cout << "  " << std::left << std::setw(16) << Logger::cleanupTypeName(cleanResults[i].first)
+                  << std::right << cleanResult.filesDeleted << " files, "
+                  << Utils::formatBytes(cleanResult.bytesFreed) << " freed\n";
+        
+        totalResult.filesScanned += cleanResult.filesScanned;
+        totalResult.filesDeleted += cleanResult.filesDeleted;
+        totalResult.bytesFreed += cleanResult.bytesFreed;
+        if (!cleanResult.success && !cleanResult.errorMessage.empty()) {
+            if (totalResult.errorMessage.empty()) {
+                totalResult.errorMessage = cleanResult.errorMessage;
+            } else {
+                totalResult.errorMessage += "; " + cleanResult.errorMessage;
+            }
+            totalResult.success = false;
+        }
+    }
+    
+    return totalResult;
+}
+
 int main(int argc, char* argv[]) {
+#ifdef _WIN32
     SetConsoleOutputCP(CP_UTF8);
+#endif
     
     bool scanOnly = false;
     bool dryRun = false;
     bool verbose = false;
     bool quiet = false;
+    bool interactive = false;
     CleanupType cleanupType = CleanupType::ALL;
     std::string logFile = LOG_FILE;
+    std::string gitRoot;
+    std::string recycleBinRoot;
+    bool pressurePacing = false;
+    PressureThresholds pressureThresholds;
+    int recycleBinMinimumAge = 0;
+    std::vector<std::string> sparsifyRoots;
+    size_t minimumFileSize = SPARSIFY_MIN_FILE_SIZE;
+    size_t journalMaximumSize = 0;
+    size_t ioRateLimit = 0;
+    size_t freeInodesTarget = 0;
+    bool freeInodesTargetPercent = false;
+    std::vector<std::string> archiveRoots;
+    int minimumAgeDays = -1;
+    std::string tierDestination;
+    bool archiveCompression = false;
+    std::string keepListPath;
+    std::vector<unsigned int> cpuSet;
+    int ioTimeout = IO_WATCHDOG_TIMEOUT_SECONDS;
+    std::string failureCachePath = FailureCache::defaultPath();
+    bool perFileSize = true;
+    bool useMft = false;
+    PipelineOptions pipelineOptions;
+    size_t retentionTarget = 0;
+    std::string saveHandlesPath;
+    std::string applyHandlesPath;
+    bool largeFiles = false;
+    std::vector<std::string> largeRoots;
+    bool minimumSizeGiven = false;
+    bool trimAfterClean = false;
+    FilesystemTrimmer trimmer;
     
     for (int i = 1; i < argc; ++i) {
         std::string arg = argv[i];
         
-        if (arg == "-s" || arg == "--scan") {
+        if (i == 1 && arg == "large") {
+            largeFiles = true;
+        } else if (arg == "-s" || arg == "--scan") {
             scanOnly = true;
         } else if (arg == "-c" || arg == "--clean") {
             scanOnly = false;
@@ -103,10 +565,132 @@ int main(int argc, char* argv[]) {
             cleanupType = CleanupType::BROWSER_CACHE;
         } else if (arg == "-r" || arg == "--recycle") {
             cleanupType = CleanupType::RECYCLE_BIN;
+        } else if (arg == "--recycle-older-than" && i + 1 < argc) {
+            recycleBinMinimumAge = std::atoi(argv[++i]);
+        } else if (arg == "--recycle-root" && i + 1 < argc) {
+            recycleBinRoot = argv[++i];
         } else if (arg == "-y" || arg == "--system") {
             cleanupType = CleanupType::SYSTEM_FILES;
+        } else if ((arg == "-g" || arg == "--git-artifacts") && i + 1 < argc) {
+            cleanupType = CleanupType::GIT_ARTIFACTS;
+            gitRoot = argv[++i];
+        } else if (arg == "--sparsify" && i + 1 < argc) {
+            cleanupType = CleanupType::SPARSIFY;
+            sparsifyRoots.push_back(argv[++i]);
+        } else if (arg == "--thumbnails") {
+            cleanupType = CleanupType::THUMBNAILS;
+        } else if (arg == "--journal") {
+            cleanupType = CleanupType::JOURNAL;
+        } else if (arg == "--journal-max-size" && i + 1 < argc) {
+            if (!Utils::parseByteSize(argv[++i], journalMaximumSize)) {
+                std::cerr << "Error: Invalid size: " << argv[i] << "\n";
+                return 1;
+            }
+        } else if (arg == "--archive" && i + 1 < argc) {
+            cleanupType = CleanupType::ARCHIVE;
+            archiveRoots.push_back(argv[++i]);
+        } else if (arg == "--older-than" && i + 1 < argc) {
+            minimumAgeDays = std::atoi(argv[++i]);
+        } else if (arg == "--tier" && i + 1 < argc) {
+            tierDestination = argv[++i];
+        } else if (arg == "--compress") {
+            if (!Archiver::compressionSupported()) {
+                std::cerr << "Error: This build has no zlib support for --compress\n";
+                return 1;
+            }
+            archiveCompression = true;
+        } else if (arg == "--archive-list" && i + 1 < argc) {
+            std::string error;
+            if (!Archiver::list(argv[++i], std::cout, error)) {
+                std::cerr << "Error: " << error << "\n";
+                return 1;
+            }
+            return 0;
+        } else if (arg == "--archive-extract" && i + 2 < argc) {
+            std::string archivePath = argv[++i];
+            std::string error;
+            if (!Archiver::extract(archivePath, argv[++i], error)) {
+                std::cerr << "Error: " << error << "\n";
+                return 1;
+            }
+            return 0;
+        } else if (arg == "--mft") {
+            useMft = true;
+        } else if (arg == "--mft-sizes" && i + 2 < argc) {
+            std::string source = argv[++i];
+            return printMftSizes(source, argv[++i]);
+        } else if (arg == "--keep-list" && i + 1 < argc) {
+            keepListPath = argv[++i];
+        } else if (arg == "--failure-cache" && i + 1 < argc) {
+            failureCachePath = argv[++i];
+        } else if (arg == "--no-failure-cache") {
+            failureCachePath.clear();
+        } else if (arg == "--no-per-file-size") {
+            perFileSize = false;
+        } else if (arg == "--min-size" && i + 1 < argc) {
+            if (!Utils::parseByteSize(argv[++i], minimumFileSize)) {
+                std::cerr << "Error: Invalid size: " << argv[i] << "\n";
+                return 1;
+            }
+            minimumSizeGiven = true;
+        } else if (arg == "--free-inodes-target" && i + 1 < argc) {
+            if (!InodeReliefCleaner::isSupported()) {
+                std::cerr << "Error: " << arg << " is not supported on this platform\n";
+                return 1;
+            }
+            std::string value = argv[++i];
+            freeInodesTargetPercent = !value.empty() && value.back() == '%';
+            freeInodesTarget = std::strtoull(value.c_str(), nullptr, 10);
+            if (freeInodesTarget == 0 || (freeInodesTargetPercent && freeInodesTarget > 100)) {
+                std::cerr << "Error: Invalid inode target: " << value << "\n";
+                return 1;
+            }
+        } else if ((arg == "--save-handles" || arg == "--apply") && i + 1 < argc) {
+            if (!HandleList::isSupported()) {
+                std::cerr << "Error: " << arg << " is only supported on Linux\n";
+                return 1;
+            }
+            if (arg == "--save-handles") {
+                saveHandlesPath = argv[++i];
+                scanOnly = true;
+            } else {
+                applyHandlesPath = argv[++i];
+            }
+        } else if (arg == "--retention-target" && i + 1 < argc) {
+            if (!Utils::parseByteSize(argv[++i], retentionTarget) || retentionTarget == 0) {
+                std::cerr << "Error: Invalid size: " << argv[i] << "\n";
+                return 1;
+            }
+        } else if (arg == "--trim") {
+            if (!FilesystemTrimmer::isSupported()) {
+                std::cerr << "Warning: --trim is only supported on Linux\n";
+            }
+            trimAfterClean = true;
+        } else if (arg == "--trim-range" && i + 1 < argc) {
+            size_t bytes = 0;
+            if (!Utils::parseByteSize(argv[++i], bytes) || bytes == 0) {
+                std::cerr << "Error: Invalid size: " << argv[i] << "\n";
+                return 1;
+            }
+            trimmer.setChunkSize(bytes);
+        } else if (arg == "--trim-min-extent" && i + 1 < argc) {
+            size_t bytes = 0;
+            if (!Utils::parseByteSize(argv[++i], bytes)) {
+                std::cerr << "Error: Invalid size: " << argv[i] << "\n";
+                return 1;
+            }
+            trimmer.setMinimumExtent(bytes);
+        } else if (arg == "--trim-pause" && i + 1 < argc) {
+            trimmer.setPause(std::atoi(argv[++i]));
+        } else if (arg == "--io-limit" && i + 1 < argc) {
+            if (!Utils::parseByteSize(argv[++i], ioRateLimit)) {
+                std::cerr << "Error: Invalid rate: " << argv[i] << "\n";
+                return 1;
+            }
         } else if (arg == "-a" || arg == "--all") {
             cleanupType = CleanupType::ALL;
+        } else if (arg == "-i" || arg == "--interactive") {
+            interactive = true;
         } else if (arg == "-d" || arg == "--dry-run") {
             dryRun = true;
         } else if (arg == "-v" || arg == "--verbose") {
@@ -115,9 +699,40 @@ int main(int argc, char* argv[]) {
             quiet = true;
         } else if ((arg == "-l" || arg == "--log") && i + 1 < argc) {
             logFile = argv[++i];
+        } else if (arg == "--cpuset" && i + 1 < argc) {
+            if (!Utils::parseCpuList(argv[++i], cpuSet)) {
+                std::cerr << "Error: Invalid CPU list: " << argv[i] << "\n";
+                return 1;
+            }
+        } else if (arg == "--io-timeout" && i + 1 < argc) {
+            ioTimeout = std::atoi(argv[++i]);
+            if (ioTimeout < 0) {
+                std::cerr << "Error: Invalid timeout: " << argv[i] << "\n";
+                return 1;
+            }
+        } else if (arg == "--pressure-pacing") {
+            pressurePacing = true;
+        } else if (arg == "--pipeline-threads" && i + 1 < argc) {
+            if (!parsePipelineThreads(argv[++i], pipelineOptions)) {
+                std::cerr << "Error: Invalid pipeline threads: " << argv[i] << "\n";
+                return 1;
+            }
+        } else if (arg == "--pipeline-batch" && i + 1 < argc) {
+            if (!parsePipelineBatches(argv[++i], pipelineOptions)) {
+                std::cerr << "Error: Invalid pipeline batch sizes: " << argv[i] << "\n";
+                return 1;
+            }
+        } else if (arg == "--pressure-thresholds" && i + 1 < argc) {
+            pressurePacing = true;
+            if (!parsePressureThresholds(argv[++i], pressureThresholds)) {
+                std::cerr << "Error: Invalid pressure thresholds: " << argv[i] << "\n";
+                return 1;
+            }
         } else if (arg == "-h" || arg == "--help") {
             printUsage();
             return 0;
+        } else if (largeFiles && !arg.empty() && arg[0] != '-') {
+            largeRoots.push_back(arg);
         } else {
             std::cerr << "Unknown option: " << arg << "\n";
             printUsage();
@@ -130,6 +745,14 @@ int main(int argc, char* argv[]) {
         return 1;
     }
     
+    // Before any thread exists, so every pool and monitor thread inherits it
+    std::string affinityError;
+    if (!cpuSet.empty() && !Utils::setCpuAffinity(cpuSet, affinityError)) {
+        std::cerr << "Error: " << affinityError << "\n";
+        return 1;
+    }
+    std::string cpuList = Utils::formatCpuList(Utils::allowedCpus());
+    
     Logger& logger = Logger::getInstance();
     logger.setLogFile(logFile);
     logger.setConsoleLogging(!quiet);
@@ -141,6 +764,7 @@ int main(int argc, char* argv[]) {
         std::cout << "System Information:\n";
         std::cout << "  Admin Rights: " << (Utils::hasAdminRights() ? "Yes" : "No") << "\n";
         std::cout << "  Log File: " << logFile << "\n";
+        std::cout << "  CPUs: " << cpuList << "\n";
         
         if (dryRun) {
             std::cout << "  Mode: DRY RUN (no files will be deleted)\n";
@@ -150,17 +774,107 @@ int main(int argc, char* argv[]) {
     }
     
     logger.startSession();
+    logger.info("CPUs: " + cpuList);
+    if (!cpuSet.empty() && Utils::allowedCpus() != cpuSet) {
+        logger.warning("Only CPUs " + cpuList + " of --cpuset " + Utils::formatCpuList(cpuSet) + " are available");
+    }
+    
+    if (pressurePacing && !PressureMonitor::getInstance().start(pressureThresholds)) {
+        logger.warning("Pressure stall information is not available; pacing disabled");
+    }
+    
+    if (ioTimeout > 0) {
+        IoWatchdog::getInstance().start(std::chrono::seconds(ioTimeout));
+    }
+    
+#ifndef _WIN32
+    if (useMft) {
+        logger.warning("--mft reads Windows NTFS volumes; scanning by walking directories");
+    }
+#endif
     
     try {
         CCleaner cleaner;
         cleaner.setDryRun(dryRun);
         cleaner.setVerbose(verbose);
+        cleaner.setRecycleBinRoot(recycleBinRoot);
+        cleaner.setRecycleBinMinimumAge(recycleBinMinimumAge);
+        cleaner.setMinimumFileSize(minimumFileSize);
+        cleaner.setIoRateLimit(ioRateLimit);
+        cleaner.setFreeInodesTarget(freeInodesTarget, freeInodesTargetPercent);
+        if (minimumAgeDays >= 0) {
+            cleaner.setArchiveMinimumAge(minimumAgeDays);
+            cleaner.setTierMinimumAge(minimumAgeDays);
+            cleaner.setJournalMaximumAge(minimumAgeDays);
+        }
+        cleaner.setJournalMaximumSize(journalMaximumSize);
+        cleaner.setTierDestination(tierDestination);
+        cleaner.setArchiveCompression(archiveCompression);
+        cleaner.setPerFileSize(perFileSize);
+        cleaner.setUseMft(useMft);
+        cleaner.setPipelineOptions(pipelineOptions);
+        
+        std::string keepListError;
+        if (!keepListPath.empty() && !cleaner.setKeepList(keepListPath, keepListError)) {
+            logger.error(keepListError);
+            std::cerr << "Error: " << keepListError << "\n";
+            logger.endSession();
+            return 1;
+        }
+        
+        std::string failureCacheError;
+        if (!failureCachePath.empty()) {
+            cleaner.setFailureCache(failureCachePath, failureCacheError);
+            if (!failureCacheError.empty()) {
+                logger.warning(failureCacheError);
+            }
+        }
+        
         cleaner.setProgressCallback(quiet ? nullptr : progressCallback);
         
+        if (largeFiles) {
+            cleaner.setProgressCallback(nullptr);
+            findLargeFiles(cleaner, largeRoots, minimumSizeGiven ? minimumFileSize : LARGE_FILE_MIN_SIZE, quiet);
+            
+            if (PressureMonitor::getInstance().isActive()) {
+                PressureMonitor::getInstance().stop();
+                printPressureSummary();
+            }
+            IoWatchdog::getInstance().stop();
+            printStuckIoSummary(quiet);
+            logger.endSession();
+            return 0;
+        }
+        
         CleanupResult result;
         std::string operation;
         
-        if (scanOnly) {
+        HandleList handleList;
+        if (!saveHandlesPath.empty()) {
+            cleaner.setHandleList(&handleList);
+        }
+        
+        if (!applyHandlesPath.empty()) {
+            std::string handleError;
+            if (!handleList.load(applyHandlesPath, handleError)) {
+                logger.error(handleError);
+                std::cerr << "Error: " << handleError << "\n";
+                logger.endSession();
+                return 1;
+            }
+            
+            if (!quiet) {
+                std::cout << (dryRun ? "Checking " : "Deleting ") << handleList.size()
+                          << " saved candidates from " << applyHandlesPath << "...\n";
+            }
+            operation = dryRun ? "Dry Run" : "Cleanup";
+            result = cleaner.applyHandleList(handleList);
+            
+            if (!quiet && (handleList.filesMissing() > 0 || handleList.filesChanged() > 0)) {
+                std::cout << "Left alone: " << handleList.filesMissing() << " gone, "
+                          << handleList.filesChanged() << " changed since the scan\n";
+            }
+        } else if (scanOnly) {
             operation = "Scan";
             
             switch (cleanupType) {
@@ -174,15 +888,37 @@ int main(int argc, char* argv[]) {
                     result = cleaner.scanSystemFiles();
                     break;
                 case CleanupType::RECYCLE_BIN:
-                    // For recycle bin, we need to scan it manually
-                    result.filesScanned = 1;
-                    result.bytesFreed = Utils::getDirectorySize(Utils::getRecycleBinPath());
-                    result.success = true;
+                    result = cleaner.scanRecycleBin();
+                    break;
+                case CleanupType::GIT_ARTIFACTS:
+                    result = cleaner.scanGitArtifacts(gitRoot);
+                    break;
+                case CleanupType::SPARSIFY:
+                    result = cleaner.scanSparsify(sparsifyRoots);
+                    break;
+                case CleanupType::ARCHIVE:
+                    result = cleaner.scanArchive(archiveRoots);
+                    break;
+                case CleanupType::THUMBNAILS:
+                    result = cleaner.scanThumbnails();
+                    break;
+                case CleanupType::JOURNAL:
+                    result = cleaner.scanJournal();
                     break;
                 case CleanupType::ALL:
                     result = cleaner.performFullScan();
                     break;
             }
+        } else if (interactive && !dryRun && !quiet && cleanupType == CleanupType::ALL) {
+            if (!Utils::hasAdminRights()) {
+                std::cout << "Warning: Running without administrator privileges may limit cleanup effectiveness.\n";
+                std::cout << "Some system files may not be accessible.\n\n";
+            }
+            
+            // Categories run side by side, so one progress bar can't follow them
+            cleaner.setProgressCallback(nullptr);
+            operation = "Cleanup";
+            result = runInteractiveCleanup(cleaner, !perFileSize);
         } else {
             if (!dryRun && !Utils::hasAdminRights()) {
                 std::cout << "Warning: Running without administrator privileges may limit cleanup effectiveness.\n";
@@ -205,9 +941,22 @@ int main(int argc, char* argv[]) {
                         scanResult = cleaner.scanSystemFiles();
                         break;
                     case CleanupType::RECYCLE_BIN:
-                        scanResult.filesScanned = 1;
-                        scanResult.bytesFreed = Utils::getDirectorySize(Utils::getRecycleBinPath());
-                        scanResult.success = true;
+                        scanResult = cleaner.scanRecycleBin();
+                        break;
+                    case CleanupType::GIT_ARTIFACTS:
+                        scanResult = cleaner.scanGitArtifacts(gitRoot);
+                        break;
+                    case CleanupType::SPARSIFY:
+                        scanResult = cleaner.scanSparsify(sparsifyRoots);
+                        break;
+                    case CleanupType::ARCHIVE:
+                        scanResult = cleaner.scanArchive(archiveRoots);
+                        break;
+                    case CleanupType::THUMBNAILS:
+                        scanResult = cleaner.scanThumbnails();
+                        break;
+                    case CleanupType::JOURNAL:
+                        scanResult = cleaner.scanJournal();
                         break;
                     case CleanupType::ALL:
                         scanResult = cleaner.performFullScan();
@@ -242,6 +991,21 @@ int main(int argc, char* argv[]) {
                 case CleanupType::RECYCLE_BIN:
                     result = cleaner.cleanRecycleBin();
                     break;
+                case CleanupType::GIT_ARTIFACTS:
+                    result = cleaner.cleanGitArtifacts(gitRoot);
+                    break;
+                case CleanupType::SPARSIFY:
+                    result = cleaner.cleanSparsify(sparsifyRoots);
+                    break;
+                case CleanupType::ARCHIVE:
+                    result = cleaner.cleanArchive(archiveRoots);
+                    break;
+                case CleanupType::THUMBNAILS:
+                    result = cleaner.cleanThumbnails();
+                    break;
+                case CleanupType::JOURNAL:
+                    result = cleaner.cleanJournal();
+                    break;
                 case CleanupType::ALL:
                     result = cleaner.performFullClean();
                     break;
@@ -250,10 +1014,45 @@ int main(int argc, char* argv[]) {
         
         logger.logCleanupResult(cleanupType, result);
         
+        failureCacheError.clear();
+        if (!cleaner.saveFailureCache(failureCacheError)) {
+            logger.warning(failureCacheError);
+        }
+        
         if (!quiet) {
             printResult(result, operation);
         }
         
+        if (!saveHandlesPath.empty()) {
+            std::string handleError;
+            if (handleList.save(saveHandlesPath, handleError)) {
+                logger.info("Saved " + std::to_string(handleList.size()) + " candidates to " + saveHandlesPath);
+                if (!quiet) {
+                    std::cout << "Saved " << handleList.size() << " candidates to " << saveHandlesPath
+                              << "; delete them with --apply " << saveHandlesPath << "\n";
+                }
+            } else {
+                logger.error(handleError);
+                std::cerr << "Error: " << handleError << "\n";
+            }
+        }
+        
+        if (retentionTarget > 0 && !quiet) {
+            printRetentionAdvice(cleaner, cleanupType, retentionTarget);
+        }
+        
+        if (trimAfterClean && !scanOnly && !dryRun) {
+            trimFilesystems(cleaner.cleanedFilesystems(), trimmer, quiet);
+        }
+        
+        if (PressureMonitor::getInstance().isActive()) {
+            PressureMonitor::getInstance().stop();
+            printPressureSummary();
+        }
+        
+        IoWatchdog::getInstance().stop();
+        printStuckIoSummary(quiet);
+        
         logger.endSession();
         
         return result.success ? 0 : 1;
@@ -0,0 +1,598 @@
+#include "mft_scanner.h"
+#include "config.h"
+#include "utils.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace CClean {
+
+namespace {
+
+const uint64_t ROOT_RECORD = 5;
+const uint64_t RECORD_NUMBER_MASK = 0x0000FFFFFFFFFFFFULL;
+const size_t FIXUP_STRIDE = 512;            // fixups cover 512-byte blocks whatever the sector size
+
+const uint32_t ATTRIBUTE_FILE_NAME = 0x30;
+const uint32_t ATTRIBUTE_DATA = 0x80;
+const uint32_t ATTRIBUTE_END = 0xFFFFFFFF;
+
+const uint16_t RECORD_IN_USE = 0x0001;
+const uint16_t RECORD_IS_DIRECTORY = 0x0002;
+const uint16_t ATTRIBUTE_COMPRESSED = 0x0001;
+const uint16_t ATTRIBUTE_SPARSE = 0x8000;
+
+// On-disk fields are little-endian and unaligned
+uint16_t read16(const char* p) {
+    const unsigned char* b = reinterpret_cast<const unsigned char*>(p);
+    return static_cast<uint16_t>(b[0] | (b[1] << 8));
+}
+
+uint32_t read32(const char* p) {
+    return read16(p) | (static_cast<uint32_t>(read16(p + 2)) << 16);
+}
+
+uint64_t read64(const char* p) {
+    return read32(p) | (static_cast<uint64_t>(read32(p + 4)) << 32);
+}
+
+void appendUtf8(std::string& out, uint32_t c) {
+    if (c < 0x80) {
+        out += static_cast<char>(c);
+    } else if (c < 0x800) {
+        out += static_cast<char>(0xC0 | (c >> 6));
+        out += static_cast<char>(0x80 | (c & 0x3F));
+    } else if (c < 0x10000) {
+        out += static_cast<char>(0xE0 | (c >> 12));
+        out += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (c & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (c >> 18));
+        out += static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (c & 0x3F));
+    }
+}
+
+void appendUtf16(std::string& out, const char* p, size_t units) {
+    for (size_t i = 0; i < units; ++i) {
+        uint32_t c = read16(p + 2 * i);
+        if (c >= 0xD800 && c < 0xDC00 && i + 1 < units) {
+            uint32_t low = read16(p + 2 * (i + 1));
+            if (low >= 0xDC00 && low < 0xE000) {
+                c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+                ++i;
+            }
+        }
+        appendUtf8(out, c);
+    }
+}
+
+char foldCase(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+bool wildcardMatch(const char* pattern, const char* name, size_t nameLength) {
+    const char* end = name + nameLength;
+    const char* starPattern = nullptr;
+    const char* starName = nullptr;
+
+    while (name < end) {
+        if (*pattern == '*') {
+            starPattern = ++pattern;
+            starName = name;
+        } else if (*pattern && (*pattern == '?' || foldCase(*pattern) == foldCase(*name))) {
+            ++pattern;
+            ++name;
+        } else if (starPattern) {
+            pattern = starPattern;
+            name = ++starName;
+        } else {
+            return false;
+        }
+    }
+
+    while (*pattern == '*') {
+        ++pattern;
+    }
+    return *pattern == '\0';
+}
+
+void addTotals(MftTotals& into, const MftTotals& from) {
+    into.files += from.files;
+    into.directories += from.directories;
+    into.bytes += from.bytes;
+    into.allocated += from.allocated;
+}
+
+}
+
+MftScanner::MftScanner()
+    : clusterSize_(0)
+    , recordSize_(0)
+    , sectorSize_(0)
+    , mftOffset_(0)
+    , open_(false)
+#ifdef _WIN32
+    , volume_(INVALID_HANDLE_VALUE)
+#else
+    , fd_(-1)
+#endif
+{
+}
+
+MftScanner::~MftScanner() {
+    close();
+}
+
+#ifdef _WIN32
+
+bool MftScanner::open(const std::string& source, std::string& error) {
+    close();
+
+    // "C:" and "C:\" mean the volume, anything else an image file
+    std::string path = source;
+    if ((source.size() == 2 || (source.size() == 3 && (source[2] == '\\' || source[2] == '/'))) && source[1] == ':') {
+        path = "\\\\.\\" + source.substr(0, 2);
+    }
+
+    HANDLE volume = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (volume == INVALID_HANDLE_VALUE) {
+        error = "Cannot open " + path + ": " + Utils::getLastError();
+        return false;
+    }
+
+    volume_ = volume;
+    open_ = true;
+    return true;
+}
+
+void MftScanner::close() {
+    if (volume_ != INVALID_HANDLE_VALUE) {
+        CloseHandle(volume_);
+        volume_ = INVALID_HANDLE_VALUE;
+    }
+    open_ = false;
+}
+
+bool MftScanner::readAt(uint64_t offset, char* buffer, size_t size, std::string& error) {
+    size_t done = 0;
+    while (done < size) {
+        OVERLAPPED position = {};
+        position.Offset = static_cast<DWORD>(offset + done);
+        position.OffsetHigh = static_cast<DWORD>((offset + done) >> 32);
+
+        DWORD bytesRead = 0;
+        DWORD want = static_cast<DWORD>(std::min<size_t>(size - done, 1u << 30));
+        if (!ReadFile(volume_, buffer + done, want, &bytesRead, &position) || bytesRead == 0) {
+            error = "Cannot read the volume at offset " + std::to_string(offset + done) + ": " + Utils::getLastError();
+            return false;
+        }
+        done += bytesRead;
+    }
+    return true;
+}
+
+#else
+
+bool MftScanner::open(const std::string& source, std::string& error) {
+    close();
+
+    int fd = ::open(source.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        error = "Cannot open " + source + ": " + Utils::getLastError();
+        return false;
+    }
+
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    fd_ = fd;
+    open_ = true;
+    return true;
+}
+
+void MftScanner::close() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    open_ = false;
+}
+
+bool MftScanner::readAt(uint64_t offset, char* buffer, size_t size, std::string& error) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = pread(fd_, buffer + done, size - done, static_cast<off_t>(offset + done));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            error = "Cannot read the volume at offset " + std::to_string(offset + done) + ": " +
+                    (n == 0 ? std::string("unexpected end of file") : Utils::getLastError());
+            return false;
+        }
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+#endif
+
+bool MftScanner::scan(std::string& error) {
+    if (!open_) {
+        error = "No volume is open";
+        return false;
+    }
+
+    // Boot sector: geometry and where the MFT starts. Read a full 4K so the
+    // request stays sector-aligned on 4Kn disks too.
+    std::vector<char> boot(4096);
+    if (!readAt(0, boot.data(), boot.size(), error)) {
+        return false;
+    }
+    if (std::memcmp(boot.data() + 3, "NTFS    ", 8) != 0) {
+        error = "Not an NTFS volume";
+        return false;
+    }
+
+    sectorSize_ = read16(boot.data() + 0x0B);
+    uint8_t sectorsPerCluster = static_cast<uint8_t>(boot[0x0D]);
+    // Values above 0x80 encode 2^(256 - n) sectors, used for clusters over 64K
+    uint64_t clusterSectors = sectorsPerCluster <= 0x80 ? sectorsPerCluster : (1ULL << (256 - sectorsPerCluster));
+    clusterSize_ = clusterSectors * sectorSize_;
+    int8_t recordClusters = static_cast<int8_t>(boot[0x40]);
+    recordSize_ = recordClusters > 0 ? static_cast<uint32_t>(recordClusters * clusterSize_)
+                                     : (1u << static_cast<unsigned>(-recordClusters));
+    mftOffset_ = read64(boot.data() + 0x30) * clusterSize_;
+
+    if (sectorSize_ < 256 || clusterSize_ == 0 || recordSize_ < 1024 || recordSize_ > 65536 ||
+        recordSize_ % FIXUP_STRIDE != 0) {
+        error = "Unsupported NTFS geometry";
+        return false;
+    }
+
+    std::vector<Extent> extents;
+    uint64_t mftSize = 0;
+    if (!readMftExtents(extents, mftSize, error)) {
+        return false;
+    }
+
+    uint64_t recordCount = mftSize / recordSize_;
+    nodes_.assign(static_cast<size_t>(recordCount), Node());
+    names_.clear();
+
+    // The MFT in file order, one large read at a time
+    size_t chunkSize = std::max<size_t>(MFT_READ_CHUNK_SIZE / recordSize_, 1) * recordSize_;
+    chunkSize = (chunkSize + clusterSize_ - 1) / clusterSize_ * clusterSize_;
+    std::vector<char> chunk(chunkSize);
+    uint64_t recordNumber = 0;
+
+    for (const auto& extent : extents) {
+        for (uint64_t done = 0; done < extent.length && recordNumber < recordCount; done += chunkSize) {
+            size_t want = static_cast<size_t>(std::min<uint64_t>(chunkSize, extent.length - done));
+            if (!readAt(extent.offset + done, chunk.data(), want, error)) {
+                return false;
+            }
+            for (size_t offset = 0; offset + recordSize_ <= want && recordNumber < recordCount; offset += recordSize_) {
+                parseRecord(chunk.data() + offset, recordNumber++);
+            }
+        }
+    }
+
+    buildTree();
+    return true;
+}
+
+bool MftScanner::readMftExtents(std::vector<Extent>& extents, uint64_t& mftSize, std::string& error) {
+    std::vector<char> record(std::max<size_t>(recordSize_, sectorSize_));
+    if (!readAt(mftOffset_, record.data(), record.size(), error)) {
+        return false;
+    }
+    if (std::memcmp(record.data(), "FILE", 4) != 0 || !applyFixups(record.data())) {
+        error = "The $MFT record is damaged";
+        return false;
+    }
+
+    // The unnamed $DATA of record 0 is the MFT itself. Its runs are in this
+    // record unless the MFT is fragmented beyond what one record can hold.
+    size_t offset = read16(record.data() + 20);
+    while (offset + 16 <= recordSize_) {
+        const char* attribute = record.data() + offset;
+        uint32_t type = read32(attribute);
+        uint32_t length = read32(attribute + 4);
+        if (type == ATTRIBUTE_END || length < 16 || offset + length > recordSize_) {
+            break;
+        }
+
+        if (type == ATTRIBUTE_DATA && attribute[8] != 0 && attribute[9] == 0 && length >= 64) {
+            mftSize = read64(attribute + 48);
+            size_t run = read16(attribute + 32);
+            int64_t cluster = 0;
+
+            while (run < length && attribute[run] != 0) {
+                uint8_t header = static_cast<uint8_t>(attribute[run]);
+                size_t lengthBytes = header & 0x0F;
+                size_t offsetBytes = header >> 4;
+                if (lengthBytes == 0 || lengthBytes > 8 || offsetBytes > 8 ||
+                    run + 1 + lengthBytes + offsetBytes > length) {
+                    break;
+                }
+
+                uint64_t clusters = 0;
+                for (size_t i = 0; i < lengthBytes; ++i) {
+                    clusters |= static_cast<uint64_t>(static_cast<uint8_t>(attribute[run + 1 + i])) << (8 * i);
+                }
+                // Cluster offsets are signed deltas from the previous run
+                int64_t delta = 0;
+                for (size_t i = 0; i < offsetBytes; ++i) {
+                    delta |= static_cast<int64_t>(static_cast<uint8_t>(attribute[run + 1 + lengthBytes + i])) << (8 * i);
+                }
+                if (offsetBytes > 0 && offsetBytes < 8 && (attribute[run + lengthBytes + offsetBytes] & 0x80)) {
+                    delta -= static_cast<int64_t>(1) << (8 * offsetBytes);
+                }
+
+                if (offsetBytes > 0) {
+                    cluster += delta;
+                    extents.push_back({ static_cast<uint64_t>(cluster) * clusterSize_, clusters * clusterSize_ });
+                }
+                run += 1 + lengthBytes + offsetBytes;
+            }
+            break;
+        }
+        offset += length;
+    }
+
+    if (extents.empty() || mftSize < recordSize_) {
+        error = "Cannot locate the MFT data runs";
+        return false;
+    }
+    return true;
+}
+
+// Every 512-byte block of a record ends in the update sequence number; the
+// real last two bytes are kept in the update sequence array. A mismatch
+// means a torn write.
+bool MftScanner::applyFixups(char* record) const {
+    size_t arrayOffset = read16(record + 4);
+    size_t count = read16(record + 6);
+    if (count == 0 || arrayOffset + 2 * count > recordSize_ || (count - 1) * FIXUP_STRIDE > recordSize_) {
+        return false;
+    }
+
+    uint16_t sequence = read16(record + arrayOffset);
+    for (size_t i = 1; i < count; ++i) {
+        char* blockEnd = record + i * FIXUP_STRIDE - 2;
+        if (read16(blockEnd) != sequence) {
+            return false;
+        }
+        std::memcpy(blockEnd, record + arrayOffset + 2 * i, 2);
+    }
+    return true;
+}
+
+void MftScanner::parseRecord(char* record, uint64_t recordNumber) {
+    if (std::memcmp(record, "FILE", 4) != 0 || !applyFixups(record)) {
+        return;
+    }
+
+    uint16_t flags = read16(record + 22);
+    if (!(flags & RECORD_IN_USE)) {
+        return;
+    }
+
+    // Extension records carry attributes that overflowed their base record
+    uint64_t base = read64(record + 32) & RECORD_NUMBER_MASK;
+    uint64_t target = base != 0 ? base : recordNumber;
+    if (target >= nodes_.size()) {
+        return;
+    }
+
+    Node& node = nodes_[target];
+    if (base == 0) {
+        node.inUse = true;
+        node.directory = (flags & RECORD_IS_DIRECTORY) != 0;
+        node.sequence = read16(record + 16);
+    }
+
+    size_t used = std::min<size_t>(read32(record + 24), recordSize_);
+    size_t offset = read16(record + 20);
+
+    while (offset + 16 <= used) {
+        const char* attribute = record + offset;
+        uint32_t type = read32(attribute);
+        uint32_t length = read32(attribute + 4);
+        if (type == ATTRIBUTE_END || length < 16 || offset + length > used) {
+            break;
+        }
+
+        bool nonResident = attribute[8] != 0;
+
+        if (type == ATTRIBUTE_FILE_NAME && !nonResident && length >= 24) {
+            size_t valueLength = read32(attribute + 16);
+            size_t valueOffset = read16(attribute + 20);
+            const char* value = attribute + valueOffset;
+
+            if (valueOffset + valueLength <= length && valueLength >= 0x42) {
+                size_t nameUnits = static_cast<uint8_t>(value[0x40]);
+                uint8_t nameSpace = static_cast<uint8_t>(value[0x41]);
+                uint8_t rank = nameSpace == 2 ? 1 : (nameSpace == 0 ? 2 : 3);
+
+                if (rank > node.nameRank && 0x42 + 2 * nameUnits <= valueLength) {
+                    uint64_t parent = read64(value);
+                    node.parent = parent & RECORD_NUMBER_MASK;
+                    node.parentSequence = static_cast<uint16_t>(parent >> 48);
+                    node.nameRank = rank;
+                    node.nameOffset = static_cast<uint32_t>(names_.size());
+                    appendUtf16(names_, value + 0x42, nameUnits);
+                    node.nameLength = static_cast<uint16_t>(names_.size() - node.nameOffset);
+                }
+            }
+        } else if (type == ATTRIBUTE_DATA) {
+            if (!nonResident) {
+                node.bytes += read32(attribute + 16);
+            } else if (length >= 64 && read64(attribute + 16) == 0) {
+                // Sizes live in the first extent (starting VCN 0) of each stream
+                uint16_t attributeFlags = read16(attribute + 12);
+                node.bytes += read64(attribute + 48);
+                if ((attributeFlags & (ATTRIBUTE_COMPRESSED | ATTRIBUTE_SPARSE)) && length >= 72) {
+                    node.allocated += read64(attribute + 64);
+                } else {
+                    node.allocated += read64(attribute + 40);
+                }
+            }
+        }
+
+        offset += length;
+    }
+}
+
+void MftScanner::buildTree() {
+    size_t count = nodes_.size();
+
+    // A child hangs off its parent only if the parent is a live directory
+    // whose sequence number still matches, i.e. it was not deleted and reused
+    auto attached = [this, count](uint64_t i) {
+        const Node& node = nodes_[i];
+        if (i == ROOT_RECORD || !node.inUse || node.nameRank == 0 || node.parent >= count) {
+            return false;
+        }
+        const Node& parent = nodes_[node.parent];
+        return parent.inUse && parent.directory && parent.sequence == node.parentSequence;
+    };
+
+    childStart_.assign(count + 1, 0);
+    for (uint64_t i = 0; i < count; ++i) {
+        if (attached(i)) {
+            childStart_[nodes_[i].parent + 1]++;
+        }
+    }
+    for (size_t i = 0; i < count; ++i) {
+        childStart_[i + 1] += childStart_[i];
+    }
+
+    children_.assign(childStart_[count], 0);
+    std::vector<uint64_t> fill(childStart_.begin(), childStart_.end() - 1);
+    for (uint64_t i = 0; i < count; ++i) {
+        if (attached(i)) {
+            children_[fill[nodes_[i].parent]++] = i;
+        }
+    }
+
+    // Post-order from the root; only reachable records get totals
+    totals_.assign(count, MftTotals());
+    if (ROOT_RECORD >= count || !nodes_[ROOT_RECORD].inUse) {
+        return;
+    }
+
+    std::vector<std::pair<uint64_t, uint64_t>> stack;     // node, next child index
+    stack.emplace_back(ROOT_RECORD, childStart_[ROOT_RECORD]);
+
+    while (!stack.empty()) {
+        uint64_t current = stack.back().first;
+        uint64_t& next = stack.back().second;
+
+        if (next < childStart_[current + 1]) {
+            uint64_t child = children_[next++];
+            stack.emplace_back(child, childStart_[child]);
+            continue;
+        }
+
+        stack.pop_back();
+        if (!stack.empty()) {
+            MftTotals& parentTotals = totals_[stack.back().first];
+            addTotals(parentTotals, totals_[current]);
+            addTotals(parentTotals, ownTotals(current));
+        }
+    }
+}
+
+MftTotals MftScanner::ownTotals(uint64_t node) const {
+    MftTotals totals;
+    (nodes_[node].directory ? totals.directories : totals.files) = 1;
+    totals.bytes = nodes_[node].bytes;
+    totals.allocated = nodes_[node].allocated;
+    return totals;
+}
+
+std::string MftScanner::nameOf(uint64_t node) const {
+    return names_.substr(nodes_[node].nameOffset, nodes_[node].nameLength);
+}
+
+std::vector<uint64_t> MftScanner::resolve(const std::string& path) const {
+    std::vector<uint64_t> current;
+    if (ROOT_RECORD >= nodes_.size() || !nodes_[ROOT_RECORD].inUse) {
+        return current;
+    }
+    current.push_back(ROOT_RECORD);
+
+    size_t start = 0;
+    bool first = true;
+    while (start <= path.size()) {
+        size_t end = path.find_first_of("\\/", start);
+        if (end == std::string::npos) {
+            end = path.size();
+        }
+        std::string component = path.substr(start, end - start);
+        start = end + 1;
+
+        // A leading drive letter names the volume itself
+        bool driveLetter = first && component.size() == 2 && component[1] == ':';
+        first = false;
+        if (component.empty() || component == "." || driveLetter) {
+            continue;
+        }
+
+        std::vector<uint64_t> matches;
+        for (uint64_t directory : current) {
+            for (uint64_t i = childStart_[directory]; i < childStart_[directory + 1]; ++i) {
+                const Node& child = nodes_[children_[i]];
+                if (wildcardMatch(component.c_str(), names_.data() + child.nameOffset, child.nameLength)) {
+                    matches.push_back(children_[i]);
+                }
+            }
+        }
+        current.swap(matches);
+        if (current.empty()) {
+            break;
+        }
+    }
+    return current;
+}
+
+bool MftScanner::totalsFor(const std::string& path, MftTotals& totals) const {
+    totals = MftTotals();
+    std::vector<uint64_t> matches = resolve(path);
+
+    for (uint64_t node : matches) {
+        addTotals(totals, totals_[node]);
+        if (!nodes_[node].directory) {
+            addTotals(totals, ownTotals(node));
+        }
+    }
+    return !matches.empty();
+}
+
+bool MftScanner::childrenOf(const std::string& path, std::vector<std::pair<std::string, MftTotals>>& children) const {
+    children.clear();
+    std::vector<uint64_t> matches = resolve(path);
+
+    for (uint64_t directory : matches) {
+        for (uint64_t i = childStart_[directory]; i < childStart_[directory + 1]; ++i) {
+            uint64_t child = children_[i];
+            MftTotals totals = totals_[child];
+            addTotals(totals, ownTotals(child));
+            children.emplace_back(nameOf(child), totals);
+        }
+    }
+    return !matches.empty();
+}
+
+}
@@ -0,0 +1,294 @@
+#include "pressure_monitor.h"
+#include "logger.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace CClean {
+
+namespace {
+
+// Reads the cgroup v2 path of this process ("0::/some/path")
+std::string currentCgroupDirectory() {
+    std::ifstream cgroup("/proc/self/cgroup");
+    std::string line;
+
+    while (std::getline(cgroup, line)) {
+        if (line.compare(0, 3, "0::") == 0) {
+            return "/sys/fs/cgroup" + line.substr(3);
+        }
+    }
+
+    return std::string();
+}
+
+}
+
+PressureMonitor& PressureMonitor::getInstance() {
+    static PressureMonitor instance;
+    return instance;
+}
+
+PressureMonitor::PressureMonitor()
+    : interval_(PRESSURE_SAMPLE_INTERVAL_MS)
+    , state_(State::RUNNING)
+    , severity_(0.0)
+    , active_(false)
+    , stopping_(false)
+    , pausedTime_(0)
+    , slowedTime_(0) {
+}
+
+PressureMonitor::~PressureMonitor() {
+    stop();
+}
+
+bool PressureMonitor::start(const PressureThresholds& thresholds, std::chrono::milliseconds interval) {
+    stop();
+
+    thresholds_ = thresholds;
+    interval_ = interval;
+    pausedTime_ = std::chrono::steady_clock::duration(0);
+    slowedTime_ = std::chrono::steady_clock::duration(0);
+
+    std::string cgroupDir = currentCgroupDirectory();
+    bool haveIo = openSource(ioSource_, cgroupDir.empty() ? "" : cgroupDir + "/io.pressure", "/proc/pressure/io");
+    bool haveMemory = openSource(memorySource_, cgroupDir.empty() ? "" : cgroupDir + "/memory.pressure",
+                                 "/proc/pressure/memory");
+
+    if (!haveIo && !haveMemory) {
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = false;
+    }
+    state_ = State::RUNNING;
+    severity_ = 0.0;
+    active_ = true;
+    sampler_ = std::thread(&PressureMonitor::samplingLoop, this);
+
+    Logger::getInstance().info("Pressure pacing enabled (" + sourceDescription() + ")");
+    return true;
+}
+
+void PressureMonitor::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    stopRequested_.notify_all();
+
+    if (sampler_.joinable()) {
+        sampler_.join();
+    }
+
+    state_ = State::RUNNING;
+    active_ = false;
+    resumed_.notify_all();
+
+#ifndef _WIN32
+    for (Source* source : { &ioSource_, &memorySource_ }) {
+        if (source->fd >= 0) {
+            close(source->fd);
+            source->fd = -1;
+        }
+    }
+#endif
+}
+
+void PressureMonitor::pace() {
+    State current = state_.load(std::memory_order_relaxed);
+    if (current == State::RUNNING) {
+        return;
+    }
+
+    if (current == State::PAUSED) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        resumed_.wait(lock, [this] { return stopping_ || state_.load() != State::PAUSED; });
+        return;
+    }
+
+    // Slowed: give up a share of each sampling interval proportional to how
+    // far the stall percentage is between the slowdown and pause thresholds
+    thread_local auto lastYield = std::chrono::steady_clock::now();
+    auto now = std::chrono::steady_clock::now();
+    if (now - lastYield < interval_) {
+        return;
+    }
+
+    auto delay = std::chrono::duration_cast<std::chrono::microseconds>(interval_ * severity_.load());
+    std::this_thread::sleep_for(delay);
+    lastYield = std::chrono::steady_clock::now();
+}
+
+double PressureMonitor::pausedSeconds() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return std::chrono::duration<double>(pausedTime_).count();
+}
+
+double PressureMonitor::slowedSeconds() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return std::chrono::duration<double>(slowedTime_).count();
+}
+
+std::string PressureMonitor::sourceDescription() const {
+    std::string description;
+    for (const Source* source : { &ioSource_, &memorySource_ }) {
+        if (source->fd >= 0) {
+            description += (description.empty() ? "" : ", ") + source->path;
+        }
+    }
+    return description;
+}
+
+bool PressureMonitor::openSource(Source& source, const std::string& cgroupFile, const std::string& systemFile) {
+#ifdef _WIN32
+    (void)source;
+    (void)cgroupFile;
+    (void)systemFile;
+    return false;
+#else
+    for (const std::string& path : { cgroupFile, systemFile }) {
+        if (path.empty()) {
+            continue;
+        }
+
+        source.fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (source.fd < 0) {
+            continue;
+        }
+
+        source.path = path;
+        if (readStallTotal(source, source.lastTotal)) {
+            return true;
+        }
+
+        close(source.fd);
+        source.fd = -1;
+    }
+
+    return false;
+#endif
+}
+
+bool PressureMonitor::readStallTotal(Source& source, unsigned long long& total) {
+#ifdef _WIN32
+    (void)source;
+    (void)total;
+    return false;
+#else
+    // PSI files are re-read from offset 0; the "some" line comes first:
+    // some avg10=0.00 avg60=0.00 avg300=0.00 total=123456
+    char buffer[256];
+    ssize_t length = pread(source.fd, buffer, sizeof(buffer) - 1, 0);
+    if (length <= 0) {
+        return false;
+    }
+    buffer[length] = '\0';
+
+    if (std::strncmp(buffer, "some", 4) != 0) {
+        return false;
+    }
+
+    const char* field = std::strstr(buffer, "total=");
+    if (!field) {
+        return false;
+    }
+
+    total = std::strtoull(field + 6, nullptr, 10);
+    return true;
+#endif
+}
+
+void PressureMonitor::samplingLoop() {
+    auto lastSample = std::chrono::steady_clock::now();
+
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (stopRequested_.wait_for(lock, interval_, [this] { return stopping_; })) {
+                return;
+            }
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(now - lastSample);
+        lastSample = now;
+        if (elapsed.count() <= 0) {
+            continue;
+        }
+
+        // Stall totals are cumulative microseconds; the delta over the wall
+        // time is the stall share of this interval, far fresher than avg10
+        double stallPercent = 0.0;
+        for (Source* source : { &ioSource_, &memorySource_ }) {
+            unsigned long long total = 0;
+            if (source->fd < 0 || !readStallTotal(*source, total)) {
+                continue;
+            }
+
+            double percent = 100.0 * static_cast<double>(total - source->lastTotal) / elapsed.count();
+            source->lastTotal = total;
+            stallPercent = std::max(stallPercent, percent);
+        }
+
+        State previous = state_.load();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (previous == State::PAUSED) {
+                pausedTime_ += elapsed;
+            } else if (previous == State::SLOWED) {
+                slowedTime_ += elapsed;
+            }
+        }
+
+        updateState(stallPercent);
+    }
+}
+
+void PressureMonitor::updateState(double stallPercent) {
+    State previous = state_.load();
+    State next = previous;
+
+    if (stallPercent >= thresholds_.pausePercent) {
+        next = State::PAUSED;
+    } else if (previous == State::PAUSED && stallPercent > thresholds_.resumePercent) {
+        next = State::PAUSED;
+    } else if (stallPercent >= thresholds_.slowdownPercent) {
+        next = State::SLOWED;
+    } else {
+        next = State::RUNNING;
+    }
+
+    double span = thresholds_.pausePercent - thresholds_.slowdownPercent;
+    double severity = span > 0 ? (stallPercent - thresholds_.slowdownPercent) / span : 1.0;
+    severity_ = std::min(1.0, std::max(0.0, severity));
+
+    if (next == previous) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        state_ = next;
+    }
+
+    if (previous == State::PAUSED) {
+        resumed_.notify_all();
+    }
+
+    if (next == State::PAUSED) {
+        Logger::getInstance().warning("Pausing: pressure stall at " + std::to_string(static_cast<int>(stallPercent)) + "%");
+    } else if (previous == State::PAUSED) {
+        Logger::getInstance().info("Resuming: pressure stall at " + std::to_string(static_cast<int>(stallPercent)) + "%");
+    }
+}
+
+}
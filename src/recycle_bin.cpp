@@ -0,0 +1,338 @@
+#include "recycle_bin.h"
+#include "thread_pool.h"
+#include "tree_remover.h"
+#include "logger.h"
+#include "pressure_monitor.h"
+#include "utils.h"
+#include <algorithm>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+namespace fs = std::filesystem;
+
+namespace CClean {
+
+namespace {
+
+const size_t INFO_HEADER_SIZE = 24;           // version, size, deletion time
+const size_t INFO_V1_PATH_CHARS = 260;        // MAX_PATH wide characters
+const size_t INFO_MAX_RECORD_SIZE = 64 * 1024;
+const int64_t FILETIME_UNIX_EPOCH = 116444736000000000LL;
+const int64_t FILETIME_TICKS_PER_SECOND = 10000000LL;
+
+uint64_t readLittleEndian64(const unsigned char* p) {
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; --i) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+uint32_t readLittleEndian32(const unsigned char* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+void appendUtf8(std::string& out, uint32_t codePoint) {
+    if (codePoint < 0x80) {
+        out += static_cast<char>(codePoint);
+    } else if (codePoint < 0x800) {
+        out += static_cast<char>(0xC0 | (codePoint >> 6));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    } else if (codePoint < 0x10000) {
+        out += static_cast<char>(0xE0 | (codePoint >> 12));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (codePoint >> 18));
+        out += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+}
+
+// Decodes UTF-16LE up to the first NUL or maxChars characters
+std::string utf16ToUtf8(const unsigned char* p, size_t maxChars) {
+    std::string out;
+
+    for (size_t i = 0; i < maxChars; ++i) {
+        uint32_t unit = p[i * 2] | (p[i * 2 + 1] << 8);
+        if (unit == 0) {
+            break;
+        }
+
+        if (unit >= 0xD800 && unit <= 0xDBFF && i + 1 < maxChars) {
+            uint32_t low = p[(i + 1) * 2] | (p[(i + 1) * 2 + 1] << 8);
+            if (low >= 0xDC00 && low <= 0xDFFF) {
+                unit = 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00);
+                i++;
+            } else {
+                unit = 0xFFFD;
+            }
+        } else if (unit >= 0xD800 && unit <= 0xDFFF) {
+            unit = 0xFFFD;
+        }
+
+        appendUtf8(out, unit);
+    }
+
+    return out;
+}
+
+}
+
+RecycleBinCleaner::RecycleBinCleaner(size_t threadCount)
+    : threadCount_(threadCount)
+    , minimumAgeDays_(0)
+    , cutoffTime_(0)
+    , dryRun_(false)
+    , verbose_(false) {
+}
+
+bool RecycleBinCleaner::parseInfoRecord(const std::string& data, RecycleBinEntry& entry) {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data.data());
+    size_t size = data.size();
+
+    if (size < INFO_HEADER_SIZE) {
+        return false;
+    }
+
+    uint64_t version = readLittleEndian64(bytes);
+    entry.size = readLittleEndian64(bytes + 8);
+
+    int64_t fileTime = static_cast<int64_t>(readLittleEndian64(bytes + 16));
+    entry.deletionTime = (fileTime - FILETIME_UNIX_EPOCH) / FILETIME_TICKS_PER_SECOND;
+
+    if (version == 1) {
+        size_t available = (size - INFO_HEADER_SIZE) / 2;
+        entry.originalPath = utf16ToUtf8(bytes + INFO_HEADER_SIZE, std::min(available, INFO_V1_PATH_CHARS));
+        return true;
+    }
+
+    if (version == 2) {
+        if (size < INFO_HEADER_SIZE + 4) {
+            return false;
+        }
+        size_t pathChars = readLittleEndian32(bytes + INFO_HEADER_SIZE);
+        size_t available = (size - INFO_HEADER_SIZE - 4) / 2;
+        if (pathChars > available) {
+            return false;
+        }
+        entry.originalPath = utf16ToUtf8(bytes + INFO_HEADER_SIZE + 4, pathChars);
+        return true;
+    }
+
+    return false;
+}
+
+bool RecycleBinCleaner::parseInfoFile(const std::string& infoPath, RecycleBinEntry& entry) {
+    std::ifstream file(infoPath, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+
+    std::string data(INFO_MAX_RECORD_SIZE, '\0');
+    file.read(&data[0], static_cast<std::streamsize>(data.size()));
+    data.resize(static_cast<size_t>(file.gcount()));
+
+    if (!parseInfoRecord(data, entry)) {
+        return false;
+    }
+
+    fs::path info(infoPath);
+    std::string dataName = info.filename().string();
+    dataName[1] = 'R';
+
+    entry.infoPath = infoPath;
+    entry.dataPath = (info.parent_path() / dataName).string();
+    return true;
+}
+
+bool RecycleBinCleaner::scan(const std::string& rootPath) {
+    entries_.clear();
+    result_ = CleanupResult();
+    cutoffTime_ = minimumAgeDays_ > 0
+        ? static_cast<int64_t>(std::time(nullptr)) - static_cast<int64_t>(minimumAgeDays_) * 86400
+        : 0;
+
+    std::vector<std::string> userFolders;
+    std::error_code ec;
+    fs::directory_iterator it(rootPath, fs::directory_options::skip_permission_denied, ec);
+
+    for (; !ec && it != fs::directory_iterator(); it.increment(ec)) {
+        std::error_code statEc;
+        std::string name = it->path().filename().string();
+        if (it->is_directory(statEc) && name.compare(0, 2, "S-") == 0) {
+            userFolders.push_back(it->path().string());
+        }
+    }
+
+    if (userFolders.empty()) {
+        return false;
+    }
+
+    ThreadPool pool(std::min(userFolders.size(), threadCount_ ? threadCount_ : ThreadPool::defaultThreadCount()));
+
+    for (const auto& sidPath : userFolders) {
+        pool.submit([this, sidPath] {
+            std::vector<RecycleBinEntry> found;
+            scanUserFolder(sidPath, found);
+
+            std::lock_guard<std::mutex> lock(resultMutex_);
+            entries_.insert(entries_.end(), std::make_move_iterator(found.begin()),
+                            std::make_move_iterator(found.end()));
+        });
+    }
+    pool.wait();
+
+    for (const auto& entry : entries_) {
+        if (isEligible(entry)) {
+            result_.filesScanned++;
+            result_.bytesFreed += entry.size;
+        }
+    }
+
+    return true;
+}
+
+void RecycleBinCleaner::scanUserFolder(const std::string& sidPath, std::vector<RecycleBinEntry>& entries) {
+    std::error_code ec;
+    fs::directory_iterator it(sidPath, fs::directory_options::skip_permission_denied, ec);
+
+    for (; !ec && it != fs::directory_iterator(); it.increment(ec)) {
+        PressureMonitor::getInstance().pace();
+
+        std::string name = it->path().filename().string();
+        if (name.size() < 3 || name.compare(0, 2, "$I") != 0) {
+            continue;
+        }
+
+        RecycleBinEntry entry;
+        if (parseInfoFile(it->path().string(), entry)) {
+            entries.push_back(std::move(entry));
+        } else if (verbose_) {
+            Logger::getInstance().debug("Skipping unreadable recycle record: " + it->path().string());
+        }
+    }
+}
+
+CleanupResult RecycleBinCleaner::scanResult() const {
+    return result_;
+}
+
+CleanupResult RecycleBinCleaner::purge() {
+    CleanupResult scanned = result_;
+    result_ = CleanupResult();
+    result_.filesScanned = scanned.filesScanned;
+
+    std::vector<const RecycleBinEntry*> eligible;
+    for (const auto& entry : entries_) {
+        if (isEligible(entry)) {
+            eligible.push_back(&entry);
+        }
+    }
+
+    if (dryRun_) {
+        for (const auto* entry : eligible) {
+            if (verbose_) {
+                Logger::getInstance().debug("DRY RUN: Would delete " + entry->originalPath + " (" +
+                                            Utils::formatBytes(entry->size) + ")");
+            }
+            result_.filesDeleted++;
+            result_.bytesFreed += entry->size;
+        }
+        return result_;
+    }
+
+    ThreadPool pool(threadCount_);
+    for (const auto* entry : eligible) {
+        pool.submit([this, entry] { purgeEntry(*entry); });
+    }
+    pool.wait();
+
+    // Deleted folders go through one tree remover, all of them fanned out
+    // together, rather than one single-threaded remove_all each
+    if (!pendingDirectories_.empty()) {
+        std::vector<std::string> paths;
+        for (const auto* entry : pendingDirectories_) {
+            paths.push_back(entry->dataPath);
+        }
+
+        TreeRemover remover(threadCount_);
+        remover.setCountBytes(false);
+        CleanupResult removed = remover.remove(paths);
+
+        for (const auto* entry : pendingDirectories_) {
+            std::error_code ec;
+            bool remaining = fs::exists(fs::symlink_status(entry->dataPath, ec));
+            finishEntry(*entry, remaining ? "Failed to delete " + entry->dataPath + ": " + removed.errorMessage : "");
+        }
+        pendingDirectories_.clear();
+    }
+
+    return result_;
+}
+
+void RecycleBinCleaner::purgeEntry(const RecycleBinEntry& entry) {
+    PressureMonitor::getInstance().pace();
+
+    std::error_code ec;
+    if (fs::is_directory(fs::symlink_status(entry.dataPath, ec))) {
+        std::lock_guard<std::mutex> lock(resultMutex_);
+        pendingDirectories_.push_back(&entry);
+        return;
+    }
+
+    fs::remove(entry.dataPath, ec);
+    finishEntry(entry, ec ? "Failed to delete " + entry.dataPath + ": " + ec.message() : "");
+}
+
+void RecycleBinCleaner::finishEntry(const RecycleBinEntry& entry, std::string error) {
+    // Payload first: a dangling $I only shows as a ghost entry, while a
+    // dangling $R is invisible and leaks space
+    if (error.empty()) {
+        std::error_code ec;
+        fs::remove(entry.infoPath, ec);
+        if (ec) {
+            error = "Failed to delete " + entry.infoPath + ": " + ec.message();
+        }
+    }
+
+    if (!error.empty()) {
+        Logger::getInstance().warning(error);
+
+        std::lock_guard<std::mutex> lock(resultMutex_);
+        if (result_.errorMessage.empty()) {
+            result_.errorMessage = error;
+        }
+        return;
+    }
+
+    if (verbose_) {
+        Logger::getInstance().debug("Deleted: " + entry.originalPath + " (" + Utils::formatBytes(entry.size) + ")");
+    }
+
+    std::lock_guard<std::mutex> lock(resultMutex_);
+    result_.filesDeleted++;
+    result_.bytesFreed += entry.size;
+}
+
+bool RecycleBinCleaner::isEligible(const RecycleBinEntry& entry) const {
+    return cutoffTime_ == 0 || entry.deletionTime < cutoffTime_;
+}
+
+void RecycleBinCleaner::setMinimumAgeDays(int days) {
+    minimumAgeDays_ = days > 0 ? days : 0;
+}
+
+void RecycleBinCleaner::setDryRun(bool enabled) {
+    dryRun_ = enabled;
+}
+
+void RecycleBinCleaner::setVerbose(bool enabled) {
+    verbose_ = enabled;
+}
+
+}
@@ -0,0 +1,326 @@
+#include "sparsifier.h"
+#include "io_throttle.h"
+#include "logger.h"
+#include "pressure_monitor.h"
+#include "thread_pool.h"
+#include "utils.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace CClean {
+
+Sparsifier::Sparsifier(size_t threadCount)
+    : threadCount_(threadCount)
+    , minimumFileSize_(SPARSIFY_MIN_FILE_SIZE)
+    , throttle_(nullptr)
+    , dryRun_(false)
+    , verbose_(false) {
+}
+
+void Sparsifier::setMinimumFileSize(size_t bytes) {
+    minimumFileSize_ = bytes;
+}
+
+void Sparsifier::setThrottle(IoThrottle* throttle) {
+    throttle_ = throttle;
+}
+
+void Sparsifier::setDryRun(bool enabled) {
+    dryRun_ = enabled;
+}
+
+void Sparsifier::setVerbose(bool enabled) {
+    verbose_ = enabled;
+}
+
+bool Sparsifier::isZeroBlock(const char* data, size_t size) {
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    for (; i + 128 <= size; i += 128) {
+        const __m256i* p = reinterpret_cast<const __m256i*>(data + i);
+        __m256i acc = _mm256_or_si256(_mm256_or_si256(_mm256_loadu_si256(p), _mm256_loadu_si256(p + 1)),
+                                      _mm256_or_si256(_mm256_loadu_si256(p + 2), _mm256_loadu_si256(p + 3)));
+        if (!_mm256_testz_si256(acc, acc)) {
+            return false;
+        }
+    }
+#elif defined(__SSE2__) || defined(_M_X64)
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 64 <= size; i += 64) {
+        const __m128i* p = reinterpret_cast<const __m128i*>(data + i);
+        __m128i acc = _mm_or_si128(_mm_or_si128(_mm_loadu_si128(p), _mm_loadu_si128(p + 1)),
+                                   _mm_or_si128(_mm_loadu_si128(p + 2), _mm_loadu_si128(p + 3)));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(acc, zero)) != 0xFFFF) {
+            return false;
+        }
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 64 <= size; i += 64) {
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(data + i);
+        uint8x16_t acc = vorrq_u8(vorrq_u8(vld1q_u8(p), vld1q_u8(p + 16)),
+                                  vorrq_u8(vld1q_u8(p + 32), vld1q_u8(p + 48)));
+        if (vmaxvq_u8(acc) != 0) {
+            return false;
+        }
+    }
+#endif
+
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        if (word != 0) {
+            return false;
+        }
+    }
+
+    for (; i < size; ++i) {
+        if (data[i] != 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+CleanupResult Sparsifier::process(const std::vector<std::string>& rootPaths, bool cleanMode) {
+    result_ = CleanupResult();
+
+    std::vector<std::pair<size_t, std::string>> candidates;
+    for (const auto& rootPath : rootPaths) {
+        collectCandidates(rootPath, candidates);
+    }
+
+    // Largest first so one huge image doesn't start last and run alone
+    std::sort(candidates.begin(), candidates.end(),
+              [](const auto& a, const auto& b) { return a.first > b.first; });
+
+    bool punch = cleanMode && !dryRun_;
+    size_t filesSparsified = 0;
+
+    ThreadPool pool(threadCount_);
+    for (const auto& candidate : candidates) {
+        std::string filePath = candidate.second;
+
+        pool.submit([this, filePath, punch, &filesSparsified] {
+            FileResult fileResult;
+            std::string error;
+            bool ok = sparsifyFile(filePath, punch, fileResult, error);
+
+            if (!ok) {
+                Logger::getInstance().warning(error);
+            } else if (verbose_ && fileResult.zeroBytes > 0) {
+                Logger::getInstance().debug(std::string(punch ? "Sparsified: " : "Zero-filled: ") + filePath + " (" +
+                                            Utils::formatBytes(punch ? fileResult.bytesReturned : fileResult.zeroBytes) + ")");
+            }
+
+            std::lock_guard<std::mutex> lock(resultMutex_);
+            result_.filesScanned++;
+            result_.bytesFreed += punch ? fileResult.bytesReturned : fileResult.zeroBytes;
+            if (fileResult.zeroBytes > 0) {
+                filesSparsified++;
+            }
+            if (!ok && result_.errorMessage.empty()) {
+                result_.errorMessage = error;
+            }
+        });
+    }
+    pool.wait();
+
+    Logger::getInstance().info(std::string(punch ? "Sparsified " : "Found zero-filled regions in ") +
+                              std::to_string(filesSparsified) + " of " + std::to_string(candidates.size()) +
+                              " large files (" + Utils::formatBytes(result_.bytesFreed) +
+                              (punch ? " returned)" : " reclaimable)"));
+
+    return result_;
+}
+
+void Sparsifier::collectCandidates(const std::string& rootPath, std::vector<std::pair<size_t, std::string>>& candidates) {
+    std::error_code ec;
+
+    if (fs::is_regular_file(rootPath, ec)) {
+        size_t size = static_cast<size_t>(fs::file_size(rootPath, ec));
+        if (!ec && size >= minimumFileSize_) {
+            candidates.emplace_back(size, rootPath);
+        }
+        return;
+    }
+
+    fs::recursive_directory_iterator it(rootPath, fs::directory_options::skip_permission_denied, ec);
+    for (; !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+        PressureMonitor::getInstance().pace();
+
+        std::error_code statEc;
+        if (it->is_symlink(statEc) || !it->is_regular_file(statEc)) {
+            continue;
+        }
+
+        size_t size = static_cast<size_t>(it->file_size(statEc));
+        if (!statEc && size >= minimumFileSize_) {
+            candidates.emplace_back(size, it->path().string());
+        }
+    }
+}
+
+#ifdef __linux__
+
+bool Sparsifier::sparsifyFile(const std::string& filePath, bool punch, FileResult& fileResult, std::string& error) {
+    int fd = open(filePath.c_str(), (punch ? O_RDWR : O_RDONLY) | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) {
+        error = "Cannot open " + filePath + ": " + std::strerror(errno);
+        return false;
+    }
+
+    struct stat before;
+    if (fstat(fd, &before) != 0 || !S_ISREG(before.st_mode)) {
+        close(fd);
+        return true;
+    }
+
+    if (std::time(nullptr) - before.st_mtime < SPARSIFY_MIN_IDLE_SECONDS) {
+        if (verbose_) {
+            Logger::getInstance().debug("Skipping recently modified file: " + filePath);
+        }
+        close(fd);
+        return true;
+    }
+
+    if (punch) {
+        // Any other holder of a POSIX, OFD or flock lock is presumably writing
+        struct flock lock = {};
+        lock.l_type = F_WRLCK;
+        lock.l_whence = SEEK_SET;
+        bool locked = fcntl(fd, F_OFD_SETLK, &lock) == 0 || errno == EINVAL;
+        if (!locked || flock(fd, LOCK_EX | LOCK_NB) != 0) {
+            if (verbose_) {
+                Logger::getInstance().debug("Skipping locked file: " + filePath);
+            }
+            close(fd);
+            return true;
+        }
+    }
+
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    size_t blockSize = std::max<size_t>(static_cast<size_t>(before.st_blksize), 4096);
+    size_t chunkSize = std::max(blockSize, SPARSIFY_READ_SIZE / blockSize * blockSize);
+    std::vector<char> buffer(chunkSize);
+
+    off_t fileSize = before.st_size;
+    off_t runStart = -1;
+    bool ok = true;
+
+    auto flushRun = [&](off_t runEnd) {
+        if (runStart < 0) {
+            return;
+        }
+        off_t length = runEnd - runStart;
+        off_t start = runStart;
+        runStart = -1;
+
+        if (length < static_cast<off_t>(SPARSIFY_MIN_HOLE_SIZE)) {
+            return;
+        }
+
+        fileResult.zeroBytes += static_cast<size_t>(length);
+        if (punch && ok && fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, start, length) != 0) {
+            error = "Cannot punch hole in " + filePath + ": " + std::strerror(errno);
+            ok = false;
+        }
+    };
+
+    off_t position = 0;
+    while (ok && position < fileSize) {
+        off_t dataStart = lseek(fd, position, SEEK_DATA);
+        if (dataStart < 0) {
+            break;  // ENXIO: only a hole remains
+        }
+
+        off_t dataEnd = lseek(fd, dataStart, SEEK_HOLE);
+        if (dataEnd < 0) {
+            dataEnd = fileSize;
+        }
+
+        for (off_t offset = dataStart; ok && offset < dataEnd;) {
+            PressureMonitor::getInstance().pace();
+
+            size_t length = static_cast<size_t>(std::min<off_t>(static_cast<off_t>(chunkSize), dataEnd - offset));
+            if (throttle_) {
+                throttle_->acquire(length);
+            }
+
+            ssize_t bytesRead = pread(fd, buffer.data(), length, offset);
+            if (bytesRead <= 0) {
+                if (bytesRead < 0) {
+                    error = "Cannot read " + filePath + ": " + std::strerror(errno);
+                    ok = false;
+                }
+                break;
+            }
+
+            // Only whole blocks can be deallocated; a partial tail breaks the run
+            for (size_t blockOffset = 0; blockOffset < static_cast<size_t>(bytesRead); blockOffset += blockSize) {
+                size_t blockLength = std::min(blockSize, static_cast<size_t>(bytesRead) - blockOffset);
+                off_t blockStart = offset + static_cast<off_t>(blockOffset);
+
+                if (blockLength == blockSize && isZeroBlock(buffer.data() + blockOffset, blockLength)) {
+                    if (runStart < 0) {
+                        runStart = blockStart;
+                    }
+                } else {
+                    flushRun(blockStart);
+                }
+            }
+
+            posix_fadvise(fd, offset, bytesRead, POSIX_FADV_DONTNEED);
+            offset += bytesRead;
+        }
+
+        flushRun(dataEnd);
+        position = dataEnd;
+    }
+
+    if (punch) {
+        struct stat after;
+        if (fstat(fd, &after) == 0 && after.st_blocks < before.st_blocks) {
+            fileResult.bytesReturned = static_cast<size_t>(before.st_blocks - after.st_blocks) * 512;
+        }
+
+        // Punching counts as a modification; the contents did not change
+        struct timespec times[2] = { before.st_atim, before.st_mtim };
+        futimens(fd, times);
+    }
+
+    close(fd);
+    return ok;
+}
+
+#else
+
+bool Sparsifier::sparsifyFile(const std::string& filePath, bool punch, FileResult& fileResult, std::string& error) {
+    (void)punch;
+    (void)fileResult;
+    error = "Sparsify is only supported on Linux: " + filePath;
+    return false;
+}
+
+#endif
+
+}
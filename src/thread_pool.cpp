@@ -0,0 +1,202 @@
+#include "thread_pool.h"
+#include "utils.h"
+
+namespace CClean {
+
+// Shared between the pool and its worker threads, so a worker that was
+// abandoned in a blocked call can still return into valid state after the
+// pool itself is gone.
+struct ThreadPool::State {
+    std::mutex mutex;
+    std::queue<std::function<void()>> tasks;
+    std::condition_variable taskAvailable;
+    std::condition_variable allDone;
+    std::condition_variable workerExited;
+    std::vector<std::shared_ptr<Worker>> workers;
+    size_t activeTasks = 0;
+    size_t liveWorkers = 0;
+    uint64_t nextTaskId = 1;
+    bool stopping = false;
+};
+
+struct ThreadPool::Worker {
+    std::thread thread;
+    std::weak_ptr<State> pool;
+    bool busy = false;
+    bool abandoned = false;
+    uint64_t taskId = 0;        // of the running task, while busy
+};
+
+namespace {
+thread_local std::shared_ptr<ThreadPool::Worker> currentWorker_;
+thread_local uint64_t currentTaskId_ = 0;
+}
+
+ThreadPool::ThreadPool(size_t threadCount)
+    : state_(std::make_shared<State>())
+    , threadCount_(threadCount) {
+    if (threadCount_ == 0) {
+        threadCount_ = defaultThreadCount();
+    }
+
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    state_->workers.reserve(threadCount_);
+    for (size_t i = 0; i < threadCount_; ++i) {
+        startWorker(state_);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    std::vector<std::shared_ptr<Worker>> workers;
+    {
+        std::unique_lock<std::mutex> lock(state_->mutex);
+        state_->stopping = true;
+        state_->taskAvailable.notify_all();
+        // Not join(): a worker may be abandoned while we wait for it
+        state_->workerExited.wait(lock, [this] { return state_->liveWorkers == 0; });
+        workers.swap(state_->workers);
+    }
+
+    for (auto& worker : workers) {
+        if (worker->abandoned) {
+            worker->thread.detach();
+        } else if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    enqueue(state_, std::move(task));
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(state_->mutex);
+    state_->allDone.wait(lock, [this] { return state_->tasks.empty() && state_->activeTasks == 0; });
+}
+
+ThreadPool::Submitter ThreadPool::submitter() {
+    std::weak_ptr<State> pool = state_;
+    return [pool](std::function<void()> task) {
+        if (auto state = pool.lock()) {
+            enqueue(state, std::move(task));
+        }
+    };
+}
+
+size_t ThreadPool::size() const {
+    return threadCount_;
+}
+
+size_t ThreadPool::defaultThreadCount() {
+    // Sized from the CPUs we may actually use, not every core on the machine
+    size_t count = Utils::allowedCpus().size();
+    if (count == 0) {
+        count = std::thread::hardware_concurrency();
+    }
+    return count > 0 ? count : 4;
+}
+
+std::shared_ptr<ThreadPool::Worker> ThreadPool::currentWorker() {
+    return currentWorker_;
+}
+
+uint64_t ThreadPool::currentTaskId() {
+    return currentTaskId_;
+}
+
+void ThreadPool::abandon(const std::shared_ptr<Worker>& worker, uint64_t taskId) {
+    std::shared_ptr<State> state = worker ? worker->pool.lock() : nullptr;
+    if (!state) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(state->mutex);
+    if (!worker->busy || worker->abandoned || worker->taskId != taskId) {
+        return;
+    }
+
+    worker->abandoned = true;
+    worker->busy = false;
+    state->activeTasks--;
+    state->liveWorkers--;
+
+    if (!state->stopping) {
+        startWorker(state);
+    }
+    if (state->tasks.empty() && state->activeTasks == 0) {
+        state->allDone.notify_all();
+    }
+    state->workerExited.notify_all();
+}
+
+// Called with the state mutex held
+void ThreadPool::startWorker(const std::shared_ptr<State>& state) {
+    auto worker = std::make_shared<Worker>();
+    worker->pool = state;
+    state->workers.push_back(worker);
+    state->liveWorkers++;
+    worker->thread = std::thread(&ThreadPool::workerLoop, state, worker);
+}
+
+void ThreadPool::enqueue(const std::shared_ptr<State>& state, std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if (state->stopping) {
+            return;
+        }
+        state->tasks.push(std::move(task));
+    }
+    state->taskAvailable.notify_one();
+}
+
+void ThreadPool::workerLoop(std::shared_ptr<State> state, std::shared_ptr<Worker> worker) {
+    currentWorker_ = worker;
+
+    for (;;) {
+        std::function<void()> task;
+
+        {
+            std::unique_lock<std::mutex> lock(state->mutex);
+            state->taskAvailable.wait(lock, [&] { return state->stopping || !state->tasks.empty(); });
+
+            if (state->stopping && state->tasks.empty()) {
+                state->liveWorkers--;
+                state->workerExited.notify_all();
+                break;
+            }
+
+            task = std::move(state->tasks.front());
+            state->tasks.pop();
+            state->activeTasks++;
+            worker->busy = true;
+            worker->taskId = state->nextTaskId++;
+            currentTaskId_ = worker->taskId;
+        }
+
+        try {
+            task();
+        } catch (const std::exception&) {
+            // Tasks report their own failures; never let one kill a worker
+        }
+        task = nullptr;
+        currentTaskId_ = 0;
+
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (worker->abandoned) {
+                // A replacement already took our place and our task was written off
+                break;
+            }
+            worker->busy = false;
+            state->activeTasks--;
+            if (state->tasks.empty() && state->activeTasks == 0) {
+                state->allDone.notify_all();
+            }
+        }
+    }
+
+    currentWorker_.reset();
+}
+
+}
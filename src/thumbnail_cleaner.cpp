@@ -0,0 +1,323 @@
+#include "thumbnail_cleaner.h"
+#include "logger.h"
+#include "pressure_monitor.h"
+#include "thread_pool.h"
+#include "utils.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace fs = std::filesystem;
+
+namespace CClean {
+
+namespace {
+
+const unsigned char PNG_SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+const char URI_KEYWORD[] = "Thumb::URI";
+
+uint32_t readBigEndian32(const char* p) {
+    const unsigned char* b = reinterpret_cast<const unsigned char*>(p);
+    return (static_cast<uint32_t>(b[0]) << 24) | (static_cast<uint32_t>(b[1]) << 16) |
+           (static_cast<uint32_t>(b[2]) << 8) | b[3];
+}
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+bool isOnRemovableMount(const std::string& path) {
+    for (const auto& prefix : THUMBNAIL_REMOVABLE_MOUNTS) {
+        if (path.compare(0, prefix.size(), prefix) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool isNotFound(const std::error_code& ec) {
+    return ec == std::errc::no_such_file_or_directory || ec == std::errc::not_a_directory;
+}
+
+}
+
+ThumbnailCleaner::ThumbnailCleaner(size_t threadCount)
+    : threadCount_(threadCount)
+    , dryRun_(false)
+    , verbose_(false) {
+}
+
+void ThumbnailCleaner::setFileFilter(FileFilter filter) {
+    filter_ = std::move(filter);
+}
+
+void ThumbnailCleaner::setDryRun(bool enabled) {
+    dryRun_ = enabled;
+}
+
+void ThumbnailCleaner::setVerbose(bool enabled) {
+    verbose_ = enabled;
+}
+
+std::vector<std::string> ThumbnailCleaner::defaultRoots() {
+    std::vector<std::string> roots;
+#ifndef _WIN32
+    const char* cacheHome = std::getenv("XDG_CACHE_HOME");
+    const char* home = std::getenv("HOME");
+
+    if (cacheHome && *cacheHome) {
+        roots.push_back(std::string(cacheHome) + "/thumbnails");
+    } else if (home && *home) {
+        roots.push_back(std::string(home) + "/.cache/thumbnails");
+    }
+    if (home && *home) {
+        roots.push_back(std::string(home) + "/.thumbnails");
+    }
+#endif
+    return roots;
+}
+
+bool ThumbnailCleaner::readSourceUri(const std::string& thumbnailPath, std::string& uri) {
+    std::ifstream in(thumbnailPath, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+
+    // Thumbnailers write their text chunks right after IHDR, so the first
+    // read nearly always holds the URI; more is read only while the chunks
+    // in front of the image data continue past what we have
+    std::vector<char> buffer;
+    size_t available = 0;
+    auto ensure = [&](size_t end) {
+        if (end <= available) {
+            return true;
+        }
+        if (end > THUMBNAIL_HEADER_READ_LIMIT || !in) {
+            return false;
+        }
+        buffer.resize(std::min(std::max(end, available + THUMBNAIL_HEADER_READ_SIZE), THUMBNAIL_HEADER_READ_LIMIT));
+        in.read(buffer.data() + available, static_cast<std::streamsize>(buffer.size() - available));
+        available += static_cast<size_t>(in.gcount());
+        return end <= available;
+    };
+
+    if (!ensure(sizeof(PNG_SIGNATURE)) || std::memcmp(buffer.data(), PNG_SIGNATURE, sizeof(PNG_SIGNATURE)) != 0) {
+        return false;
+    }
+
+    size_t offset = sizeof(PNG_SIGNATURE);
+    while (ensure(offset + 8)) {
+        size_t length = readBigEndian32(buffer.data() + offset);
+        const char* type = buffer.data() + offset + 4;
+        size_t chunkEnd = offset + 8 + length + 4;
+
+        if (std::memcmp(type, "IDAT", 4) == 0 || std::memcmp(type, "IEND", 4) == 0) {
+            break;
+        }
+
+        bool internationalText = std::memcmp(type, "iTXt", 4) == 0;
+        if (internationalText || std::memcmp(type, "tEXt", 4) == 0) {
+            if (!ensure(chunkEnd)) {
+                break;
+            }
+            const char* data = buffer.data() + offset + 8;
+            const char* end = data + length;
+            size_t keywordLength = sizeof(URI_KEYWORD) - 1;
+
+            if (length > keywordLength && std::memcmp(data, URI_KEYWORD, keywordLength) == 0 &&
+                data[keywordLength] == '\0') {
+                const char* value = data + keywordLength + 1;
+                if (internationalText) {
+                    // Compression flag and method, then language tag and
+                    // translated keyword, each NUL-terminated
+                    if (end - value < 2 || value[0] != 0) {
+                        return false;
+                    }
+                    value += 2;
+                    for (int field = 0; field < 2; ++field) {
+                        value = static_cast<const char*>(std::memchr(value, '\0', end - value));
+                        if (!value) {
+                            return false;
+                        }
+                        ++value;
+                    }
+                }
+                uri.assign(value, end);
+                return true;
+            }
+        }
+        offset = chunkEnd;
+    }
+    return false;
+}
+
+bool ThumbnailCleaner::uriToPath(const std::string& uri, std::string& path) {
+    const std::string scheme = "file://";
+    if (uri.compare(0, scheme.size(), scheme) != 0) {
+        return false;
+    }
+
+    size_t pathStart = uri.find('/', scheme.size());
+    if (pathStart == std::string::npos) {
+        return false;
+    }
+    std::string host = uri.substr(scheme.size(), pathStart - scheme.size());
+    if (!host.empty() && host != "localhost") {
+        return false;
+    }
+
+    path.clear();
+    path.reserve(uri.size() - pathStart);
+    for (size_t i = pathStart; i < uri.size(); ++i) {
+        if (uri[i] == '%' && i + 2 < uri.size() && hexValue(uri[i + 1]) >= 0 && hexValue(uri[i + 2]) >= 0) {
+            path += static_cast<char>(hexValue(uri[i + 1]) * 16 + hexValue(uri[i + 2]));
+            i += 2;
+        } else {
+            path += uri[i];
+        }
+    }
+    return true;
+}
+
+CleanupResult ThumbnailCleaner::process(const std::vector<std::string>& rootPaths, bool cleanMode) {
+    result_ = CleanupResult();
+
+    std::vector<Thumbnail> thumbnails;
+    for (const auto& rootPath : rootPaths) {
+        collectThumbnails(rootPath, thumbnails);
+    }
+
+    ThreadPool pool(threadCount_);
+
+    for (auto& thumbnail : thumbnails) {
+        Thumbnail* entry = &thumbnail;
+        pool.submit([entry] {
+            PressureMonitor::getInstance().pace();
+            std::string uri;
+            if (!readSourceUri(entry->path, uri) || !uriToPath(uri, entry->sourcePath)) {
+                entry->sourcePath.clear();
+            }
+        });
+    }
+    pool.wait();
+
+    // One existence check task per source directory
+    std::unordered_map<std::string, std::vector<Thumbnail*>> byDirectory;
+    for (auto& thumbnail : thumbnails) {
+        if (!thumbnail.sourcePath.empty()) {
+            byDirectory[fs::path(thumbnail.sourcePath).parent_path().string()].push_back(&thumbnail);
+        }
+    }
+    for (auto& group : byDirectory) {
+        auto* entry = &group;
+        pool.submit([this, entry] { checkSources(entry->first, entry->second); });
+    }
+    pool.wait();
+
+    bool remove = cleanMode && !dryRun_;
+
+    for (auto& thumbnail : thumbnails) {
+        if (thumbnail.state != SourceState::MISSING) {
+            continue;
+        }
+
+        Thumbnail* entry = &thumbnail;
+        pool.submit([this, entry, cleanMode, remove] {
+            if (filter_ && !filter_(entry->path)) {
+                return;
+            }
+            size_t size = Utils::getFileSize(entry->path);
+            bool deleted = remove && Utils::deleteFileSecure(entry->path);
+            std::string error;
+            if (remove && !deleted) {
+                error = "Failed to delete " + entry->path + ": " + Utils::getLastError();
+                Logger::getInstance().warning(error);
+            } else if (verbose_) {
+                Logger::getInstance().debug(std::string(remove ? "Deleted" : "Orphaned") + " thumbnail: " +
+                                            entry->path + " (source " + entry->sourcePath + ")");
+            }
+
+            std::lock_guard<std::mutex> lock(resultMutex_);
+            result_.filesScanned++;
+            if (remove ? deleted : true) {
+                result_.bytesFreed += size;
+                if (cleanMode) {
+                    result_.filesDeleted++;
+                }
+            }
+            if (!error.empty() && result_.errorMessage.empty()) {
+                result_.errorMessage = error;
+            }
+        });
+    }
+    pool.wait();
+
+    Logger::getInstance().info("Thumbnails: " + std::to_string(result_.filesScanned) + " of " + std::to_string(thumbnails.size()) +
+                               " point at files that no longer exist (" + Utils::formatBytes(result_.bytesFreed) +
+                               (remove ? " freed)" : " reclaimable)"));
+    return result_;
+}
+
+void ThumbnailCleaner::collectThumbnails(const std::string& rootPath, std::vector<Thumbnail>& thumbnails) {
+    std::error_code ec;
+    fs::recursive_directory_iterator it(rootPath, fs::directory_options::skip_permission_denied, ec);
+
+    for (; !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+        std::error_code statEc;
+        if (it->is_regular_file(statEc) && !it->is_symlink(statEc) && it->path().extension() == ".png") {
+            Thumbnail thumbnail;
+            thumbnail.path = it->path().string();
+            thumbnails.push_back(std::move(thumbnail));
+        }
+    }
+}
+
+void ThumbnailCleaner::checkSources(const std::string& directory, std::vector<Thumbnail*>& thumbnails) {
+    PressureMonitor::getInstance().pace();
+    std::error_code ec;
+
+    if (thumbnails.size() < THUMBNAIL_LIST_DIRECTORY_MIN) {
+        for (auto* thumbnail : thumbnails) {
+            fs::file_status status = fs::symlink_status(thumbnail->sourcePath, ec);
+            if (fs::exists(status)) {
+                thumbnail->state = SourceState::EXISTS;
+            } else if ((status.type() == fs::file_type::not_found || isNotFound(ec)) &&
+                       !isOnRemovableMount(thumbnail->sourcePath)) {
+                thumbnail->state = SourceState::MISSING;
+            }
+        }
+        return;
+    }
+
+    // Enough sources here that one listing is cheaper than a stat each
+    std::unordered_set<std::string> names;
+    fs::directory_iterator it(directory, ec);
+    for (; !ec && it != fs::directory_iterator(); it.increment(ec)) {
+        names.insert(it->path().filename().string());
+    }
+
+    if (ec) {
+        // Unreadable directories leave their thumbnails alone
+        if (isNotFound(ec) && !isOnRemovableMount(directory)) {
+            for (auto* thumbnail : thumbnails) {
+                thumbnail->state = SourceState::MISSING;
+            }
+        }
+        return;
+    }
+
+    for (auto* thumbnail : thumbnails) {
+        bool exists = names.count(fs::path(thumbnail->sourcePath).filename().string()) > 0;
+        thumbnail->state = exists ? SourceState::EXISTS : SourceState::MISSING;
+    }
+}
+
+}
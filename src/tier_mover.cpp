@@ -0,0 +1,451 @@
+#include "tier_mover.h"
+#include "io_throttle.h"
+#include "logger.h"
+#include "pressure_monitor.h"
+#include "thread_pool.h"
+#include "utils.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <sys/stat.h>
+#include <sys/types.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <sys/sendfile.h>
+#include <sys/xattr.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace CClean {
+
+namespace {
+
+bool syncPath(const std::string& path) {
+#ifdef _WIN32
+    (void)path;
+    return true;
+#else
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+#endif
+}
+
+}
+
+TierMover::TierMover(size_t threadCount)
+    : threadCount_(threadCount)
+    , minimumIdleDays_(TIER_MIN_IDLE_DAYS)
+    , throttle_(nullptr)
+    , dryRun_(false)
+    , verbose_(false)
+    , bytesCopied_(0)
+    , throughputMBps_(0.0) {
+}
+
+void TierMover::setDestination(const std::string& destination) {
+    std::error_code ec;
+    destination_ = fs::absolute(destination, ec).lexically_normal().string();
+}
+
+void TierMover::setMinimumIdleDays(int days) {
+    minimumIdleDays_ = days;
+}
+
+void TierMover::setFileFilter(FileFilter filter) {
+    filter_ = filter;
+}
+
+void TierMover::setThrottle(IoThrottle* throttle) {
+    throttle_ = throttle;
+}
+
+void TierMover::setDryRun(bool enabled) {
+    dryRun_ = enabled;
+}
+
+void TierMover::setVerbose(bool enabled) {
+    verbose_ = enabled;
+}
+
+size_t TierMover::bytesCopied() const {
+    return bytesCopied_;
+}
+
+double TierMover::throughputMBps() const {
+    return throughputMBps_;
+}
+
+CleanupResult TierMover::process(const std::vector<std::string>& rootPaths, bool cleanMode) {
+    result_ = CleanupResult();
+    bytesCopied_ = 0;
+    throughputMBps_ = 0.0;
+
+    std::vector<Candidate> candidates;
+    for (const auto& rootPath : rootPaths) {
+        collectCandidates(rootPath, candidates);
+    }
+
+    result_.filesScanned = candidates.size();
+
+    if (!cleanMode || dryRun_) {
+        for (const auto& candidate : candidates) {
+            if (cleanMode) {
+                result_.filesDeleted++;
+            }
+            result_.bytesFreed += candidate.size;
+
+            if (verbose_) {
+                Logger::getInstance().debug(std::string(cleanMode ? "DRY RUN: Would move " : "Cold: ") + candidate.path +
+                                            " -> " + targetPathFor(candidate.path));
+            }
+        }
+        return result_;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    ThreadPool pool(threadCount_);
+    for (const auto& candidate : candidates) {
+        pool.submit([this, &candidate] {
+            PressureMonitor::getInstance().pace();
+
+            bool copied = false;
+            std::string error;
+            bool ok = moveFile(candidate, copied, error);
+
+            if (!ok) {
+                Logger::getInstance().warning("Failed to move " + candidate.path + ": " + error);
+            } else if (verbose_) {
+                Logger::getInstance().debug(std::string(copied ? "Copied: " : "Renamed: ") + candidate.path + " (" +
+                                            Utils::formatBytes(candidate.size) + ")");
+            }
+
+            std::lock_guard<std::mutex> lock(resultMutex_);
+            if (ok) {
+                result_.filesDeleted++;
+                result_.bytesFreed += candidate.size;
+                if (copied) {
+                    bytesCopied_ += candidate.size;
+                }
+            } else if (result_.errorMessage.empty()) {
+                result_.errorMessage = "Failed to move " + candidate.path + ": " + error;
+            }
+        });
+    }
+    pool.wait();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (seconds > 0) {
+        throughputMBps_ = static_cast<double>(bytesCopied_) / (1024.0 * 1024.0) / seconds;
+    }
+
+    return result_;
+}
+
+void TierMover::collectCandidates(const std::string& rootPath, std::vector<Candidate>& candidates) {
+    long long cutoff = static_cast<long long>(std::time(nullptr)) - static_cast<long long>(minimumIdleDays_) * 86400;
+
+    std::error_code ec;
+    fs::recursive_directory_iterator it(rootPath, fs::directory_options::skip_permission_denied, ec);
+    for (; !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+        PressureMonitor::getInstance().pace();
+
+        std::error_code statEc;
+        if (it->is_symlink(statEc)) {
+            continue;
+        }
+
+        std::string path = it->path().string();
+
+        // Never walk into the tier itself when it lives under a root
+        if (it->is_directory(statEc)) {
+            if (fs::absolute(it->path(), statEc).lexically_normal().string() == destination_) {
+                it.disable_recursion_pending();
+            }
+            continue;
+        }
+
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0 || (st.st_mode & S_IFMT) != S_IFREG) {
+            continue;
+        }
+
+        long long lastUse = std::max(static_cast<long long>(st.st_atime), static_cast<long long>(st.st_mtime));
+        if (lastUse >= cutoff || (filter_ && !filter_(path))) {
+            continue;
+        }
+
+        Candidate candidate;
+        candidate.path = path;
+        candidate.size = static_cast<size_t>(st.st_size);
+        candidates.push_back(std::move(candidate));
+    }
+}
+
+std::string TierMover::targetPathFor(const std::string& sourcePath) const {
+    std::error_code ec;
+    fs::path source = fs::absolute(sourcePath, ec).lexically_normal();
+    fs::path target(destination_);
+
+    // "C:" becomes a "C" directory so volumes stay apart
+    std::string rootName = source.root_name().string();
+    rootName.erase(std::remove(rootName.begin(), rootName.end(), ':'), rootName.end());
+    if (!rootName.empty()) {
+        target /= rootName;
+    }
+
+    return (target / source.relative_path()).string();
+}
+
+bool TierMover::moveFile(const Candidate& candidate, bool& copied, std::string& error) {
+    std::string targetPath = targetPathFor(candidate.path);
+
+    std::error_code ec;
+    fs::create_directories(fs::path(targetPath).parent_path(), ec);
+    if (ec) {
+        error = "cannot create " + fs::path(targetPath).parent_path().string() + ": " + ec.message();
+        return false;
+    }
+
+    if (fs::exists(fs::symlink_status(targetPath, ec))) {
+        error = targetPath + " already exists";
+        return false;
+    }
+
+    // Same filesystem: nothing needs to be copied
+    fs::rename(candidate.path, targetPath, ec);
+    if (!ec) {
+        copied = false;
+        return true;
+    }
+    if (ec != std::errc::cross_device_link) {
+        error = ec.message();
+        return false;
+    }
+
+    std::string partialPath = targetPath + ".cclean-partial";
+    if (!copyFile(candidate.path, partialPath, error)) {
+        fs::remove(partialPath, ec);
+        return false;
+    }
+
+    fs::rename(partialPath, targetPath, ec);
+    if (ec) {
+        error = "cannot move copy into place: " + ec.message();
+        fs::remove(partialPath, ec);
+        return false;
+    }
+
+    // The copy's name must survive a crash before the source goes
+    std::string targetDirectory = fs::path(targetPath).parent_path().string();
+    if (!syncPath(targetDirectory)) {
+        error = "cannot sync " + targetDirectory + "; the source was kept";
+        return false;
+    }
+
+    if (!fs::remove(candidate.path, ec)) {
+        error = "copied to " + targetPath + " but could not remove the source";
+        return false;
+    }
+
+    copied = true;
+    return true;
+}
+
+#ifdef _WIN32
+
+bool TierMover::copyFile(const std::string& sourcePath, const std::string& targetPath, std::string& error) {
+    // CopyFile carries attributes and timestamps over
+    std::error_code ec;
+    size_t size = static_cast<size_t>(fs::file_size(sourcePath, ec));
+    if (throttle_) {
+        throttle_->acquire(size);
+    }
+
+    fs::copy_file(sourcePath, targetPath, fs::copy_options::none, ec);
+    if (ec) {
+        error = ec.message();
+        return false;
+    }
+
+    if (static_cast<size_t>(fs::file_size(targetPath, ec)) != size || ec) {
+        error = "size mismatch after copy";
+        return false;
+    }
+    return true;
+}
+
+#else
+
+bool TierMover::copyFile(const std::string& sourcePath, const std::string& targetPath, std::string& error) {
+    int in = open(sourcePath.c_str(), O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if (in < 0) {
+        error = std::string("cannot open: ") + std::strerror(errno);
+        return false;
+    }
+
+    struct stat before;
+    if (fstat(in, &before) != 0) {
+        error = std::string("cannot stat: ") + std::strerror(errno);
+        close(in);
+        return false;
+    }
+
+    int out = open(targetPath.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (out < 0) {
+        error = "cannot create " + targetPath + ": " + std::strerror(errno);
+        close(in);
+        return false;
+    }
+
+    posix_fadvise(in, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    enum class Method { COPY_FILE_RANGE, SENDFILE, BUFFERED };
+#ifdef __linux__
+    Method method = Method::COPY_FILE_RANGE;
+#else
+    Method method = Method::BUFFERED;
+#endif
+    std::vector<char> buffer;
+
+    // Falls back one method at a time when the kernel or filesystem pair
+    // does not support the faster one
+    auto copyChunk = [&](off_t offset, size_t length) -> ssize_t {
+        while (true) {
+#ifdef __linux__
+            if (method == Method::COPY_FILE_RANGE) {
+                loff_t inOffset = offset;
+                loff_t outOffset = offset;
+                ssize_t copiedBytes = copy_file_range(in, &inOffset, out, &outOffset, length, 0);
+                if (copiedBytes >= 0 || (errno != EXDEV && errno != ENOSYS && errno != EINVAL && errno != EOPNOTSUPP)) {
+                    return copiedBytes;
+                }
+                method = Method::SENDFILE;
+                continue;
+            }
+            if (method == Method::SENDFILE) {
+                off_t inOffset = offset;
+                if (lseek(out, offset, SEEK_SET) == offset) {
+                    ssize_t copiedBytes = sendfile(out, in, &inOffset, length);
+                    if (copiedBytes >= 0 || (errno != EINVAL && errno != ENOSYS)) {
+                        return copiedBytes;
+                    }
+                }
+                method = Method::BUFFERED;
+                continue;
+            }
+#endif
+            buffer.resize(TIER_COPY_CHUNK_SIZE);
+            ssize_t bytesRead = pread(in, buffer.data(), std::min(length, buffer.size()), offset);
+            if (bytesRead <= 0) {
+                return bytesRead;
+            }
+            for (ssize_t written = 0; written < bytesRead;) {
+                ssize_t n = pwrite(out, buffer.data() + written, static_cast<size_t>(bytesRead - written), offset + written);
+                if (n < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    return -1;
+                }
+                written += n;
+            }
+            return bytesRead;
+        }
+    };
+
+    bool ok = true;
+    off_t offset = 0;
+    while (ok && offset < before.st_size) {
+        size_t length = static_cast<size_t>(std::min<off_t>(static_cast<off_t>(TIER_COPY_CHUNK_SIZE), before.st_size - offset));
+        if (throttle_) {
+            throttle_->acquire(length);
+        }
+
+        ssize_t copiedBytes = copyChunk(offset, length);
+        if (copiedBytes < 0 && errno == EINTR) {
+            continue;
+        }
+        if (copiedBytes <= 0) {
+            error = copiedBytes < 0 ? std::string("copy failed: ") + std::strerror(errno) : "source shrank while copying";
+            ok = false;
+            break;
+        }
+
+        posix_fadvise(in, offset, copiedBytes, POSIX_FADV_DONTNEED);
+        offset += copiedBytes;
+    }
+
+    if (ok) {
+        // Ownership first: chown clears set-id bits that fchmod then restores
+        if (fchown(out, before.st_uid, before.st_gid) != 0 && verbose_) {
+            Logger::getInstance().debug("Cannot preserve owner of " + targetPath + ": " + std::strerror(errno));
+        }
+        fchmod(out, before.st_mode & 07777);
+
+#ifdef __linux__
+        ssize_t listSize = flistxattr(in, nullptr, 0);
+        if (listSize > 0) {
+            std::vector<char> names(static_cast<size_t>(listSize));
+            listSize = flistxattr(in, names.data(), names.size());
+            for (ssize_t i = 0; i < listSize; i += static_cast<ssize_t>(std::strlen(names.data() + i)) + 1) {
+                const char* name = names.data() + i;
+                ssize_t valueSize = fgetxattr(in, name, nullptr, 0);
+                if (valueSize < 0) {
+                    continue;
+                }
+                std::vector<char> value(static_cast<size_t>(valueSize) + 1);
+                valueSize = fgetxattr(in, name, value.data(), value.size());
+                if (valueSize >= 0) {
+                    fsetxattr(out, name, value.data(), static_cast<size_t>(valueSize), 0);
+                }
+            }
+        }
+#endif
+
+        struct timespec times[2] = { before.st_atim, before.st_mtim };
+        futimens(out, times);
+
+        if (fsync(out) != 0) {
+            error = std::string("cannot sync copy: ") + std::strerror(errno);
+            ok = false;
+        }
+    }
+
+    struct stat copiedStat;
+    struct stat after;
+    if (ok && (fstat(out, &copiedStat) != 0 || copiedStat.st_size != before.st_size)) {
+        error = "size mismatch after copy";
+        ok = false;
+    }
+    if (ok && (fstat(in, &after) != 0 || after.st_size != before.st_size ||
+               after.st_mtim.tv_sec != before.st_mtim.tv_sec || after.st_mtim.tv_nsec != before.st_mtim.tv_nsec)) {
+        error = "source changed while copying";
+        ok = false;
+    }
+
+    posix_fadvise(out, 0, 0, POSIX_FADV_DONTNEED);
+
+    if (close(out) != 0 && ok) {
+        error = std::string("cannot close copy: ") + std::strerror(errno);
+        ok = false;
+    }
+    close(in);
+    return ok;
+}
+
+#endif
+
+}
@@ -0,0 +1,506 @@
+#include "tree_remover.h"
+#include "thread_pool.h"
+#include "pressure_monitor.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <thread>
+#ifndef _WIN32
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace CClean {
+
+struct TreeRemover::Node {
+    Node* parent = nullptr;
+    std::string name;   // relative to the parent's fd; the full path for roots
+    std::string path;
+    int fd = -1;
+    bool keep = false;
+    std::atomic<size_t> pending{ 1 };  // unfinished children and batches plus the enumeration itself
+    std::atomic<size_t> batchesQueued{ 0 };
+    std::atomic<bool> failed{ false };
+    size_t openAttempts = 0;
+};
+
+namespace {
+
+#ifndef _WIN32
+// Every directory with unfinished children holds its fd open, so wide trees
+// need far more than the usual soft limit of 1024 descriptors. Returns how
+// many directories may be open at once, leaving half for everything else.
+size_t raiseDescriptorLimit() {
+    static std::once_flag once;
+    std::call_once(once, [] {
+        struct rlimit limit;
+        if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+            limit.rlim_cur = limit.rlim_max;
+            setrlimit(RLIMIT_NOFILE, &limit);
+        }
+    });
+
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) != 0 || limit.rlim_cur == RLIM_INFINITY) {
+        return TREE_REMOVER_MAX_OPEN_DIRECTORIES;
+    }
+    return std::max<size_t>(1, std::min<size_t>(TREE_REMOVER_MAX_OPEN_DIRECTORIES, limit.rlim_cur / 2));
+}
+
+// Streams the entries of an open directory. On Linux this is getdents64
+// into a large buffer, so a huge directory takes a fraction of readdir's
+// system calls; elsewhere it wraps readdir on a duplicate of the fd.
+class DirectoryReader {
+public:
+    explicit DirectoryReader(int fd)
+        : error_(0) {
+#ifdef __linux__
+        fd_ = fd;
+        offset_ = 0;
+        length_ = 0;
+#else
+        int enumerationFd = dup(fd);
+        dir_ = enumerationFd >= 0 ? fdopendir(enumerationFd) : nullptr;
+        if (!dir_) {
+            error_ = errno;
+            if (enumerationFd >= 0) {
+                close(enumerationFd);
+            }
+        }
+#endif
+    }
+
+    ~DirectoryReader() {
+#ifndef __linux__
+        if (dir_) {
+            closedir(dir_);
+        }
+#endif
+    }
+
+    // False at the end of the directory or on error(); name points into
+    // the reader's buffer and stays valid until the next call
+    bool next(const char*& name, unsigned char& type) {
+#ifdef __linux__
+        if (offset_ >= length_) {
+            long bytesRead = syscall(SYS_getdents64, fd_, buffer(), TREE_REMOVER_DIRENT_BUFFER_SIZE);
+            if (bytesRead <= 0) {
+                error_ = bytesRead < 0 ? errno : 0;
+                return false;
+            }
+            length_ = static_cast<size_t>(bytesRead);
+            offset_ = 0;
+        }
+
+        // struct linux_dirent64: d_ino, d_off, d_reclen, d_type, d_name
+        const char* record = buffer() + offset_;
+        unsigned short recordLength;
+        std::memcpy(&recordLength, record + 16, sizeof(recordLength));
+        offset_ += recordLength;
+        type = static_cast<unsigned char>(record[18]);
+        name = record + 19;
+        return true;
+#else
+        struct dirent* entry = dir_ ? readdir(dir_) : nullptr;
+        if (!entry) {
+            return false;
+        }
+        name = entry->d_name;
+        type = entry->d_type;
+        return true;
+#endif
+    }
+
+    int error() const { return error_; }
+
+private:
+    int error_;
+#ifdef __linux__
+    static char* buffer() {
+        // Enumeration never nests on one thread, so one buffer per worker
+        thread_local std::vector<char> storage(TREE_REMOVER_DIRENT_BUFFER_SIZE);
+        return storage.data();
+    }
+
+    int fd_;
+    size_t offset_;
+    size_t length_;
+#else
+    DIR* dir_;
+#endif
+};
+
+#endif
+
+}
+
+TreeRemover::TreeRemover(size_t threadCount)
+    : threadCount_(threadCount)
+    , countBytes_(true)
+    , pool_(nullptr)
+    , filesRemoved_(0)
+    , bytesRemoved_(0)
+    , directoriesRemoved_(0)
+    , errorCount_(0)
+    , openDirectories_(0)
+    , openLimit_(TREE_REMOVER_MAX_OPEN_DIRECTORIES) {
+}
+
+TreeRemover::~TreeRemover() = default;
+
+void TreeRemover::setProgressCallback(ProgressCallback callback) {
+    progressCallback_ = callback;
+}
+
+void TreeRemover::setCountBytes(bool enabled) {
+    countBytes_ = enabled;
+}
+
+void TreeRemover::setPreserveMarker(const std::string& name) {
+    preserveMarker_ = name;
+}
+
+CleanupResult TreeRemover::remove(const std::string& rootPath, bool keepRoot) {
+    return remove(std::vector<std::string>{ rootPath }, keepRoot);
+}
+
+CleanupResult TreeRemover::remove(const std::vector<std::string>& rootPaths, bool keepRoots) {
+    filesRemoved_ = 0;
+    bytesRemoved_ = 0;
+    directoriesRemoved_ = 0;
+    errorCount_ = 0;
+    firstError_.clear();
+    preserved_.clear();
+
+#ifndef _WIN32
+    openLimit_ = raiseDescriptorLimit();
+#endif
+
+    ThreadPool pool(threadCount_);
+    pool_ = &pool;
+
+    for (const auto& rootPath : rootPaths) {
+        Node* root = new Node;
+        root->name = rootPath;
+        root->path = rootPath;
+        root->keep = keepRoots;
+        pool.submit([this, root] { processDirectory(root); });
+    }
+    pool.wait();
+    pool_ = nullptr;
+
+    CleanupResult result;
+    result.filesScanned = filesRemoved_;
+    result.filesDeleted = filesRemoved_;
+    result.bytesFreed = bytesRemoved_;
+    result.success = errorCount_ == 0;
+    if (errorCount_ > 0) {
+        result.errorMessage = firstError_;
+        if (errorCount_ > 1) {
+            result.errorMessage += " (and " + std::to_string(errorCount_ - 1) + " more errors)";
+        }
+    }
+    return result;
+}
+
+#ifndef _WIN32
+
+void TreeRemover::processDirectory(Node* node) {
+    int parentFd = node->parent ? node->parent->fd : AT_FDCWD;
+    node->fd = openat(parentFd, node->name.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+
+    // Out of descriptors (other code shares them): go depth-first from now
+    // on and try again once open directories have closed theirs
+    if (node->fd < 0 && (errno == EMFILE || errno == ENFILE) && openDirectories_ > 0 &&
+        ++node->openAttempts <= TREE_REMOVER_OPEN_RETRIES) {
+        openLimit_ = std::max<size_t>(1, std::min<size_t>(openLimit_, openDirectories_ / 2));
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        pool_->submit([this, node] { processDirectory(node); });
+        return;
+    }
+
+    if (node->fd < 0) {
+        recordError("Cannot open " + node->path + ": " + std::strerror(errno));
+        node->failed = true;
+        finishChild(node);
+        return;
+    }
+    openDirectories_++;
+
+    struct stat markerStat;
+    if (!preserveMarker_.empty() &&
+        fstatat(node->fd, preserveMarker_.c_str(), &markerStat, AT_SYMLINK_NOFOLLOW) == 0) {
+        preserve(node);
+        return;
+    }
+
+    // Subdirectories found while too many are open; removed by this thread
+    // once the reader, and with it the dirent buffer, is done
+    std::vector<Node*> deferred;
+    enumerateDirectory(node, deferred);
+
+    for (Node* child : deferred) {
+        processDirectory(child);
+    }
+    finishChild(node);
+}
+
+void TreeRemover::enumerateDirectory(Node* node, std::vector<Node*>& deferred) {
+    DirectoryReader reader(node->fd);
+    if (reader.error()) {
+        recordError("Cannot read " + node->path + ": " + std::strerror(reader.error()));
+        node->failed = true;
+        return;
+    }
+
+    // Past TREE_REMOVER_SPLIT_ENTRIES the rest of the directory is handed
+    // out in batches, so one huge flat directory keeps every worker busy.
+    // With too many batches queued the enumerating thread works through
+    // its batch itself, which bounds memory and never blocks.
+    bool split = false;
+    size_t entries = 0;
+    size_t batchLimit = pool_->size() * 2;
+    std::vector<std::pair<std::string, unsigned char>> batch;
+
+    auto flushBatch = [&] {
+        if (batch.empty()) {
+            return;
+        }
+        if (node->batchesQueued >= batchLimit) {
+            for (const auto& entry : batch) {
+                removeEntry(node, entry.first.c_str(), entry.second, deferred);
+            }
+        } else {
+            node->pending++;
+            node->batchesQueued++;
+            pool_->submit([this, node, names = std::move(batch)] {
+                std::vector<Node*> batchDeferred;
+                for (const auto& entry : names) {
+                    removeEntry(node, entry.first.c_str(), entry.second, batchDeferred);
+                }
+                for (Node* child : batchDeferred) {
+                    processDirectory(child);
+                }
+                node->batchesQueued--;
+                finishChild(node);
+            });
+        }
+        batch.clear();
+        batch.reserve(TREE_REMOVER_BATCH_ENTRIES);
+    };
+
+    const char* name;
+    unsigned char type;
+    while (reader.next(name, type)) {
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+            continue;
+        }
+
+        if (!split && ++entries > TREE_REMOVER_SPLIT_ENTRIES && pool_->size() > 1) {
+            split = true;
+            batch.reserve(TREE_REMOVER_BATCH_ENTRIES);
+        }
+
+        if (!split) {
+            removeEntry(node, name, type, deferred);
+            continue;
+        }
+
+        batch.emplace_back(name, type);
+        if (batch.size() >= TREE_REMOVER_BATCH_ENTRIES) {
+            flushBatch();
+        }
+    }
+    if (reader.error()) {
+        recordError("Cannot read " + node->path + ": " + std::strerror(reader.error()));
+        node->failed = true;
+    }
+    flushBatch();
+}
+
+void TreeRemover::removeEntry(Node* node, const char* name, unsigned char type, std::vector<Node*>& deferred) {
+    PressureMonitor::getInstance().pace();
+
+    bool isDirectory = type == DT_DIR;
+    size_t bytes = 0;
+
+    if (type == DT_UNKNOWN || (countBytes_ && !isDirectory)) {
+        struct stat st;
+        if (fstatat(node->fd, name, &st, AT_SYMLINK_NOFOLLOW) == 0) {
+            isDirectory = S_ISDIR(st.st_mode);
+            bytes = S_ISREG(st.st_mode) ? static_cast<size_t>(st.st_size) : 0;
+        }
+    }
+
+    if (isDirectory) {
+        Node* child = new Node;
+        child->parent = node;
+        child->name = name;
+        child->path = node->path + "/" + name;
+        node->pending++;
+        if (openDirectories_ >= openLimit_) {
+            deferred.push_back(child);
+        } else {
+            pool_->submit([this, child] { processDirectory(child); });
+        }
+        return;
+    }
+
+    if (unlinkat(node->fd, name, 0) == 0) {
+        countFile(bytes);
+    } else if (errno != ENOENT) {
+        recordError("Failed to delete " + node->path + "/" + name + ": " + std::strerror(errno));
+        node->failed = true;
+    }
+}
+
+void TreeRemover::completeDirectory(Node* node) {
+    if (node->fd >= 0) {
+        close(node->fd);
+        node->fd = -1;
+        openDirectories_--;
+    }
+
+    // A failed child leaves this directory non-empty; don't bother trying
+    if (!node->failed && !node->keep) {
+        int result = node->parent
+            ? unlinkat(node->parent->fd, node->name.c_str(), AT_REMOVEDIR)
+            : rmdir(node->path.c_str());
+
+        if (result == 0) {
+            directoriesRemoved_++;
+        } else {
+            recordError("Failed to remove directory " + node->path + ": " + std::strerror(errno));
+            node->failed = true;
+        }
+    }
+
+    // A failed or preserved child leaves the parent non-empty
+    Node* parent = node->parent;
+    if (parent && (node->failed || node->keep)) {
+        parent->failed = true;
+    }
+
+    delete node;
+
+    if (parent) {
+        finishChild(parent);
+    }
+}
+
+#else
+
+void TreeRemover::processDirectory(Node* node) {
+    std::error_code ec;
+    if (!preserveMarker_.empty() && fs::exists(fs::symlink_status(fs::path(node->path) / preserveMarker_, ec))) {
+        preserve(node);
+        return;
+    }
+
+    fs::directory_iterator it(node->path, ec);
+
+    if (ec) {
+        recordError("Cannot read " + node->path + ": " + ec.message());
+        node->failed = true;
+        finishChild(node);
+        return;
+    }
+
+    for (; !ec && it != fs::directory_iterator(); it.increment(ec)) {
+        PressureMonitor::getInstance().pace();
+
+        std::error_code statEc;
+        if (it->is_directory(statEc) && !it->is_symlink(statEc)) {
+            Node* child = new Node;
+            child->parent = node;
+            child->name = it->path().filename().string();
+            child->path = it->path().string();
+            node->pending++;
+            pool_->submit([this, child] { processDirectory(child); });
+            continue;
+        }
+
+        size_t bytes = countBytes_ && it->is_regular_file(statEc) ? static_cast<size_t>(it->file_size(statEc)) : 0;
+        std::error_code removeEc;
+        if (fs::remove(it->path(), removeEc)) {
+            countFile(bytes);
+        } else if (removeEc) {
+            recordError("Failed to delete " + it->path().string() + ": " + removeEc.message());
+            node->failed = true;
+        }
+    }
+
+    finishChild(node);
+}
+
+void TreeRemover::completeDirectory(Node* node) {
+    if (!node->failed && !node->keep) {
+        std::error_code ec;
+        if (fs::remove(node->path, ec)) {
+            directoriesRemoved_++;
+        } else {
+            recordError("Failed to remove directory " + node->path + ": " + ec.message());
+            node->failed = true;
+        }
+    }
+
+    // A failed or preserved child leaves the parent non-empty
+    Node* parent = node->parent;
+    if (parent && (node->failed || node->keep)) {
+        parent->failed = true;
+    }
+
+    delete node;
+
+    if (parent) {
+        finishChild(parent);
+    }
+}
+
+#endif
+
+void TreeRemover::preserve(Node* node) {
+    node->keep = true;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        preserved_.push_back(node->path);
+    }
+    finishChild(node);
+}
+
+void TreeRemover::finishChild(Node* node) {
+    if (--node->pending == 0) {
+        completeDirectory(node);
+    }
+}
+
+void TreeRemover::countFile(size_t bytes) {
+    size_t files = ++filesRemoved_;
+    size_t totalBytes = bytesRemoved_ += bytes;
+
+    if (progressCallback_ && files % TREE_REMOVER_PROGRESS_STEP == 0) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        progressCallback_(files, totalBytes);
+    }
+}
+
+void TreeRemover::recordError(const std::string& error) {
+    errorCount_++;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (firstError_.empty()) {
+        firstError_ = error;
+    }
+}
+
+}
@@ -1,7 +1,33 @@
 #include "utils.h"
+#include "tree_remover.h"
+#include "thread_pool.h"
+#include "io_watchdog.h"
+#ifdef _WIN32
 #include <windows.h>
 #include <shlobj.h>
 #include <shlwapi.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+#include <ctime>
+#endif
+#ifdef __linux__
+#include <sched.h>
+#include <sys/syscall.h>
+#ifndef __NR_cachestat
+#define __NR_cachestat 451    // same number on every architecture, Linux 6.5+
+#endif
+#endif
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <cctype>
 #include <iostream>
 #include <sstream>
 #include <filesystem>
@@ -10,6 +36,7 @@
 namespace CClean {
 namespace Utils {
 
+#ifdef _WIN32
 std::string expandEnvironmentVariables(const std::string& path) {
     std::vector<char> buffer(MAX_PATH);
     DWORD result = ExpandEnvironmentStringsA(path.c_str(), buffer.data(), buffer.size());
@@ -25,12 +52,140 @@ std::string expandEnvironmentVariables(const std::string& path) {
     
     return std::string(buffer.data());
 }
+#else
+// Expands %VAR% (as used by the category tables) and $VAR / ${VAR}.
+// Unset variables are left untouched, like ExpandEnvironmentStrings.
+std::string expandEnvironmentVariables(const std::string& path) {
+    std::string expanded;
+    expanded.reserve(path.size());
+
+    size_t i = 0;
+    while (i < path.size()) {
+        char c = path[i];
+        size_t nameStart = std::string::npos;
+        size_t nameEnd = std::string::npos;
+        size_t tokenEnd = std::string::npos;
+
+        if (c == '%') {
+            size_t close = path.find('%', i + 1);
+            if (close != std::string::npos && close > i + 1) {
+                nameStart = i + 1;
+                nameEnd = close;
+                tokenEnd = close + 1;
+            }
+        } else if (c == '$' && i + 1 < path.size()) {
+            if (path[i + 1] == '{') {
+                size_t close = path.find('}', i + 2);
+                if (close != std::string::npos) {
+                    nameStart = i + 2;
+                    nameEnd = close;
+                    tokenEnd = close + 1;
+                }
+            } else {
+                size_t end = i + 1;
+                while (end < path.size() && (std::isalnum(static_cast<unsigned char>(path[end])) || path[end] == '_')) {
+                    end++;
+                }
+                if (end > i + 1) {
+                    nameStart = i + 1;
+                    nameEnd = end;
+                    tokenEnd = end;
+                }
+            }
+        }
+
+        if (nameStart == std::string::npos) {
+            expanded += c;
+            i++;
+            continue;
+        }
+
+        std::string name = path.substr(nameStart, nameEnd - nameStart);
+        const char* value = std::getenv(name.c_str());
+        if (value) {
+            expanded += value;
+        } else {
+            expanded.append(path, i, tokenEnd - i);
+        }
+        i = tokenEnd;
+    }
+
+    return expanded;
+}
+#endif
+
+namespace {
+
+// Shared with the walk tasks, which may outlive walkFiles() when abandoned
+struct WalkState {
+    FileBatchConsumer consumer;
+    size_t batchSize = WALK_BATCH_FILES;
+};
+
+void walkDirectory(const std::string& directory, const std::shared_ptr<WalkState>& state,
+                   const ThreadPool::Submitter& submit) {
+    IoWatchdog& watchdog = IoWatchdog::getInstance();
+    if (watchdog.isSkipped(directory)) {
+        return;
+    }
+    
+    // A directory with millions of entries is handed on a batch at a time
+    // as it is read, so memory stays bounded and the consumer starts early.
+    // Only the reading is watched; a consumer blocked on a full queue is not
+    // a stuck readdir.
+    std::error_code ec;
+    std::filesystem::directory_iterator it(directory, ec), end;
+    while (!ec && it != end) {
+        std::vector<std::string> files;
+        {
+            IoWatchdog::Scope scope("readdir", directory);
+            for (; !ec && it != end && files.size() < state->batchSize; it.increment(ec)) {
+                scope.progress();
+                std::error_code statEc;
+                if (it->is_symlink(statEc)) {
+                    if (it->is_regular_file(statEc)) {
+                        files.push_back(it->path().string());
+                    }
+                } else if (it->is_directory(statEc)) {
+                    // Other workers walk it while we go on reading this one
+                    std::string subdirectory = it->path().string();
+                    submit([subdirectory, state, submit] { walkDirectory(subdirectory, state, submit); });
+                } else if (it->is_regular_file(statEc)) {
+                    files.push_back(it->path().string());
+                }
+            }
+        }
+        
+        // Checked again: we may have been the call that got stuck
+        if (watchdog.isSkipped(directory)) {
+            return;
+        }
+        if (!files.empty()) {
+            state->consumer(files);
+        }
+    }
+}
+
+}
+
+void walkFiles(const std::string& path, const FileBatchConsumer& consumer, size_t threadCount, size_t batchSize) {
+    // One task per directory, so a hung directory only costs the worker the
+    // watchdog abandons and the walk of its subtree
+    auto state = std::make_shared<WalkState>();
+    state->consumer = consumer;
+    state->batchSize = std::max<size_t>(batchSize, 1);
+    ThreadPool pool(threadCount);
+    ThreadPool::Submitter submit = pool.submitter();
+    submit([path, state, submit] { walkDirectory(path, state, submit); });
+    pool.wait();
+}
 
 std::vector<std::string> findFiles(const std::string& path, const std::string& pattern) {
     std::vector<std::string> files;
     
     try {
         std::string expandedPath = expandEnvironmentVariables(path);
+#ifdef _WIN32
         std::string searchPath = expandedPath + "\\" + pattern;
         
         WIN32_FIND_DATAA findData;
@@ -48,13 +203,21 @@ std::vector<std::string> findFiles(const std::string& path, const std::string& p
         } while (FindNextFileA(hFind, &findData));
         
         FindClose(hFind);
+#else
+        (void)pattern;
+#endif
         
         if (std::filesystem::exists(expandedPath) && std::filesystem::is_directory(expandedPath)) {
-            for (const auto& entry : std::filesystem::recursive_directory_iterator(expandedPath)) {
-                if (entry.is_regular_file()) {
-                    files.push_back(entry.path().string());
-                }
-            }
+            // Abandoned walk tasks may still deliver, so collect under a
+            // lock that outlives this call
+            auto collected = std::make_shared<std::pair<std::mutex, std::vector<std::string>>>();
+            walkFiles(expandedPath, [collected](std::vector<std::string>& batch) {
+                std::lock_guard<std::mutex> lock(collected->first);
+                collected->second.insert(collected->second.end(), batch.begin(), batch.end());
+            });
+            
+            std::lock_guard<std::mutex> lock(collected->first);
+            files.insert(files.end(), collected->second.begin(), collected->second.end());
         }
     } catch (const std::exception&) {
         // Directory may not exist or access denied
@@ -71,6 +234,97 @@ size_t getFileSize(const std::string& filePath) {
     }
 }
 
+#ifdef _WIN32
+bool getFileIdentity(const std::string& filePath, FileIdentity& identity) {
+    HANDLE file = CreateFileA(filePath.c_str(), FILE_READ_ATTRIBUTES,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING,
+                              FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OPEN_REPARSE_POINT, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    
+    BY_HANDLE_FILE_INFORMATION info;
+    bool ok = GetFileInformationByHandle(file, &info) != 0;
+    CloseHandle(file);
+    if (!ok) {
+        return false;
+    }
+    
+    // FILETIME counts 100ns intervals since 1601
+    uint64_t writeTime = (static_cast<uint64_t>(info.ftLastWriteTime.dwHighDateTime) << 32) |
+                         info.ftLastWriteTime.dwLowDateTime;
+    identity.device = info.dwVolumeSerialNumber;
+    identity.inode = (static_cast<uint64_t>(info.nFileIndexHigh) << 32) | info.nFileIndexLow;
+    identity.modified = (static_cast<int64_t>(writeTime) - 116444736000000000LL) * 100;
+    identity.size = (static_cast<size_t>(info.nFileSizeHigh) << 32) | info.nFileSizeLow;
+    return true;
+}
+
+bool getFilesystemSpace(const std::string& path, uint64_t& filesystemId, uint64_t& freeBytes) {
+    char volumePath[MAX_PATH];
+    DWORD serialNumber = 0;
+    ULARGE_INTEGER totalFree;
+    
+    if (!GetVolumePathNameA(path.c_str(), volumePath, MAX_PATH) ||
+        !GetVolumeInformationA(volumePath, NULL, 0, &serialNumber, NULL, NULL, NULL, 0) ||
+        !GetDiskFreeSpaceExA(volumePath, NULL, NULL, &totalFree)) {
+        return false;
+    }
+    
+    filesystemId = serialNumber;
+    freeBytes = totalFree.QuadPart;
+    return true;
+}
+
+bool syncFilesystem(const std::string& path) {
+    // NTFS frees clusters as the file is deleted
+    (void)path;
+    return true;
+}
+#else
+bool getFileIdentity(const std::string& filePath, FileIdentity& identity) {
+    struct stat st;
+    if (lstat(filePath.c_str(), &st) != 0) {
+        return false;
+    }
+    
+    identity.device = static_cast<uint64_t>(st.st_dev);
+    identity.inode = static_cast<uint64_t>(st.st_ino);
+    identity.modified = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+    identity.size = static_cast<size_t>(st.st_size);
+    return true;
+}
+
+bool getFilesystemSpace(const std::string& path, uint64_t& filesystemId, uint64_t& freeBytes) {
+    struct stat st;
+    struct statvfs vfs;
+    if (stat(path.c_str(), &st) != 0 || statvfs(path.c_str(), &vfs) != 0) {
+        return false;
+    }
+    
+    // f_fsid is zero on some filesystems; the device number never is.
+    // Blocks free to root count too: deleting a file frees them either way.
+    filesystemId = static_cast<uint64_t>(st.st_dev);
+    freeBytes = static_cast<uint64_t>(vfs.f_bfree) * vfs.f_frsize;
+    return true;
+}
+
+bool syncFilesystem(const std::string& path) {
+#ifdef __linux__
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = syncfs(fd) == 0;
+    close(fd);
+    return ok;
+#else
+    sync();
+    return true;
+#endif
+}
+#endif
+
 size_t getDirectorySize(const std::string& dirPath) {
     size_t totalSize = 0;
     
@@ -102,12 +356,14 @@ bool deleteFileSecure(const std::string& filePath) {
 bool deleteDirectoryRecursive(const std::string& dirPath) {
     try {
         std::string expandedPath = expandEnvironmentVariables(dirPath);
-        return std::filesystem::remove_all(expandedPath) > 0;
+        TreeRemover remover;
+        return remover.remove(expandedPath).success;
     } catch (const std::exception&) {
         return false;
     }
 }
 
+#ifdef _WIN32
 bool isFileInUse(const std::string& filePath) {
     HANDLE hFile = CreateFileA(
         filePath.c_str(),
@@ -130,6 +386,13 @@ bool isFileInUse(const std::string& filePath) {
     
     return false;
 }
+#else
+bool isFileInUse(const std::string& filePath) {
+    // POSIX has no mandatory sharing locks; an open handle never blocks unlink
+    (void)filePath;
+    return false;
+}
+#endif
 
 std::string formatBytes(size_t bytes) {
     const char* units[] = { "B", "KB", "MB", "GB", "TB" };
@@ -147,6 +410,45 @@ std::string formatBytes(size_t bytes) {
     return ss.str();
 }
 
+bool parseByteSize(const std::string& text, size_t& bytes) {
+    std::istringstream ss(text);
+    double value = 0;
+    
+    if (!(ss >> value) || value < 0) {
+        return false;
+    }
+    
+    std::string unit;
+    ss >> unit;
+    for (auto& c : unit) {
+        c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+    }
+    
+    if (unit.size() > 1 && unit.back() == 'B') {
+        unit.pop_back();
+        if (unit.size() > 1 && unit.back() == 'I') {
+            unit.pop_back();
+        }
+    }
+    
+    const std::string units = "BKMGT";
+    size_t exponent = 0;
+    if (!unit.empty()) {
+        if (unit.size() != 1 || units.find(unit[0]) == std::string::npos) {
+            return false;
+        }
+        exponent = units.find(unit[0]);
+    }
+    
+    for (size_t i = 0; i < exponent; ++i) {
+        value *= 1024;
+    }
+    
+    bytes = static_cast<size_t>(value);
+    return true;
+}
+
+#ifdef _WIN32
 std::string getCurrentTimestamp() {
     SYSTEMTIME st;
     GetLocalTime(&st);
@@ -161,7 +463,19 @@ std::string getCurrentTimestamp() {
     
     return ss.str();
 }
+#else
+std::string getCurrentTimestamp() {
+    std::time_t now = std::time(nullptr);
+    std::tm local{};
+    localtime_r(&now, &local);
+    
+    std::ostringstream ss;
+    ss << std::put_time(&local, "%Y-%m-%d %H:%M:%S");
+    return ss.str();
+}
+#endif
 
+#ifdef _WIN32
 bool hasAdminRights() {
     BOOL isElevated = FALSE;
     HANDLE hToken = NULL;
@@ -197,9 +511,73 @@ std::string getRecycleBinPath() {
     return "C:\\$Recycle.Bin";
 }
 
+std::string getCacheDirectory() {
+    char path[MAX_PATH];
+    
+    if (SUCCEEDED(SHGetFolderPathA(NULL, CSIDL_LOCAL_APPDATA, NULL, SHGFP_TYPE_CURRENT, path))) {
+        return std::string(path) + "\\cclean";
+    }
+    
+    return expandEnvironmentVariables("%TEMP%\\cclean");
+}
+
 bool emptyRecycleBin() {
     return SUCCEEDED(SHEmptyRecycleBinA(NULL, NULL, SHERB_NOCONFIRMATION | SHERB_NOPROGRESSUI | SHERB_NOSOUND));
 }
+#else
+bool hasAdminRights() {
+    return geteuid() == 0;
+}
+
+void requestAdminRights() {
+    std::cerr << "Re-run cclean with sudo to clean system locations.\n";
+}
+
+std::string getRecycleBinPath() {
+    const char* dataHome = std::getenv("XDG_DATA_HOME");
+    if (dataHome && *dataHome) {
+        return std::string(dataHome) + "/Trash";
+    }
+    
+    const char* home = std::getenv("HOME");
+    return std::string(home ? home : "") + "/.local/share/Trash";
+}
+
+std::string getCacheDirectory() {
+    const char* cacheHome = std::getenv("XDG_CACHE_HOME");
+    if (cacheHome && *cacheHome) {
+        return std::string(cacheHome) + "/cclean";
+    }
+    
+    const char* home = std::getenv("HOME");
+    if (home && *home) {
+        return std::string(home) + "/.cache/cclean";
+    }
+    
+    return (std::filesystem::temp_directory_path() / "cclean").string();
+}
+
+bool emptyRecycleBin() {
+    std::string trashPath = getRecycleBinPath();
+    bool success = true;
+    
+    for (const char* subdir : { "/files", "/info" }) {
+        try {
+            std::filesystem::path dir = trashPath + subdir;
+            if (!std::filesystem::exists(dir)) {
+                continue;
+            }
+            for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+                std::filesystem::remove_all(entry.path());
+            }
+        } catch (const std::exception&) {
+            success = false;
+        }
+    }
+    
+    return success;
+}
+#endif
 
 bool pathExists(const std::string& path) {
     try {
@@ -210,6 +588,7 @@ bool pathExists(const std::string& path) {
     }
 }
 
+#ifdef _WIN32
 std::string getLastError() {
     DWORD error = GetLastError();
     LPSTR messageBuffer = nullptr;
@@ -230,5 +609,532 @@ std::string getLastError() {
     return message;
 }
 
+int getLastErrorCode() {
+    return static_cast<int>(GetLastError());
+}
+#else
+std::string getLastError() {
+    return std::strerror(errno);
+}
+
+int getLastErrorCode() {
+    return errno;
+}
+#endif
+
+#ifdef _WIN32
+bool readFileContents(const std::string& filePath, const ContentConsumer& consumer, std::string& error,
+                      const ContentIoOptions& options) {
+    HANDLE file = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        error = "Cannot open " + filePath + ": " + getLastError();
+        return false;
+    }
+    
+    std::vector<char> buffer(std::max<size_t>(options.chunkSize, 4096));
+    size_t total = 0;
+    bool ok = true;
+    
+    while (total < options.limit) {
+        DWORD bytesRead = 0;
+        DWORD want = static_cast<DWORD>(std::min(buffer.size(), options.limit - total));
+        if (!ReadFile(file, buffer.data(), want, &bytesRead, NULL)) {
+            error = "Cannot read " + filePath + ": " + getLastError();
+            ok = false;
+            break;
+        }
+        if (bytesRead == 0 || !consumer(buffer.data(), bytesRead)) {
+            break;
+        }
+        total += bytesRead;
+    }
+    
+    CloseHandle(file);
+    return ok;
+}
+
+bool copyFileContents(const std::string& sourcePath, const std::string& targetPath, std::string& error,
+                      const ContentIoOptions& options) {
+    HANDLE target = CreateFileA(targetPath.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                                FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (target == INVALID_HANDLE_VALUE) {
+        error = "Cannot create " + targetPath + ": " + getLastError();
+        return false;
+    }
+    
+    bool ok = readFileContents(sourcePath, [&](const char* data, size_t size) {
+        DWORD written = 0;
+        if (!WriteFile(target, data, static_cast<DWORD>(size), &written, NULL) || written != size) {
+            error = "Cannot write " + targetPath + ": " + getLastError();
+            return false;
+        }
+        return true;
+    }, error, options);
+    
+    ok = FlushFileBuffers(target) && ok && error.empty();
+    CloseHandle(target);
+    return ok;
+}
+
+bool pageCacheResidency(const std::string& filePath, size_t& cachedBytes, size_t& totalBytes) {
+    (void)filePath;
+    cachedBytes = 0;
+    totalBytes = 0;
+    return false;
+}
+#else
+namespace {
+
+int openForContent(const std::string& filePath, int flags, mode_t mode = 0) {
+#ifdef O_NOATIME
+    // Only permitted on files we own (or with CAP_FOWNER)
+    int fd = open(filePath.c_str(), flags | O_NOATIME | O_CLOEXEC, mode);
+    if (fd >= 0 || errno != EPERM) {
+        return fd;
+    }
+#endif
+    return open(filePath.c_str(), flags | O_CLOEXEC, mode);
+}
+
+// Bytes of [offset, offset + length) in the page cache, or SIZE_MAX when
+// that cannot be determined
+size_t residentBytes(int fd, off_t offset, size_t length) {
+    static const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    
+#ifdef __linux__
+    struct { uint64_t offset, length; } range = { static_cast<uint64_t>(offset), length };
+    struct { uint64_t cache, dirty, writeback, evicted, recentlyEvicted; } stats = {};
+    if (syscall(__NR_cachestat, fd, &range, &stats, 0) == 0) {
+        return static_cast<size_t>(stats.cache) * pageSize;
+    }
+#endif
+    
+    // No cachestat: map the range and ask mincore
+    off_t alignedOffset = offset - offset % static_cast<off_t>(pageSize);
+    size_t mappedLength = length + static_cast<size_t>(offset - alignedOffset);
+    void* address = mmap(nullptr, mappedLength, PROT_READ, MAP_SHARED, fd, alignedOffset);
+    if (address == MAP_FAILED) {
+        return SIZE_MAX;
+    }
+    
+#ifdef __linux__
+    std::vector<unsigned char> pages((mappedLength + pageSize - 1) / pageSize);
+#else
+    std::vector<char> pages((mappedLength + pageSize - 1) / pageSize);
+#endif
+    size_t resident = SIZE_MAX;
+    if (mincore(address, mappedLength, pages.data()) == 0) {
+        resident = 0;
+        for (auto page : pages) {
+            resident += (page & 1) ? pageSize : 0;
+        }
+    }
+    munmap(address, mappedLength);
+    return resident;
+}
+
+// Sets cached[page] for each page of [offset, offset + length) that is in
+// the page cache, pages counted from the start of the file
+bool markResidentPages(int fd, off_t offset, size_t length, std::vector<bool>& cached) {
+    static const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    
+    off_t alignedOffset = offset - offset % static_cast<off_t>(pageSize);
+    size_t mappedLength = length + static_cast<size_t>(offset - alignedOffset);
+    void* address = mmap(nullptr, mappedLength, PROT_READ, MAP_SHARED, fd, alignedOffset);
+    if (address == MAP_FAILED) {
+        return false;
+    }
+    
+#ifdef __linux__
+    std::vector<unsigned char> pages((mappedLength + pageSize - 1) / pageSize);
+#else
+    std::vector<char> pages((mappedLength + pageSize - 1) / pageSize);
+#endif
+    bool ok = mincore(address, mappedLength, pages.data()) == 0;
+    size_t firstPage = static_cast<size_t>(alignedOffset) / pageSize;
+    for (size_t i = 0; ok && i < pages.size() && firstPage + i < cached.size(); ++i) {
+        if (pages[i] & 1) {
+            cached[firstPage + i] = true;
+        }
+    }
+    munmap(address, mappedLength);
+    return ok;
+}
+
+}
+
+bool readFileContents(const std::string& filePath, const ContentConsumer& consumer, std::string& error,
+                      const ContentIoOptions& options) {
+    int fd = openForContent(filePath, O_RDONLY);
+    if (fd < 0) {
+        error = "Cannot open " + filePath + ": " + std::strerror(errno);
+        return false;
+    }
+    
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        error = "Cannot stat " + filePath + ": " + std::strerror(errno);
+        close(fd);
+        return false;
+    }
+    
+    size_t fileSize = static_cast<size_t>(st.st_size);
+    size_t alignment = std::max<size_t>(static_cast<size_t>(st.st_blksize), 4096);
+    size_t chunkSize = (std::max(options.chunkSize, alignment) + alignment - 1) / alignment * alignment;
+    
+    bool direct = false;
+#ifdef O_DIRECT
+    if (options.direct) {
+        int flags = fcntl(fd, F_GETFL);
+        direct = flags >= 0 && fcntl(fd, F_SETFL, flags | O_DIRECT) == 0;
+    }
+#endif
+    
+    // O_DIRECT needs an aligned buffer; it costs nothing otherwise
+    void* memory = nullptr;
+    if (posix_memalign(&memory, alignment, chunkSize) != 0) {
+        error = "Out of memory reading " + filePath;
+        close(fd);
+        return false;
+    }
+    std::unique_ptr<char, decltype(&std::free)> buffer(static_cast<char*>(memory), &std::free);
+    
+    // Residency is noted for the part we will read up front: once reading
+    // starts, kernel read-ahead races ahead of any per-chunk check. One flag
+    // per page, so only pages this read brought in are dropped again; a
+    // cheap count per chunk settles the common all-or-nothing chunks.
+    static const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    // The last read may run up to a chunk past the limit
+    size_t readEnd = options.limit < fileSize ? std::min(fileSize, (options.limit / chunkSize + 1) * chunkSize) : fileSize;
+    std::vector<bool> wasCached;
+    auto noteResidency = [&] {
+        wasCached.assign((readEnd + pageSize - 1) / pageSize, false);
+        for (size_t start = 0; options.dropBehind && start < readEnd; start += chunkSize) {
+            size_t length = std::min(chunkSize, readEnd - start);
+            size_t resident = residentBytes(fd, static_cast<off_t>(start), length);
+            if (resident == 0 || resident == SIZE_MAX) {
+                continue;
+            }
+            if (resident >= length) {
+                std::fill(wasCached.begin() + static_cast<std::ptrdiff_t>(start / pageSize),
+                          wasCached.begin() + static_cast<std::ptrdiff_t>((start + length + pageSize - 1) / pageSize), true);
+            } else {
+                markResidentPages(fd, static_cast<off_t>(start), length, wasCached);
+            }
+        }
+    };
+    // Contiguous runs go out as one call: the page cache may hold large
+    // folios spanning chunk boundaries, and those are only dropped when a
+    // single call covers them entirely
+    auto dropRange = [&](size_t from, size_t to) {
+        size_t runStart = SIZE_MAX;
+        for (size_t page = from / pageSize; options.dropBehind && page * pageSize < to; ++page) {
+            bool drop = page >= wasCached.size() || !wasCached[page];
+            if (drop && runStart == SIZE_MAX) {
+                runStart = std::max(from, page * pageSize);
+            }
+            if (!drop && runStart != SIZE_MAX) {
+                posix_fadvise(fd, static_cast<off_t>(runStart), static_cast<off_t>(page * pageSize - runStart), POSIX_FADV_DONTNEED);
+                runStart = SIZE_MAX;
+            }
+        }
+        if (runStart != SIZE_MAX && to > runStart) {
+            posix_fadvise(fd, static_cast<off_t>(runStart), static_cast<off_t>(to - runStart), POSIX_FADV_DONTNEED);
+        }
+    };
+    size_t dropOverlap = std::max(options.readAhead, chunkSize);
+    
+    if (!direct) {
+        noteResidency();
+    }
+    
+    // Our own read-ahead is bounded to a window in front of the cursor; the
+    // kernel's heuristic one (up to the device's read_ahead_kb) is turned off
+    posix_fadvise(fd, 0, 0, options.readAhead > 0 ? POSIX_FADV_RANDOM : POSIX_FADV_SEQUENTIAL);
+    size_t advised = 0;
+    
+    size_t offset = 0;
+    bool ok = true;
+    
+    while (offset < options.limit) {
+        if (!direct && options.readAhead > 0 && advised < offset + options.readAhead && advised < readEnd) {
+            size_t end = std::min(offset + options.readAhead, readEnd);
+            advised = std::max(advised, offset);
+            posix_fadvise(fd, static_cast<off_t>(advised), static_cast<off_t>(end - advised), POSIX_FADV_WILLNEED);
+            advised = end;
+        }
+        
+        ssize_t bytesRead = pread(fd, buffer.get(), chunkSize, static_cast<off_t>(offset));
+        if (bytesRead < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+#ifdef O_DIRECT
+            if (direct && errno == EINVAL) {
+                // Accepted at open time but not for this file or offset
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+                direct = false;
+                noteResidency();
+                continue;
+            }
+#endif
+            error = "Cannot read " + filePath + ": " + std::strerror(errno);
+            ok = false;
+            break;
+        }
+        if (bytesRead == 0) {
+            break;
+        }
+        
+        size_t length = std::min(static_cast<size_t>(bytesRead), options.limit - offset);
+        bool keepGoing = consumer(buffer.get(), length);
+        
+        if (!direct) {
+            dropRange(offset > dropOverlap ? offset - dropOverlap : 0, offset + static_cast<size_t>(bytesRead));
+        }
+        
+        offset += static_cast<size_t>(bytesRead);
+        if (!keepGoing) {
+            break;
+        }
+    }
+    
+    // Everything we pulled in, including read-ahead past where we stopped
+    if (!direct) {
+        dropRange(0, std::max(offset, advised));
+    }
+    
+    close(fd);
+    return ok;
+}
+
+bool copyFileContents(const std::string& sourcePath, const std::string& targetPath, std::string& error,
+                      const ContentIoOptions& options) {
+    struct stat st;
+    mode_t mode = stat(sourcePath.c_str(), &st) == 0 ? (st.st_mode & 0777) : 0644;
+    
+    int out = openForContent(targetPath, O_WRONLY | O_CREAT | O_TRUNC, mode);
+    if (out < 0) {
+        error = "Cannot create " + targetPath + ": " + std::strerror(errno);
+        return false;
+    }
+    
+    off_t written = 0;
+    off_t previousStart = 0;
+    
+    bool ok = readFileContents(sourcePath, [&](const char* data, size_t size) {
+        for (size_t done = 0; done < size;) {
+            ssize_t n = write(out, data + done, size - done);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                error = "Cannot write " + targetPath + ": " + std::strerror(errno);
+                return false;
+            }
+            done += static_cast<size_t>(n);
+        }
+        
+        off_t start = written;
+        written += static_cast<off_t>(size);
+        
+#ifdef __linux__
+        // Start writeback of this chunk, then wait for the previous one and
+        // drop it, so dirty pages never pile up behind the copy
+        sync_file_range(out, start, static_cast<off_t>(size), SYNC_FILE_RANGE_WRITE);
+        if (start > previousStart) {
+            sync_file_range(out, previousStart, start - previousStart,
+                            SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+            if (options.dropBehind) {
+                posix_fadvise(out, previousStart, start - previousStart, POSIX_FADV_DONTNEED);
+            }
+        }
+#endif
+        previousStart = start;
+        return true;
+    }, error, options);
+    
+    if (ok && error.empty() && fdatasync(out) != 0) {
+        error = "Cannot sync " + targetPath + ": " + std::strerror(errno);
+    }
+    if (options.dropBehind) {
+        posix_fadvise(out, 0, 0, POSIX_FADV_DONTNEED);
+    }
+    
+    if (close(out) != 0 && error.empty()) {
+        error = "Cannot close " + targetPath + ": " + std::strerror(errno);
+    }
+    return ok && error.empty();
+}
+
+bool pageCacheResidency(const std::string& filePath, size_t& cachedBytes, size_t& totalBytes) {
+    int fd = open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0;
+    totalBytes = ok ? static_cast<size_t>(st.st_size) : 0;
+    cachedBytes = 0;
+    
+    // In pieces so the mincore fallback never maps more than 1 GiB at once
+    const size_t piece = 1024 * 1024 * 1024;
+    for (size_t offset = 0; ok && offset < totalBytes; offset += piece) {
+        size_t resident = residentBytes(fd, static_cast<off_t>(offset), std::min(piece, totalBytes - offset));
+        ok = resident != SIZE_MAX;
+        cachedBytes += ok ? resident : 0;
+    }
+    
+    close(fd);
+    return ok;
+}
+#endif
+
+bool parseCpuList(const std::string& text, std::vector<unsigned int>& cpus) {
+    cpus.clear();
+    std::istringstream ss(text);
+    std::string item;
+    
+    while (std::getline(ss, item, ',')) {
+        size_t dash = item.find('-');
+        std::string first = item.substr(0, dash);
+        std::string last = dash == std::string::npos ? first : item.substr(dash + 1);
+        
+        if (first.empty() || last.empty() ||
+            first.find_first_not_of("0123456789") != std::string::npos ||
+            last.find_first_not_of("0123456789") != std::string::npos) {
+            return false;
+        }
+        
+        unsigned long low = std::stoul(first);
+        unsigned long high = std::stoul(last);
+        if (low > high || high >= CPU_AFFINITY_MAX_CPUS) {
+            return false;
+        }
+        for (unsigned long cpu = low; cpu <= high; ++cpu) {
+            cpus.push_back(static_cast<unsigned int>(cpu));
+        }
+    }
+    
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+    return !cpus.empty();
+}
+
+std::string formatCpuList(const std::vector<unsigned int>& cpus) {
+    std::ostringstream ss;
+    for (size_t i = 0; i < cpus.size();) {
+        size_t j = i;
+        while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1) {
+            j++;
+        }
+        
+        ss << (i > 0 ? "," : "") << cpus[i];
+        if (j > i) {
+            ss << "-" << cpus[j];
+        }
+        i = j + 1;
+    }
+    return ss.str();
+}
+
+#ifdef _WIN32
+std::vector<unsigned int> allowedCpus() {
+    std::vector<unsigned int> cpus;
+    DWORD_PTR processMask = 0;
+    DWORD_PTR systemMask = 0;
+    
+    if (GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask)) {
+        for (unsigned int cpu = 0; cpu < sizeof(DWORD_PTR) * 8; ++cpu) {
+            if (processMask & (static_cast<DWORD_PTR>(1) << cpu)) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+    return cpus;
+}
+
+bool setCpuAffinity(const std::vector<unsigned int>& cpus, std::string& error) {
+    // Only the first processor group is addressable through this mask
+    DWORD_PTR mask = 0;
+    for (unsigned int cpu : cpus) {
+        if (cpu >= sizeof(DWORD_PTR) * 8) {
+            error = "CPU " + std::to_string(cpu) + " is outside the first processor group";
+            return false;
+        }
+        mask |= static_cast<DWORD_PTR>(1) << cpu;
+    }
+    
+    if (!SetProcessAffinityMask(GetCurrentProcess(), mask)) {
+        error = "Cannot set CPU affinity: " + getLastError();
+        return false;
+    }
+    return true;
+}
+#elif defined(__linux__)
+std::vector<unsigned int> allowedCpus() {
+    std::vector<unsigned int> cpus;
+    
+    // The kernel's mask may be wider than cpu_set_t on very large machines
+    for (size_t count = CPU_SETSIZE; count <= CPU_AFFINITY_MAX_CPUS; count *= 2) {
+        cpu_set_t* set = CPU_ALLOC(count);
+        size_t size = CPU_ALLOC_SIZE(count);
+        CPU_ZERO_S(size, set);
+        
+        if (sched_getaffinity(0, size, set) == 0) {
+            for (size_t cpu = 0; cpu < count; ++cpu) {
+                if (CPU_ISSET_S(cpu, size, set)) {
+                    cpus.push_back(static_cast<unsigned int>(cpu));
+                }
+            }
+            CPU_FREE(set);
+            break;
+        }
+        
+        CPU_FREE(set);
+        if (errno != EINVAL) {
+            break;
+        }
+    }
+    return cpus;
+}
+
+bool setCpuAffinity(const std::vector<unsigned int>& cpus, std::string& error) {
+    size_t count = cpus.empty() ? CPU_SETSIZE : std::max<size_t>(CPU_SETSIZE, cpus.back() + 1);
+    cpu_set_t* set = CPU_ALLOC(count);
+    size_t size = CPU_ALLOC_SIZE(count);
+    CPU_ZERO_S(size, set);
+    for (unsigned int cpu : cpus) {
+        CPU_SET_S(cpu, size, set);
+    }
+    
+    bool ok = sched_setaffinity(0, size, set) == 0;
+    if (!ok) {
+        // EINVAL: none of the CPUs is allowed by our cpuset cgroup
+        error = "Cannot set CPU affinity to " + formatCpuList(cpus) + " (allowed: " +
+                formatCpuList(allowedCpus()) + "): " + std::strerror(errno);
+    }
+    CPU_FREE(set);
+    return ok;
+}
+#else
+std::vector<unsigned int> allowedCpus() {
+    std::vector<unsigned int> cpus;
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    for (long cpu = 0; cpu < online; ++cpu) {
+        cpus.push_back(static_cast<unsigned int>(cpu));
+    }
+    return cpus;
+}
+
+bool setCpuAffinity(const std::vector<unsigned int>& cpus, std::string& error) {
+    (void)cpus;
+    error = "CPU affinity is not supported on this platform";
+    return false;
+}
+#endif
+
+}
 }
-}
\ No newline at end of file
@@ -0,0 +1,307 @@
+// Builds a small NTFS image in a temp file and checks what MftScanner reads
+// from it: names, parents, resident and non-resident sizes, extension
+// records, and the records it must leave out (deleted, reused parent, torn).
+//
+// Image layout: 512-byte sectors, 4K clusters, 1K records; the MFT is 32
+// records in clusters 4-11, described by record 0's $DATA run.
+//
+//   \Windows\Temp\a.tmp     100 bytes resident
+//   \Windows\Temp\b.log     10000 bytes in 3 clusters, plus a 20-byte
+//                           stream in extension record 25
+//   \Users\xlong.txt        50 bytes resident, also named X~1.TXT (DOS)
+//   record 20  old.tmp      parent Temp with a stale sequence number
+//   record 23  gone.tmp     not in use
+//   record 26  torn.tmp     fixup mismatch
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "mft_scanner.h"
+
+namespace fs = std::filesystem;
+using namespace CClean;
+
+namespace {
+
+const size_t SECTOR_SIZE = 512;
+const size_t CLUSTER_SIZE = 4096;
+const size_t RECORD_SIZE = 1024;
+const size_t MFT_CLUSTER = 4;
+const size_t MFT_RECORDS = 32;
+const size_t ATTRIBUTES_OFFSET = 56;
+
+const uint64_t ROOT = 5;
+const uint64_t WINDOWS = 16;
+const uint64_t TEMP = 17;
+const uint64_t USERS = 21;
+
+int failures = 0;
+
+#define CHECK(condition)                                                              \
+    do {                                                                              \
+        if (!(condition)) {                                                           \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": failed: " #condition "\n"; \
+            failures++;                                                               \
+        }                                                                             \
+    } while (0)
+
+void put16(std::vector<char>& buffer, size_t offset, uint16_t value) {
+    buffer[offset] = static_cast<char>(value & 0xFF);
+    buffer[offset + 1] = static_cast<char>(value >> 8);
+}
+
+void put32(std::vector<char>& buffer, size_t offset, uint32_t value) {
+    put16(buffer, offset, static_cast<uint16_t>(value));
+    put16(buffer, offset + 2, static_cast<uint16_t>(value >> 16));
+}
+
+void put64(std::vector<char>& buffer, size_t offset, uint64_t value) {
+    put32(buffer, offset, static_cast<uint32_t>(value));
+    put32(buffer, offset + 4, static_cast<uint32_t>(value >> 32));
+}
+
+// One FILE record; attributes are appended in order and finish() writes
+// the end marker and the update sequence fixups
+class Record {
+public:
+    Record(uint16_t sequence, bool directory, uint64_t base = 0)
+        : data_(RECORD_SIZE, 0)
+        , next_(ATTRIBUTES_OFFSET) {
+        std::memcpy(data_.data(), "FILE", 4);
+        put16(data_, 4, 48);                        // update sequence array
+        put16(data_, 6, RECORD_SIZE / SECTOR_SIZE + 1);
+        put16(data_, 16, sequence);
+        put16(data_, 20, ATTRIBUTES_OFFSET);
+        put16(data_, 22, static_cast<uint16_t>(0x0001 | (directory ? 0x0002 : 0)));
+        put32(data_, 28, RECORD_SIZE);
+        put64(data_, 32, base);
+    }
+
+    void markUnused() {
+        put16(data_, 22, 0);
+    }
+
+    void addName(uint64_t parent, uint16_t parentSequence, const std::string& name, uint8_t nameSpace) {
+        size_t valueLength = 0x42 + 2 * name.size();
+        size_t offset = beginAttribute(0x30, (24 + valueLength + 7) / 8 * 8);
+        put32(data_, offset + 16, static_cast<uint32_t>(valueLength));
+        put16(data_, offset + 20, 24);
+
+        size_t value = offset + 24;
+        put64(data_, value, parent | (static_cast<uint64_t>(parentSequence) << 48));
+        data_[value + 0x40] = static_cast<char>(name.size());
+        data_[value + 0x41] = static_cast<char>(nameSpace);
+        for (size_t i = 0; i < name.size(); ++i) {
+            put16(data_, value + 0x42 + 2 * i, static_cast<uint8_t>(name[i]));
+        }
+    }
+
+    void addResidentData(uint32_t size) {
+        size_t offset = beginAttribute(0x80, (24 + size + 7) / 8 * 8);
+        put32(data_, offset + 16, size);
+        put16(data_, offset + 20, 24);
+    }
+
+    // One run of clusters at firstCluster
+    void addNonResidentData(uint64_t realSize, uint8_t clusters, uint8_t firstCluster) {
+        size_t offset = beginAttribute(0x80, 72);
+        data_[offset + 8] = 1;
+        put64(data_, offset + 24, clusters - 1u);    // last VCN
+        put16(data_, offset + 32, 64);
+        put64(data_, offset + 40, static_cast<uint64_t>(clusters) * CLUSTER_SIZE);
+        put64(data_, offset + 48, realSize);
+        put64(data_, offset + 56, realSize);
+        data_[offset + 64] = 0x11;
+        data_[offset + 65] = static_cast<char>(clusters);
+        data_[offset + 66] = static_cast<char>(firstCluster);
+    }
+
+    std::vector<char> finish(bool tear = false) {
+        put32(data_, next_, 0xFFFFFFFF);
+        put32(data_, 24, static_cast<uint32_t>(next_ + 8));
+
+        const uint16_t sequenceNumber = 0x0042;
+        put16(data_, 48, sequenceNumber);
+        for (size_t block = 1; block <= RECORD_SIZE / SECTOR_SIZE; ++block) {
+            size_t blockEnd = block * SECTOR_SIZE - 2;
+            data_[48 + 2 * block] = data_[blockEnd];
+            data_[48 + 2 * block + 1] = data_[blockEnd + 1];
+            put16(data_, blockEnd, sequenceNumber);
+        }
+        if (tear) {
+            put16(data_, RECORD_SIZE - 2, 0x0043);
+        }
+        return data_;
+    }
+
+private:
+    size_t beginAttribute(uint32_t type, size_t length) {
+        size_t offset = next_;
+        put32(data_, offset, type);
+        put32(data_, offset + 4, static_cast<uint32_t>(length));
+        next_ += length;
+        return offset;
+    }
+
+    std::vector<char> data_;
+    size_t next_;
+};
+
+std::vector<char> buildImage() {
+    std::vector<char> image(CLUSTER_SIZE * (MFT_CLUSTER + MFT_RECORDS * RECORD_SIZE / CLUSTER_SIZE + 3), 0);
+
+    std::memcpy(image.data() + 3, "NTFS    ", 8);
+    put16(image, 0x0B, SECTOR_SIZE);
+    image[0x0D] = static_cast<char>(CLUSTER_SIZE / SECTOR_SIZE);
+    put64(image, 0x30, MFT_CLUSTER);
+    image[0x40] = static_cast<char>(-10);           // 2^10-byte records
+
+    auto place = [&image](uint64_t recordNumber, const std::vector<char>& record) {
+        std::memcpy(image.data() + MFT_CLUSTER * CLUSTER_SIZE + recordNumber * RECORD_SIZE, record.data(), RECORD_SIZE);
+    };
+
+    Record mft(1, false);
+    mft.addNonResidentData(MFT_RECORDS * RECORD_SIZE, MFT_RECORDS * RECORD_SIZE / CLUSTER_SIZE, MFT_CLUSTER);
+    place(0, mft.finish());
+
+    Record root(5, true);
+    root.addName(ROOT, 5, ".", 3);
+    place(ROOT, root.finish());
+
+    Record windows(1, true);
+    windows.addName(ROOT, 5, "Windows", 3);
+    place(WINDOWS, windows.finish());
+
+    Record temp(2, true);
+    temp.addName(WINDOWS, 1, "Temp", 3);
+    place(TEMP, temp.finish());
+
+    Record small(1, false);
+    small.addName(TEMP, 2, "a.tmp", 3);
+    small.addResidentData(100);
+    place(18, small.finish());
+
+    Record large(1, false);
+    large.addName(TEMP, 2, "b.log", 3);
+    large.addNonResidentData(10000, 3, 12);
+    place(19, large.finish());
+
+    Record stale(1, false);
+    stale.addName(TEMP, 1, "old.tmp", 3);
+    stale.addResidentData(300);
+    place(20, stale.finish());
+
+    Record users(1, true);
+    users.addName(ROOT, 5, "Users", 3);
+    place(USERS, users.finish());
+
+    Record named(1, false);
+    named.addName(USERS, 1, "X~1.TXT", 2);
+    named.addName(USERS, 1, "xlong.txt", 1);
+    named.addResidentData(50);
+    place(22, named.finish());
+
+    Record gone(1, false);
+    gone.addName(TEMP, 2, "gone.tmp", 3);
+    gone.addResidentData(400);
+    gone.markUnused();
+    place(23, gone.finish());
+
+    Record extension(1, false, 19);
+    extension.addResidentData(20);
+    place(25, extension.finish());
+
+    Record torn(1, false);
+    torn.addName(TEMP, 2, "torn.tmp", 3);
+    torn.addResidentData(500);
+    place(26, torn.finish(true));
+
+    return image;
+}
+
+bool writeFile(const fs::path& path, const std::vector<char>& data) {
+    std::ofstream out(path, std::ios::binary);
+    out.write(data.data(), static_cast<std::streamsize>(data.size()));
+    return static_cast<bool>(out);
+}
+
+}
+
+int main() {
+    fs::path imagePath = fs::temp_directory_path() / "cclean-mft-test.img";
+    if (!writeFile(imagePath, buildImage())) {
+        std::cerr << "Cannot write " << imagePath << "\n";
+        return 1;
+    }
+
+    MftScanner scanner;
+    std::string error;
+    bool scanned = scanner.open(imagePath.string(), error) && scanner.scan(error);
+    CHECK(scanned);
+    if (!scanned) {
+        std::cerr << error << "\n";
+        fs::remove(imagePath);
+        return 1;
+    }
+    CHECK(scanner.recordCount() == MFT_RECORDS);
+    CHECK(scanner.clusterSize() == CLUSTER_SIZE);
+
+    // Deleted, stale-parent and torn records are left out; the extension
+    // record's stream counts towards b.log
+    MftTotals totals;
+    CHECK(scanner.totalsFor("Windows\\Temp", totals));
+    CHECK(totals.files == 2);
+    CHECK(totals.directories == 0);
+    CHECK(totals.bytes == 100 + 10000 + 20);
+    CHECK(totals.allocated == 3 * CLUSTER_SIZE);
+
+    CHECK(scanner.totalsFor("C:\\WINDOWS\\temp\\", totals));
+    CHECK(totals.files == 2);
+
+    CHECK(scanner.totalsFor("/Windows/*/*.tmp", totals));
+    CHECK(totals.files == 1);
+    CHECK(totals.bytes == 100);
+
+    CHECK(scanner.totalsFor("Windows\\Temp\\b.log", totals));
+    CHECK(totals.files == 1);
+    CHECK(totals.bytes == 10020);
+
+    CHECK(scanner.totalsFor("/", totals));
+    CHECK(totals.files == 3);
+    CHECK(totals.directories == 3);
+    CHECK(totals.bytes == 100 + 10000 + 20 + 50);
+
+    CHECK(!scanner.totalsFor("Windows\\Missing", totals));
+    CHECK(!scanner.totalsFor("Windows\\Temp\\old.tmp", totals));
+    CHECK(!scanner.totalsFor("Windows\\Temp\\gone.tmp", totals));
+    CHECK(!scanner.totalsFor("Windows\\Temp\\torn.tmp", totals));
+
+    // The Win32 name wins over the DOS 8.3 one
+    std::vector<std::pair<std::string, MftTotals>> children;
+    CHECK(scanner.childrenOf("Users", children));
+    CHECK(children.size() == 1);
+    CHECK(!children.empty() && children[0].first == "xlong.txt" && children[0].second.bytes == 50);
+
+    // Anything without the NTFS signature is refused
+    std::vector<char> notNtfs(8192, 0);
+    CHECK(writeFile(imagePath, notNtfs));
+    MftScanner other;
+    CHECK(other.open(imagePath.string(), error));
+    CHECK(!other.scan(error));
+    CHECK(error == "Not an NTFS volume");
+    other.close();
+
+    fs::remove(imagePath);
+
+    if (failures > 0) {
+        std::cerr << failures << " check(s) failed\n";
+        return 1;
+    }
+    std::cout << "mft_scanner_test passed\n";
+    return 0;
+}
@@ -0,0 +1,189 @@
+// Builds a $Recycle.Bin fixture in a temp directory and checks what
+// RecycleBinCleaner makes of it: version 1 and 2 $I records, sizes taken
+// from the records, the minimum-age cutoff, and that purging removes the
+// $R payload (file or folder) and $I record of expired entries only.
+//
+//   S-1-5-21-1000\$IOLD1.txt   v2, 100 days old, 5 bytes      $R file
+//   S-1-5-21-1000\$IOLD2       v1, 60 days old, 300 bytes     $R folder
+//   S-1-5-21-1000\$INEW.txt    v2, 1 day old, 7 bytes         $R file
+//   S-1-5-21-1000\$IBAD        too short to be a record
+//   S-1-5-21-1001\$IOLD3.log   v1, 40 days old, 11 bytes      $R file
+
+#include <cstdint>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include "recycle_bin.h"
+
+namespace fs = std::filesystem;
+using namespace CClean;
+
+namespace {
+
+const int64_t FILETIME_UNIX_EPOCH = 116444736000000000LL;
+const int64_t DAY = 86400;
+
+int failures = 0;
+
+#define CHECK(condition)                                                              \
+    do {                                                                              \
+        if (!(condition)) {                                                           \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": failed: " #condition "\n"; \
+            failures++;                                                               \
+        }                                                                             \
+    } while (0)
+
+void append64(std::string& out, uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+        out += static_cast<char>((value >> (8 * i)) & 0xFF);
+    }
+}
+
+void append32(std::string& out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out += static_cast<char>((value >> (8 * i)) & 0xFF);
+    }
+}
+
+// ASCII and Latin-1 only, which is all the fixture needs
+std::string utf16(const std::u32string& text) {
+    std::string out;
+    for (char32_t c : text) {
+        out += static_cast<char>(c & 0xFF);
+        out += static_cast<char>((c >> 8) & 0xFF);
+    }
+    return out;
+}
+
+std::string infoRecord(int version, uint64_t size, int64_t deletionTime, const std::u32string& path) {
+    std::string record;
+    append64(record, static_cast<uint64_t>(version));
+    append64(record, size);
+    append64(record, static_cast<uint64_t>(deletionTime * 10000000LL + FILETIME_UNIX_EPOCH));
+
+    if (version == 1) {
+        // A fixed MAX_PATH buffer, NUL-padded
+        std::u32string padded = path;
+        padded.resize(260, U'\0');
+        record += utf16(padded);
+    } else {
+        append32(record, static_cast<uint32_t>(path.size() + 1));
+        record += utf16(path + U'\0');
+    }
+    return record;
+}
+
+void writeFile(const fs::path& path, const std::string& data) {
+    std::ofstream out(path, std::ios::binary);
+    out.write(data.data(), static_cast<std::streamsize>(data.size()));
+}
+
+bool isPresent(const fs::path& path) {
+    std::error_code ec;
+    return fs::exists(fs::symlink_status(path, ec));
+}
+
+}
+
+int main() {
+    int64_t now = static_cast<int64_t>(std::time(nullptr));
+
+    // The parser on its own
+    RecycleBinEntry entry;
+    CHECK(RecycleBinCleaner::parseInfoRecord(infoRecord(1, 300, now - 60 * DAY, U"C:\\dir"), entry));
+    CHECK(entry.size == 300);
+    CHECK(entry.deletionTime == now - 60 * DAY);
+    CHECK(entry.originalPath == "C:\\dir");
+
+    CHECK(RecycleBinCleaner::parseInfoRecord(infoRecord(2, 7, now - DAY, U"C:\\\u00fcn\u00ef.txt"), entry));
+    CHECK(entry.size == 7);
+    CHECK(entry.originalPath == "C:\\\xc3\xbcn\xc3\xaf.txt");
+
+    CHECK(!RecycleBinCleaner::parseInfoRecord(std::string(16, '\0'), entry));
+    CHECK(!RecycleBinCleaner::parseInfoRecord(infoRecord(3, 1, now, U"C:\\x"), entry));
+
+    fs::path root = fs::temp_directory_path() / ("cclean-recycle-test-" + std::to_string(now));
+    fs::path bin = root / "$Recycle.Bin";
+    fs::path user = bin / "S-1-5-21-1000";
+    fs::path other = bin / "S-1-5-21-1001";
+    fs::create_directories(user);
+    fs::create_directories(other);
+
+    writeFile(user / "$IOLD1.txt", infoRecord(2, 5, now - 100 * DAY, U"C:\\Users\\a\\old.txt"));
+    writeFile(user / "$ROLD1.txt", "hello");
+
+    writeFile(user / "$IOLD2", infoRecord(1, 300, now - 60 * DAY, U"C:\\Users\\a\\dir"));
+    fs::create_directories(user / "$ROLD2" / "sub");
+    for (int i = 0; i < 3; ++i) {
+        writeFile(user / "$ROLD2" / "sub" / ("f" + std::to_string(i)), std::string(100, 'x'));
+    }
+
+    writeFile(user / "$INEW.txt", infoRecord(2, 7, now - DAY, U"C:\\Users\\a\\new.txt"));
+    writeFile(user / "$RNEW.txt", "keep me");
+
+    writeFile(user / "$IBAD", "short");
+
+    writeFile(other / "$IOLD3.log", infoRecord(1, 11, now - 40 * DAY, U"D:\\logs\\old.log"));
+    writeFile(other / "$ROLD3.log", "hello world");
+
+    // Sizes come from the records; only entries past the cutoff count
+    RecycleBinCleaner cleaner;
+    cleaner.setMinimumAgeDays(30);
+    CHECK(cleaner.scan(bin.string()));
+    CHECK(cleaner.entries().size() == 4);
+    CHECK(cleaner.scanResult().filesScanned == 3);
+    CHECK(cleaner.scanResult().bytesFreed == 5 + 300 + 11);
+
+    bool foundFolder = false;
+    for (const auto& scanned : cleaner.entries()) {
+        if (scanned.originalPath == "C:\\Users\\a\\dir") {
+            foundFolder = true;
+            CHECK(scanned.dataPath == (user / "$ROLD2").string());
+            CHECK(scanned.infoPath == (user / "$IOLD2").string());
+        }
+    }
+    CHECK(foundFolder);
+
+    // A dry run reports the same and touches nothing
+    RecycleBinCleaner dryRun;
+    dryRun.setMinimumAgeDays(30);
+    dryRun.setDryRun(true);
+    CHECK(dryRun.scan(bin.string()));
+    CleanupResult planned = dryRun.purge();
+    CHECK(planned.filesDeleted == 3);
+    CHECK(planned.bytesFreed == 316);
+    CHECK(isPresent(user / "$ROLD1.txt"));
+    CHECK(isPresent(user / "$ROLD2" / "sub" / "f0"));
+
+    CleanupResult purged = cleaner.purge();
+    CHECK(purged.success);
+    CHECK(purged.filesDeleted == 3);
+    CHECK(purged.bytesFreed == 316);
+
+    CHECK(!isPresent(user / "$ROLD1.txt"));
+    CHECK(!isPresent(user / "$IOLD1.txt"));
+    CHECK(!isPresent(user / "$ROLD2"));
+    CHECK(!isPresent(user / "$IOLD2"));
+    CHECK(!isPresent(other / "$ROLD3.log"));
+    CHECK(!isPresent(other / "$IOLD3.log"));
+
+    CHECK(isPresent(user / "$RNEW.txt"));
+    CHECK(isPresent(user / "$INEW.txt"));
+    CHECK(isPresent(user / "$IBAD"));
+
+    // Without <SID> folders it is not a bin the parser understands
+    RecycleBinCleaner notABin;
+    CHECK(!notABin.scan(user.string()));
+
+    std::error_code ec;
+    fs::remove_all(root, ec);
+
+    if (failures > 0) {
+        std::cerr << failures << " check(s) failed\n";
+        return 1;
+    }
+    std::cout << "recycle_bin_test passed\n";
+    return 0;
+}